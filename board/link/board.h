@@ -19,7 +19,9 @@
 #define CONFIG_CHARGER
 #define CONFIG_CHARGER_BQ24725
 #define CONFIG_CONSOLE_CMDHELP
+#define CONFIG_CONSOLE_HISTORY
 #define CONFIG_EOPTION
+#define CONFIG_HOST_COMMAND_STATS
 #define CONFIG_IR357x
 #define CONFIG_LPC
 #define CONFIG_ONEWIRE
@@ -49,6 +51,7 @@
 #define LPC_CH_KEYBOARD 3  /* 8042 keyboard emulation */
 #define LPC_CH_CMD      4  /* Host commands */
 #define LPC_CH_MEMMAP   5  /* Memory-mapped data */
+#define LPC_CH_TELEMETRY 6 /* Memory-mapped telemetry history */
 #define LPC_CH_COMX     7  /* UART emulation */
 /* LPC pool offsets */
 #define LPC_POOL_OFFS_ACPI       0  /* ACPI commands - 0=in, 1=out */
@@ -56,6 +59,7 @@
 #define LPC_POOL_OFFS_COMX       8  /* UART emulation range - 8-15 */
 #define LPC_POOL_OFFS_KEYBOARD  16  /* Keyboard - 16=in, 17=out */
 #define LPC_POOL_OFFS_CMD       20  /* Host commands - 20=in, 21=out */
+#define LPC_POOL_OFFS_TELEMETRY 256  /* Telemetry history - 256-511 */
 #define LPC_POOL_OFFS_CMD_DATA 512  /* Data range for host commands - 512-767 */
 #define LPC_POOL_OFFS_MEMMAP   768  /* Memory-mapped data - 768-1023 */
 /* LPC pool data pointers */
@@ -66,6 +70,7 @@
 #define LPC_POOL_CMD      (LM4_LPC_LPCPOOL + LPC_POOL_OFFS_CMD)
 #define LPC_POOL_CMD_DATA (LM4_LPC_LPCPOOL + LPC_POOL_OFFS_CMD_DATA)
 #define LPC_POOL_MEMMAP   (LM4_LPC_LPCPOOL + LPC_POOL_OFFS_MEMMAP)
+#define LPC_POOL_TELEMETRY (LM4_LPC_LPCPOOL + LPC_POOL_OFFS_TELEMETRY)
 /* LPC COMx I/O address (in x86 I/O address space) */
 #define LPC_COMX_ADDR 0x3f8  /* COM1 */
 
@@ -6,12 +6,15 @@
 /* Clocks and power management settings */
 
 #include "board.h"
+#include "chipset.h"
 #include "clock.h"
 #include "cpu.h"
 #include "config.h"
 #include "console.h"
 #include "gpio.h"
 #include "hooks.h"
+#include "hwtimer.h"
+#include "host_command.h"
 #include "registers.h"
 #include "system.h"
 #include "task.h"
@@ -38,8 +41,9 @@ static void disable_pll(void)
 }
 
 
-/* Enable the PLL to run at full clock speed. */
-static void enable_pll(void)
+/* Power up the PLL and wait for it to lock.  The PLL is left bypassed, so
+ * the system still runs off the internal oscillator. */
+static void lock_pll(void)
 {
 	/* Disable the PLL so we can reconfigure it */
 	disable_pll();
@@ -56,6 +60,13 @@ static void enable_pll(void)
 	clock_wait_cycles(1024);
 	while (!(LM4_SYSTEM_PLLSTAT & 1))
 		;
+}
+
+
+/* Enable the PLL to run at full clock speed. */
+static void enable_pll(void)
+{
+	lock_pll();
 
 	/* Remove bypass on PLL */
 	LM4_SYSTEM_RCC &= ~LM4_SYSTEM_RCC_BYPASS;
@@ -88,6 +99,159 @@ int clock_get_freq(void)
 	return freq;
 }
 
+/*****************************************************************************/
+/* Idle governor */
+
+#ifdef CONFIG_LOW_POWER_IDLE
+
+/* Minimum time until the next timer event for an idle state to be worth
+ * entering.  This has to cover the PLL relock on the way out, plus the flash
+ * and SRAM wake-up for hibernate. */
+static const uint32_t idle_min_residency_us[IDLE_STATE_COUNT] = {
+	0, 2000, 20000
+};
+
+static const char * const idle_state_names[IDLE_STATE_COUNT] = {
+	"wfi", "deep", "hibernate"
+};
+
+static struct {
+	uint32_t entries;       /* Number of times the state was entered */
+	uint64_t residency_us;  /* Total time spent in the state */
+	uint32_t max_exit_us;   /* Longest time to restore the clocks */
+} idle_stats[IDLE_STATE_COUNT];
+
+static timestamp_t idle_stats_start;  /* When the statistics were reset */
+
+/* Deepest idle state allowed, set from the console */
+static enum idle_state idle_max_state = IDLE_STATE_COUNT - 1;
+
+
+/* Return the deepest idle state currently allowed. */
+static enum idle_state idle_allowed_state(void)
+{
+#ifdef CONFIG_TASK_X86POWER
+	/* Keep LPC and PECI latency low while the host is running; deep
+	 * states are only for S3 and S5. */
+	if (!chipset_in_state(CHIPSET_STATE_ANY_OFF | CHIPSET_STATE_SUSPEND))
+		return IDLE_STATE_WFI;
+#endif
+	return idle_max_state;
+}
+
+
+/* Switch the system clock around deep sleep.  This is not announced through
+ * HOOK_FREQ_CHANGE: only the hwtimer prescaler follows, and the other modules
+ * keep their run mode dividers and simply run slower while asleep.  The switch
+ * is made just after a microsecond tick, so the hwtimer loses no time. */
+static void idle_switch_clock(int pll)
+{
+	uint32_t t;
+
+	if (pll)
+		lock_pll();
+
+	t = __hw_clock_source_read();
+	while (__hw_clock_source_read() == t)
+		;
+
+	if (pll) {
+		LM4_SYSTEM_RCC &= ~LM4_SYSTEM_RCC_BYPASS;
+		freq = PLL_CLOCK;
+	} else {
+		disable_pll();
+	}
+
+	__hw_clock_source_update_prescaler();
+}
+
+
+/* Prepare the chip for deep sleep in the given state. */
+static void deep_sleep_prepare(enum idle_state state)
+{
+	/* Run off the internal oscillator, which is also the deep sleep
+	 * clock. */
+	idle_switch_clock(0);
+
+	/* Keep every enabled peripheral clocked from PIOSC in deep sleep, so
+	 * the hwtimer keeps counting and transfers in progress complete. */
+	LM4_SYSTEM_DCGCWD = LM4_SYSTEM_RCGCWD;
+	LM4_SYSTEM_DCGCTIMER = LM4_SYSTEM_RCGCTIMER;
+	LM4_SYSTEM_DCGCGPIO = LM4_SYSTEM_RCGCGPIO;
+	LM4_SYSTEM_DCGCDMA = LM4_SYSTEM_RCGCDMA;
+	LM4_SYSTEM_DCGCHIB = LM4_SYSTEM_RCGCHIB;
+	LM4_SYSTEM_DCGCUART = LM4_SYSTEM_RCGCUART;
+	LM4_SYSTEM_DCGCSSI = LM4_SYSTEM_RCGCSSI;
+	LM4_SYSTEM_DCGCI2C = LM4_SYSTEM_RCGCI2C;
+	LM4_SYSTEM_DCGCADC = LM4_SYSTEM_RCGCADC;
+	LM4_SYSTEM_DCGCLPC = LM4_SYSTEM_RCGCLPC;
+	LM4_SYSTEM_DCGCPECI = LM4_SYSTEM_RCGCPECI;
+	LM4_SYSTEM_DCGCFAN = LM4_SYSTEM_RCGCFAN;
+	LM4_SYSTEM_DCGCEEPROM = LM4_SYSTEM_RCGCEEPROM;
+	LM4_SYSTEM_DCGCWTIMER = LM4_SYSTEM_RCGCWTIMER;
+	LM4_SYSTEM_DSLPCLKCFG = LM4_SYSTEM_DSLPCLKCFG_DSOSCSRC(1);
+
+	/* Hibernate also puts the flash and SRAM in low power mode */
+	if (state == IDLE_STATE_HIBERNATE)
+		LM4_SYSTEM_DSLPPWRCFG = LM4_SYSTEM_DSLPPWRCFG_FLASHPM(2) |
+			LM4_SYSTEM_DSLPPWRCFG_SRAMPM(3);
+	else
+		LM4_SYSTEM_DSLPPWRCFG = 0;
+
+	/* Set the deep sleep bit */
+	CPU_SCB_SYSCTRL |= 0x4;
+}
+
+
+void clock_idle(void)
+{
+	enum idle_state state = IDLE_STATE_WFI;
+	enum idle_state max_state = idle_allowed_state();
+	uint32_t next_us, t0, t1, exit_us;
+
+	/* Stay masked until the clocks are back, so the interrupt which wakes
+	 * us up runs at full speed. */
+	interrupt_disable();
+
+	next_us = timer_next_event_us();
+	while (state < max_state && next_us >= idle_min_residency_us[state + 1])
+		state++;
+
+	t0 = get_time().le.lo;
+
+	if (state != IDLE_STATE_WFI)
+		deep_sleep_prepare(state);
+
+	asm("wfi");
+
+	t1 = get_time().le.lo;
+
+	if (state != IDLE_STATE_WFI) {
+		CPU_SCB_SYSCTRL &= ~0x4;
+		idle_switch_clock(1);
+	}
+
+	/* The counter overflow interrupt wakes us up, so 32-bit differences
+	 * are enough here. */
+	exit_us = get_time().le.lo - t1;
+	idle_stats[state].entries++;
+	idle_stats[state].residency_us += t1 - t0;
+	if (exit_us > idle_stats[state].max_exit_us)
+		idle_stats[state].max_exit_us = exit_us;
+
+	interrupt_enable();
+}
+
+
+/* Convert a time in us to ms, without 64-bit division */
+static uint32_t us_to_ms(uint64_t us)
+{
+	uint64divmod(&us, 1000);
+	return us;
+}
+
+#endif  /* CONFIG_LOW_POWER_IDLE */
+
 
 /*****************************************************************************/
 /* Console commands */
@@ -246,6 +410,75 @@ DECLARE_CONSOLE_COMMAND(pll, command_pll,
 			"Get/set PLL state",
 			NULL);
 
+
+#ifdef CONFIG_LOW_POWER_IDLE
+static int command_idle_stats(int argc, char **argv)
+{
+	uint64_t total = get_time().val - idle_stats_start.val;
+	int i;
+
+	if (argc > 1) {
+		if (!strcasecmp(argv[1], "reset")) {
+			interrupt_disable();
+			memset(idle_stats, 0, sizeof(idle_stats));
+			idle_stats_start = get_time();
+			interrupt_enable();
+			return EC_SUCCESS;
+		}
+
+		for (i = 0; i < IDLE_STATE_COUNT; i++) {
+			if (!strcasecmp(argv[1], idle_state_names[i]))
+				break;
+		}
+		if (i == IDLE_STATE_COUNT)
+			return EC_ERROR_PARAM1;
+		idle_max_state = i;
+	}
+
+	ccprintf("Deepest state: %s\n", idle_state_names[idle_max_state]);
+	ccprintf("Time:          %.6ld s\n", total);
+	ccprintf("State      Entries  Residency (s)  MaxExit (us)\n");
+	for (i = 0; i < IDLE_STATE_COUNT; i++) {
+		ccprintf("%-9s %8d  %13.6ld  %12d\n", idle_state_names[i],
+			 idle_stats[i].entries, idle_stats[i].residency_us,
+			 idle_stats[i].max_exit_us);
+	}
+
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(idlestats, command_idle_stats,
+			"[reset | wfi | deep | hibernate]",
+			"Print idle stats / set deepest idle state",
+			NULL);
+#endif
+
+/*****************************************************************************/
+/* Host commands */
+
+#ifdef CONFIG_LOW_POWER_IDLE
+static int clock_command_idle_stats(struct host_cmd_handler_args *args)
+{
+	struct ec_response_idle_stats *r = args->response;
+	int i;
+
+	BUILD_ASSERT(IDLE_STATE_COUNT == EC_IDLE_STATE_COUNT);
+
+	r->time_ms = us_to_ms(get_time().val - idle_stats_start.val);
+	for (i = 0; i < IDLE_STATE_COUNT; i++) {
+		r->state[i].entries = idle_stats[i].entries;
+		r->state[i].residency_ms = us_to_ms(idle_stats[i].residency_us);
+		r->state[i].max_exit_us = idle_stats[i].max_exit_us;
+	}
+
+	args->response_size = sizeof(*r);
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_IDLE_STATS,
+		     clock_command_idle_stats,
+		     EC_VER_MASK(0));
+#endif
+
 /*****************************************************************************/
 /* Initialization */
 
@@ -24,6 +24,15 @@
 /* System stack size */
 #define CONFIG_STACK_SIZE           4096
 
+/* Default task stack size in bytes */
+#define TASK_STACK_SIZE             512
+/* Stack sizes for tasks with shallower or deeper call chains */
+#define SMALLER_TASK_STACK_SIZE     384
+#define LARGER_TASK_STACK_SIZE      640
+/* Stack size for the idle task.  It runs the chip low power idle
+ * code, so it keeps the default size. */
+#define IDLE_TASK_STACK_SIZE        TASK_STACK_SIZE
+
 #define CONFIG_FLASH_BASE           0x00000000
 #define CONFIG_FLASH_BANK_SIZE      0x00000800  /* protect bank size */
 #define CONFIG_FLASH_ERASE_SIZE     0x00000400  /* erase bank size */
@@ -101,6 +110,7 @@
 #define CONFIG_FLASH
 #define CONFIG_FPU
 #define CONFIG_I2C
+#define CONFIG_LOW_POWER_IDLE
 
 /* Compile for running from RAM instead of flash */
 /* #define COMPILE_FOR_RAM */
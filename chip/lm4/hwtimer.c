@@ -58,11 +58,17 @@ static void __hw_clock_source_irq(void)
 DECLARE_IRQ(LM4_IRQ_TIMERW0A, __hw_clock_source_irq, 1);
 
 
-static int update_prescaler(void)
+void __hw_clock_source_update_prescaler(void)
 {
 	/* Set the prescaler to increment every microsecond.  This takes
 	 * effect immediately, because the TAILD bit in TAMR is clear. */
 	LM4_TIMER_TAPR(6) = clock_get_freq() / US_PER_SECOND;
+}
+
+
+static int update_prescaler(void)
+{
+	__hw_clock_source_update_prescaler();
 
 	return EC_SUCCESS;
 }
@@ -89,7 +95,7 @@ int __hw_clock_source_init(uint32_t start_t)
 	LM4_TIMER_CFG(6) = 4;
 
 	/* Set initial prescaler */
-	update_prescaler();
+	__hw_clock_source_update_prescaler();
 
 	/* Periodic mode, counting down */
 	LM4_TIMER_TAMR(6) = 0x22;
@@ -35,6 +35,7 @@ static uint8_t acpi_mem_test;    /* Test byte in ACPI memory space */
 static uint32_t host_events;     /* Currently pending SCI/SMI events */
 static uint32_t event_mask[3];   /* Event masks for each type */
 static struct host_cmd_handler_args host_cmd_args;
+static struct host_packet lpc_packet;
 static int init_done;
 
 static uint8_t * const cmd_params = (uint8_t *)LPC_POOL_CMD_DATA +
@@ -43,6 +44,8 @@ static uint8_t * const old_params = (uint8_t *)LPC_POOL_CMD_DATA +
 	EC_LPC_ADDR_OLD_PARAM - EC_LPC_ADDR_HOST_ARGS;
 static struct ec_lpc_host_args * const lpc_host_args =
 	(struct ec_lpc_host_args *)LPC_POOL_CMD_DATA;
+static uint8_t * const lpc_host_packet = (uint8_t *)LPC_POOL_CMD_DATA +
+	EC_LPC_ADDR_HOST_PACKET - EC_LPC_ADDR_HOST_ARGS;
 
 /* Configure GPIOs for module */
 static void configure_gpio(void)
@@ -127,55 +130,55 @@ uint8_t *lpc_get_memmap_range(void)
 	return (uint8_t *)LPC_POOL_MEMMAP;
 }
 
+uint8_t *lpc_get_telemetry_range(void)
+{
+	return (uint8_t *)LPC_POOL_TELEMETRY;
+}
+
 static void lpc_send_response(struct host_cmd_handler_args *args)
 {
-	uint8_t *out;
+	/* TODO(sjg@chromium.org): put flags in args? */
+	int new_style = lpc_host_args->flags & EC_HOST_ARGS_FLAG_FROM_HOST;
+	uint8_t *out = new_style ? cmd_params : old_params;
 	int size = args->response_size;
-	int max_size;
+	int csum = 0;
 
-	/* Handle negative size */
-	if (size < 0) {
+	/* Fail if response doesn't fit in the param buffer */
+	if (size > (new_style ? EC_HOST_PARAM_SIZE : EC_OLD_PARAM_SIZE)) {
 		args->result = EC_RES_INVALID_RESPONSE;
 		size = 0;
 	}
 
-	/* TODO(sjg@chromium.org): put flags in args? */
-	if (lpc_host_args->flags & EC_HOST_ARGS_FLAG_FROM_HOST) {
-		/* New-style response */
-		int csum;
-		int i;
+	/*
+	 * Most handlers build their response in place.  Others point it at
+	 * data elsewhere, which is summed while it's copied in, so it's only
+	 * read once.
+	 */
+	if (args->response != out) {
+		if (new_style)
+			csum = memcpy_sum(out, args->response, size);
+		else
+			memcpy(out, args->response, size);
+	} else if (new_style) {
+		csum = sum_bytes(out, size);
+	}
 
+	if (new_style) {
 		lpc_host_args->flags =
 			(lpc_host_args->flags & ~EC_HOST_ARGS_FLAG_FROM_HOST) |
 			EC_HOST_ARGS_FLAG_TO_HOST;
 
 		lpc_host_args->data_size = size;
 
-		csum = args->command + lpc_host_args->flags +
+		csum += args->command + lpc_host_args->flags +
 			lpc_host_args->command_version +
 			lpc_host_args->data_size;
 
-		for (i = 0, out = (uint8_t *)args->response; i < size;
-		     i++, out++)
-			csum += *out;
-
 		lpc_host_args->checksum = (uint8_t)csum;
-
-		out = cmd_params;
-		max_size = EC_HOST_PARAM_SIZE;
 	} else {
-		/* Old-style response */
 		lpc_host_args->flags = 0;
-		out = old_params;
-		max_size = EC_OLD_PARAM_SIZE;
 	}
 
-	/* Fail if response doesn't fit in the param buffer */
-	if (size > max_size)
-		args->result = EC_RES_INVALID_RESPONSE;
-	else if (host_cmd_args.response != out)
-		memcpy(out, args->response, size);
-
 	/*
 	 * Write result to the data byte.  This sets the TOH bit in the
 	 * status byte and triggers an IRQ on the host so the host can read
@@ -192,6 +195,19 @@ static void lpc_send_response(struct host_cmd_handler_args *args)
 	task_enable_irq(LM4_IRQ_LPC);
 }
 
+static void lpc_send_packet(struct host_packet *pkt)
+{
+	const struct ec_host_response *r = pkt->response;
+
+	/* Reply packet is already in place; result to the data byte */
+	LPC_POOL_CMD[1] = r->result;
+
+	/* Clear the busy bit */
+	task_disable_irq(LM4_IRQ_LPC);
+	LM4_LPC_ST(LPC_CH_CMD) &= ~LM4_LPC_ST_BUSY;
+	task_enable_irq(LM4_IRQ_LPC);
+}
+
 /* Return true if the TOH is still set */
 int lpc_keyboard_has_char(void)
 {
@@ -449,15 +465,28 @@ DECLARE_HOST_COMMAND(EC_CMD_ACPI_QUERY_EVENT,
 /* Handle an incoming host command */
 static void handle_host_command(int cmd)
 {
+	/* Protocol version 3 packets are in the packet area */
+	if (cmd == EC_COMMAND_PROTOCOL_3) {
+		lpc_packet.send_response = lpc_send_packet;
+		lpc_packet.request = lpc_host_packet;
+		lpc_packet.request_size = EC_LPC_HOST_PACKET_SIZE;
+		lpc_packet.response = lpc_host_packet;
+		lpc_packet.response_max = EC_LPC_HOST_PACKET_SIZE;
+		lpc_packet.transport = HOST_TRANSPORT_LPC;
+		host_packet_receive(&lpc_packet);
+		return;
+	}
+
 	host_cmd_args.command = cmd;
 	host_cmd_args.result = EC_RES_SUCCESS;
 	host_cmd_args.send_response = lpc_send_response;
+	host_cmd_args.transport = HOST_TRANSPORT_LPC;
 
 	/* See if we have an old or new style command */
 	if (lpc_host_args->flags & EC_HOST_ARGS_FLAG_FROM_HOST) {
 		/* New style command */
 		int size = lpc_host_args->data_size;
-		int csum, i;
+		int csum;
 
 		host_cmd_args.version = lpc_host_args->command_version;
 		host_cmd_args.params = cmd_params;
@@ -474,10 +503,8 @@ static void handle_host_command(int cmd)
 			csum = host_cmd_args.command +
 				lpc_host_args->flags +
 				lpc_host_args->command_version +
-				lpc_host_args->data_size;
-
-			for (i = 0; i < size; i++)
-				csum += cmd_params[i];
+				lpc_host_args->data_size +
+				sum_bytes(cmd_params, size);
 
 			if ((uint8_t)csum != lpc_host_args->checksum)
 				host_cmd_args.result = EC_RES_INVALID_CHECKSUM;
@@ -670,6 +697,17 @@ static int lpc_init(void)
 	LM4_LPC_ADR(LPC_CH_MEMMAP) = EC_LPC_ADDR_MEMMAP;
 	LM4_LPC_CTL(LPC_CH_MEMMAP) = 0x0019 | (LPC_POOL_OFFS_MEMMAP << (5 - 1));
 
+	/*
+	 * Set LPC channel 6 to I/O address 0xa00, range endpoint,
+	 * arbitration enabled, pool bytes 256-511.  To access this from
+	 * x86, use the following command to set GEN_LPC4:
+	 *
+	 *   pci_write32 0 0x1f 0 0x90 0x007c0a01
+	 */
+	LM4_LPC_ADR(LPC_CH_TELEMETRY) = EC_LPC_ADDR_TELEMETRY;
+	LM4_LPC_CTL(LPC_CH_TELEMETRY) = 0x0019 |
+		(LPC_POOL_OFFS_TELEMETRY << (5 - 1));
+
 	/*
 	 * Set LPC channel 7 to COM port I/O address.  Note that channel 7
 	 * ignores the TYPE bit and is always an 8-byte range.
@@ -704,6 +742,7 @@ static int lpc_init(void)
 		(1 << LPC_CH_KEYBOARD) |
 		(1 << LPC_CH_CMD) |
 		(1 << LPC_CH_MEMMAP) |
+		(1 << LPC_CH_TELEMETRY) |
 		(1 << LPC_CH_COMX);
 
 	/*
@@ -719,14 +758,21 @@ static int lpc_init(void)
 		/* Do a dummy slave write; this should cause SW1ST to be set */
 		*LPC_POOL_MEMMAP = *LPC_POOL_MEMMAP;
 	}
+	/* Same for the telemetry space */
+	while (!(LM4_LPC_ST(LPC_CH_TELEMETRY) & 0x10)) {
+		LM4_LPC_ST(LPC_CH_TELEMETRY) &= ~0x40;
+		*LPC_POOL_TELEMETRY = *LPC_POOL_TELEMETRY;
+	}
 
 	/* Initialize host args and memory map to all zero */
 	memset(lpc_host_args, 0, sizeof(*lpc_host_args));
 	memset(lpc_get_memmap_range(), 0, EC_MEMMAP_SIZE);
 
-	/* We support LPC args */
+	/* We support LPC args, protocol version 3 and mapped telemetry */
 	*(lpc_get_memmap_range() + EC_MEMMAP_HOST_CMD_FLAGS) =
-		EC_HOST_CMD_FLAG_LPC_ARGS_SUPPORTED;
+		EC_HOST_CMD_FLAG_LPC_ARGS_SUPPORTED |
+		EC_HOST_CMD_FLAG_VERSION_3 |
+		EC_HOST_CMD_FLAG_TELEMETRY;
 
 	/* Enable LPC interrupt */
 	task_enable_irq(LM4_IRQ_LPC);
@@ -242,7 +242,12 @@ static inline int lm4_fan_addr(int ch, int offset)
 #define LM4_SYSTEM_MOSCCTL     LM4REG(0x400fe07c)
 #define LM4_SYSTEM_PIOSCCAL    LM4REG(0x400fe150)
 #define LM4_SYSTEM_PIOSCSTAT   LM4REG(0x400fe154)
+#define LM4_SYSTEM_DSLPCLKCFG  LM4REG(0x400fe144)
+#define LM4_SYSTEM_DSLPCLKCFG_DSOSCSRC(x) (((x) & 0x7) << 4)
 #define LM4_SYSTEM_PLLSTAT     LM4REG(0x400fe168)
+#define LM4_SYSTEM_DSLPPWRCFG  LM4REG(0x400fe18c)
+#define LM4_SYSTEM_DSLPPWRCFG_FLASHPM(x) (((x) & 0x3) << 4)
+#define LM4_SYSTEM_DSLPPWRCFG_SRAMPM(x)  (((x) & 0x3) << 0)
 #define LM4_SYSTEM_BOOTCFG     LM4REG(0x400fe1d0)
 /* Note: USER_REG3 is used to hold pre-programming process data and should not
  * be modified by EC code.  See crosbug.com/p/8889. */
@@ -262,6 +267,20 @@ static inline int lm4_fan_addr(int ch, int offset)
 #define LM4_SYSTEM_RCGCFAN     LM4REG(0x400fe654)
 #define LM4_SYSTEM_RCGCEEPROM  LM4REG(0x400fe658)
 #define LM4_SYSTEM_RCGCWTIMER  LM4REG(0x400fe65c)
+#define LM4_SYSTEM_DCGCWD      LM4REG(0x400fe800)
+#define LM4_SYSTEM_DCGCTIMER   LM4REG(0x400fe804)
+#define LM4_SYSTEM_DCGCGPIO    LM4REG(0x400fe808)
+#define LM4_SYSTEM_DCGCDMA     LM4REG(0x400fe80c)
+#define LM4_SYSTEM_DCGCHIB     LM4REG(0x400fe814)
+#define LM4_SYSTEM_DCGCUART    LM4REG(0x400fe818)
+#define LM4_SYSTEM_DCGCSSI     LM4REG(0x400fe81c)
+#define LM4_SYSTEM_DCGCI2C     LM4REG(0x400fe820)
+#define LM4_SYSTEM_DCGCADC     LM4REG(0x400fe838)
+#define LM4_SYSTEM_DCGCLPC     LM4REG(0x400fe848)
+#define LM4_SYSTEM_DCGCPECI    LM4REG(0x400fe850)
+#define LM4_SYSTEM_DCGCFAN     LM4REG(0x400fe854)
+#define LM4_SYSTEM_DCGCEEPROM  LM4REG(0x400fe858)
+#define LM4_SYSTEM_DCGCWTIMER  LM4REG(0x400fe85c)
 #define LM4_SYSTEM_PREEPROM    LM4REG(0x400fea58)
 
 #define LM4_DMA_DMACFG         LM4REG(0x400ff004)
@@ -18,9 +18,21 @@
 /* System stack size */
 #define CONFIG_STACK_SIZE 1024
 
+/* Default task stack size in bytes */
+#define TASK_STACK_SIZE 512
+/* Stack sizes for tasks with shallower or deeper call chains */
+#define SMALLER_TASK_STACK_SIZE 384
+#define LARGER_TASK_STACK_SIZE 640
+/* Stack size for the idle task.  It runs the chip low power idle
+ * code, so it keeps the default size. */
+#define IDLE_TASK_STACK_SIZE TASK_STACK_SIZE
+
 /* support programming on-chip flash */
 #define CONFIG_FLASH
 
+/* Send console output by DMA, a span of the transmit buffer at a time */
+#define CONFIG_UART_TX_DMA
+
 /* build with assertions and debug messages */
 #define CONFIG_DEBUG
 
@@ -24,6 +24,11 @@ enum {
 	DMAC_SPI2_RX,
 	DMAC_SPI2_TX,
 
+	/* USART channels are shared with SPI; only one can use each */
+	DMAC_USART3_TX = DMAC_SPI1_RX,
+	DMAC_USART1_TX = DMAC_SPI2_RX,
+	DMAC_USART2_TX = 6,
+
 	/* DMA1 has 7 channels, DMA2 has 5 */
 	DMA1_NUM_CHANNELS = 7,
 	DMA2_NUM_CHANNELS = 5,
@@ -75,6 +80,14 @@ enum {
 #define DMA_CHANNEL_FOR_SPI_TX(spi) \
 	((spi) == STM32_SPI1_PORT ? DMAC_SPI1_TX : DMAC_SPI2_TX)
 
+/**
+ * @param n	USART number, 1 to 3
+ * @return DMA channel to use for tx on that USART
+ */
+#define DMA_CHANNEL_FOR_USART_TX(n) \
+	((n) == 1 ? DMAC_USART1_TX : (n) == 2 ? DMAC_USART2_TX : \
+	 DMAC_USART3_TX)
+
 /**
  * Get a pointer to a DMA channel.
  *
@@ -51,6 +51,7 @@ static struct mutex i2c_mutex;
 /* buffer for host commands (including version, error code and checksum) */
 static uint8_t host_buffer[EC_HOST_PARAM_SIZE + 4];
 static struct host_cmd_handler_args host_cmd_args;
+static struct host_packet i2c_packet;
 
 /* current position in host buffer for reception */
 static int rx_index;
@@ -152,12 +153,30 @@ static void i2c_send_response(struct host_cmd_handler_args *args)
 	i2c_write_raw(I2C2, host_buffer, out - host_buffer);
 }
 
+static void i2c_send_packet(struct host_packet *pkt)
+{
+	/* send the reply packet to the AP */
+	i2c_write_raw(I2C2, pkt->response, pkt->response_size);
+}
+
 /* Process the command in the i2c host buffer */
 static void i2c_process_command(void)
 {
 	struct host_cmd_handler_args *args = &host_cmd_args;
 	char *buff = host_buffer;
 
+	/* Protocol version 3 packet follows the command byte */
+	if (host_buffer[0] == EC_COMMAND_PROTOCOL_3) {
+		i2c_packet.send_response = i2c_send_packet;
+		i2c_packet.request = host_buffer + 1;
+		i2c_packet.request_size = rx_index - 1;
+		i2c_packet.response = host_buffer + 1;
+		i2c_packet.response_max = sizeof(host_buffer) - 1;
+		i2c_packet.transport = HOST_TRANSPORT_I2C;
+		host_packet_receive(&i2c_packet);
+		return;
+	}
+
 	args->command = *buff;
 	args->result = EC_RES_SUCCESS;
 	if (args->command >= EC_CMD_VERSION0) {
@@ -186,6 +205,7 @@ static void i2c_process_command(void)
 
 	/* we have an available command : execute it */
 	args->send_response = i2c_send_response;
+	args->transport = HOST_TRANSPORT_I2C;
 	args->params = buff;
 	/* skip room for error code, arglen */
 	args->response = host_buffer + 2;
@@ -9,13 +9,13 @@
  * TODO: Finish cleaning up nomenclature (cols/rows/inputs/outputs),
  */
 
-#include "atomic.h"
 #include "board.h"
 #include "console.h"
 #include "gpio.h"
 #include "host_command.h"
 #include "keyboard.h"
 #include "keyboard_scan.h"
+#include "queue.h"
 #include "registers.h"
 #include "system.h"
 #include "task.h"
@@ -85,22 +85,21 @@ void board_keyboard_suppress_noise(void)
 		__attribute__((weak, alias("__board_keyboard_suppress_noise")));
 
 #define KB_FIFO_DEPTH		16	/* FIXME: this is pretty huge */
-static uint32_t kb_fifo_start;		/* first entry */
-static uint32_t kb_fifo_end;			/* last entry */
-static uint32_t kb_fifo_entries;	/* number of existing entries */
-static uint8_t kb_fifo[KB_FIFO_DEPTH][KB_OUTPUTS];
+static uint8_t kb_fifo_buf[KB_FIFO_DEPTH][KB_OUTPUTS];
+static struct queue kb_fifo = {
+	.buf_units  = KB_FIFO_DEPTH,
+	.unit_bytes = KB_OUTPUTS,
+	.buf        = (uint8_t *)kb_fifo_buf,
+};
+/* Last state removed from the FIFO */
+static uint8_t kb_last_state[KB_OUTPUTS];
 
 /* clear keyboard state variables */
 void keyboard_clear_state(void)
 {
-	int i;
-
 	CPRINTF("clearing keyboard fifo\n");
-	kb_fifo_start = 0;
-	kb_fifo_end = 0;
-	kb_fifo_entries = 0;
-	for (i = 0; i < KB_FIFO_DEPTH; i++)
-		memset(kb_fifo[i], 0, KB_OUTPUTS);
+	queue_reset(&kb_fifo);
+	memset(kb_last_state, 0, KB_OUTPUTS);
 }
 
 /**
@@ -110,22 +109,12 @@ void keyboard_clear_state(void)
   */
 static int kb_fifo_add(uint8_t *buffp)
 {
-	int ret = EC_SUCCESS;
-
-	if (kb_fifo_entries == KB_FIFO_DEPTH) {
+	if (!queue_add_units(&kb_fifo, buffp, 1)) {
 		CPRINTF("%s: FIFO depth reached\n", __func__);
-		ret = EC_ERROR_OVERFLOW;
-		goto kb_fifo_push_done;
+		return EC_ERROR_OVERFLOW;
 	}
 
-	memcpy(kb_fifo[kb_fifo_end], buffp, KB_OUTPUTS);
-
-	kb_fifo_end = (kb_fifo_end + 1) % KB_FIFO_DEPTH;
-
-	atomic_add(&kb_fifo_entries, 1);
-
-kb_fifo_push_done:
-	return ret;
+	return EC_SUCCESS;
 }
 
 /**
@@ -135,25 +124,19 @@ kb_fifo_push_done:
   */
 static int kb_fifo_remove(uint8_t *buffp)
 {
-	if (!kb_fifo_entries) {
-		/* no entry remaining in FIFO : return last known state */
-		int last = (kb_fifo_start + KB_FIFO_DEPTH - 1) % KB_FIFO_DEPTH;
-		memcpy(buffp, kb_fifo[last], KB_OUTPUTS);
-
-		/*
-		 * Bail out without changing any FIFO indices and let the
-		 * caller know something strange happened. The buffer will
-		 * will contain the last known state of the keyboard.
-		 */
-		return EC_ERROR_UNKNOWN;
-	}
-	memcpy(buffp, kb_fifo[kb_fifo_start], KB_OUTPUTS);
+	int ret = EC_SUCCESS;
 
-	kb_fifo_start = (kb_fifo_start + 1) % KB_FIFO_DEPTH;
+	/*
+	 * If no entry remains in the FIFO, let the caller know something
+	 * strange happened.  The buffer will contain the last known state of
+	 * the keyboard.
+	 */
+	if (!queue_remove_unit(&kb_fifo, kb_last_state))
+		ret = EC_ERROR_UNKNOWN;
 
-	atomic_sub(&kb_fifo_entries, 1);
+	memcpy(buffp, kb_last_state, KB_OUTPUTS);
 
-	return EC_SUCCESS;
+	return ret;
 }
 
 static void select_column(int col)
@@ -435,7 +418,7 @@ int keyboard_scan_recovery_pressed(void)
 static int keyboard_get_scan(struct host_cmd_handler_args *args)
 {
 	kb_fifo_remove(args->response);
-	if (!kb_fifo_entries)
+	if (queue_is_empty(&kb_fifo))
 		board_interrupt_host(0);
 
 	args->response_size = KB_OUTPUTS;
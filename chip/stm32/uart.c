@@ -9,6 +9,7 @@
 
 #include "board.h"
 #include "config.h"
+#include "dma.h"
 #include "registers.h"
 #include "task.h"
 #include "uart.h"
@@ -20,6 +21,16 @@
 /* Console USART index */
 #define UARTN CONFIG_CONSOLE_UART
 
+#ifdef CONFIG_UART_TX_DMA
+/* DMA channel sending console output */
+#define UART_TX_DMA_CH DMA_CHANNEL_FOR_USART_TX(UARTN)
+/* Transmit interrupt: transmission complete, once per DMA transfer */
+#define CR1_TX_IE 0x40
+#else
+/* Transmit interrupt: TX empty, once per character */
+#define CR1_TX_IE 0x80
+#endif
+
 static int init_done;    /* Initialization done? */
 static int should_stop;  /* Last TX control action */
 
@@ -31,20 +42,20 @@ int uart_init_done(void)
 
 void uart_tx_start(void)
 {
-	STM32_USART_CR1(UARTN) |= 0x80;
+	STM32_USART_CR1(UARTN) |= CR1_TX_IE;
 	should_stop = 0;
 	task_trigger_irq(STM32_IRQ_USART(UARTN));
 }
 
 void uart_tx_stop(void)
 {
-	STM32_USART_CR1(UARTN) &= ~0x80;
+	STM32_USART_CR1(UARTN) &= ~CR1_TX_IE;
 	should_stop = 1;
 }
 
 int uart_tx_stopped(void)
 {
-	return !(STM32_USART_CR1(UARTN) & 0x80);
+	return !(STM32_USART_CR1(UARTN) & CR1_TX_IE);
 }
 
 void uart_tx_flush(void)
@@ -65,13 +76,42 @@ int uart_rx_available(void)
 
 void uart_write_char(char c)
 {
+#ifdef CONFIG_UART_TX_DMA
+	/* Hold off the DMA, so its writes don't collide with ours */
+	STM32_USART_CR3(UARTN) &= ~0x80;
+#endif
 	/* we normally never wait here since uart_write_char is normally called
 	 * when the buffer is ready, excepted when we insert a carriage return
 	 * before a line feed in the interrupt routine.
 	 */
 	while (!uart_tx_ready()) ;
 	STM32_USART_DR(UARTN) = c;
+#ifdef CONFIG_UART_TX_DMA
+	STM32_USART_CR3(UARTN) |= 0x80;
+#endif
+}
+
+#ifdef CONFIG_UART_TX_DMA
+void uart_tx_dma_start(const char *src, int len)
+{
+	struct dma_channel *chan = dma_get_channel(UART_TX_DMA_CH);
+
+	dma_prepare_tx(chan, len, (void *)&STM32_USART_DR(UARTN), src);
+	/*
+	 * Clear TC from the last transfer, so it marks the end of this one.
+	 * Writing 1 leaves the other flags alone, so RXNE can't be lost.
+	 */
+	STM32_USART_SR(UARTN) = ~0x40;
+	dma_go(chan);
+}
+
+int uart_tx_dma_ready(void)
+{
+	struct dma_channel *chan = dma_get_channel(UART_TX_DMA_CH);
+
+	return !(REG32(&chan->ccr) & DMA_EN) || !REG32(&chan->cndtr);
 }
+#endif
 
 int uart_read_char(void)
 {
@@ -92,10 +132,10 @@ void uart_enable_interrupt(void)
 static void uart_interrupt(void)
 {
 	/*
-	 * Disable the TX empty interrupt before filling the TX buffer since it
-	 * needs an actual write to DR to be cleared.
+	 * Disable the TX interrupt before filling the TX buffer since it
+	 * needs an actual write to DR (or a new DMA transfer) to be cleared.
 	 */
-	STM32_USART_CR1(UARTN) &= ~0x80;
+	STM32_USART_CR1(UARTN) &= ~CR1_TX_IE;
 
 	/* Read input FIFO until empty, then fill output FIFO */
 	uart_process();
@@ -105,7 +145,7 @@ static void uart_interrupt(void)
 	 * uart_process.
 	 */
 	if (!should_stop)
-		STM32_USART_CR1(UARTN) |= 0x80;
+		STM32_USART_CR1(UARTN) |= CR1_TX_IE;
 }
 DECLARE_IRQ(STM32_IRQ_USART(UARTN), uart_interrupt, 1);
 
@@ -131,8 +171,14 @@ int uart_init(void)
 	/* 1 stop bit, no fancy stuff */
 	STM32_USART_CR2(UARTN) = 0x0000;
 
+#ifdef CONFIG_UART_TX_DMA
+	/* DMA transmit, special modes disabled, error interrupt disabled */
+	dma_init();
+	STM32_USART_CR3(UARTN) = 0x0080;
+#else
 	/* DMA disabled, special modes disabled, error interrupt disabled */
 	STM32_USART_CR3(UARTN) = 0x0000;
+#endif
 
 	/* Select the baud rate
 	 * using x16 oversampling (OVER8 == 0)
@@ -0,0 +1,159 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Boot time profiler for Chrome EC */
+
+#include "boot_time.h"
+#include "console.h"
+#include "hooks.h"
+#include "host_command.h"
+#include "system.h"
+#include "timer.h"
+#include "util.h"
+
+#define BOOT_TIME_SYSJUMP_TAG 0x5442  /* "BT" */
+#define BOOT_TIME_HOOK_VERSION 1
+
+struct boot_time_entry {
+	uint32_t time_us;
+	uint8_t milestone;
+	uint8_t image;
+	uint8_t flags;
+	uint8_t reserved;
+};
+
+/* Milestone log, preserved across sysjump.  Keep it within the 255 byte
+ * limit of system_add_jump_tag(). */
+static struct boot_time_log {
+	uint8_t count;
+	uint8_t dropped;
+	uint8_t reserved[2];
+	struct boot_time_entry entry[EC_BOOT_TIME_MAX_ENTRIES];
+} boot_log;
+
+static int timer_ready;
+
+static const char * const milestone_names[] = {
+	"pre_init", "clock_init", "timer_init", "uart_init", "keyscan_init",
+	"vboot", "hook_init", "task_start", "host_cmd_ready", "sysjump",
+};
+
+
+void boot_time_init(void)
+{
+	const struct boot_time_log *prev;
+	int version, size;
+
+	prev = (const struct boot_time_log *)system_get_jump_tag(
+		BOOT_TIME_SYSJUMP_TAG, &version, &size);
+	if (prev && version == BOOT_TIME_HOOK_VERSION &&
+	    size == sizeof(boot_log))
+		memcpy(&boot_log, prev, sizeof(boot_log));
+}
+
+
+void boot_time_mark(enum ec_boot_time_milestone milestone)
+{
+	struct boot_time_entry *e;
+
+	if (milestone == EC_BOOT_TIME_TIMER_INIT)
+		timer_ready = 1;
+
+	if (boot_log.count >= EC_BOOT_TIME_MAX_ENTRIES) {
+		if (boot_log.dropped < 255)
+			boot_log.dropped++;
+		return;
+	}
+
+	e = boot_log.entry + boot_log.count++;
+	e->milestone = milestone;
+	e->image = system_get_image_copy();
+	e->reserved = 0;
+	if (timer_ready) {
+		e->time_us = get_time().le.lo;
+		e->flags = 0;
+	} else {
+		e->time_us = 0;
+		e->flags = EC_BOOT_TIME_FLAG_NO_TIME;
+	}
+}
+
+
+static int boot_time_sysjump(void)
+{
+	boot_time_mark(EC_BOOT_TIME_SYSJUMP);
+	system_add_jump_tag(BOOT_TIME_SYSJUMP_TAG, BOOT_TIME_HOOK_VERSION,
+			    sizeof(boot_log), &boot_log);
+	return EC_SUCCESS;
+}
+/* Last, so the jump time includes the other sysjump hooks */
+DECLARE_HOOK(HOOK_SYSJUMP, boot_time_sysjump, HOOK_PRIO_LAST);
+
+/*****************************************************************************/
+/* Console commands */
+
+static int command_boot_time(int argc, char **argv)
+{
+	static const char * const image_names[] = {"?", "RO", "RW"};
+	uint32_t prev = 0;
+	int i;
+
+	BUILD_ASSERT(ARRAY_SIZE(milestone_names) ==
+		     EC_BOOT_TIME_MILESTONE_COUNT);
+	BUILD_ASSERT(sizeof(boot_log) <= 255);
+
+	ccputs("Image  Milestone         Time (us)  Delta (us)\n");
+	for (i = 0; i < boot_log.count; i++) {
+		const struct boot_time_entry *e = boot_log.entry + i;
+
+		ccprintf("%-5s  %-16s  ", image_names[e->image],
+			 milestone_names[e->milestone]);
+		if (e->flags & EC_BOOT_TIME_FLAG_NO_TIME) {
+			ccputs("        -           -\n");
+			continue;
+		}
+		ccprintf("%9d  %10d\n", e->time_us, e->time_us - prev);
+		prev = e->time_us;
+	}
+	if (boot_log.dropped)
+		ccprintf("Dropped: %d\n", boot_log.dropped);
+
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(boottime, command_boot_time,
+			NULL,
+			"Print boot time milestones",
+			NULL);
+
+/*****************************************************************************/
+/* Host commands */
+
+static int boot_time_command_get(struct host_cmd_handler_args *args)
+{
+	struct ec_response_boot_time *r = args->response;
+	int header = sizeof(*r) - sizeof(r->entry);
+	int n_max = MIN((args->response_max - header) /
+			(int)sizeof(r->entry[0]), EC_BOOT_TIME_MAX_ENTRIES);
+	int n = MIN(boot_log.count, n_max);
+
+	BUILD_ASSERT(sizeof(*r) == sizeof(boot_log));
+
+	if (n_max <= 0)
+		return EC_RES_INVALID_PARAM;
+
+	/* As many entries as the transport has room for, whether or not they
+	 * are used, so I2C hosts get the full response they read.  Entries
+	 * which don't fit are reported as dropped. */
+	memcpy(r, &boot_log, header + n * sizeof(r->entry[0]));
+	memset(r->entry + n, 0, (n_max - n) * sizeof(r->entry[0]));
+	r->count = n;
+	r->dropped = MIN(boot_log.dropped + boot_log.count - n, 255);
+	args->response_size = header + n_max * sizeof(r->entry[0]);
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_BOOT_TIME,
+		     boot_time_command_get,
+		     EC_VER_MASK(0));
@@ -8,9 +8,11 @@
 
 common-y=main.o util.o console_output.o uart_buffering.o
 common-y+=memory_commands.o shared_mem.o system_common.o hooks.o
-common-y+=gpio_commands.o version.o printf.o queue.o
+common-y+=gpio_commands.o version.o printf.o queue.o boot_time.o telemetry.o
+common-y+=timer_heap.o
 common-$(CONFIG_BATTERY_LINK)+=battery_link.o
 common-$(CONFIG_CHARGER_BQ24725)+=charger_bq24725.o
+common-$(CONFIG_CONSOLE_HISTORY)+=console_history.o
 common-$(CONFIG_PMU_TPS65090)+=pmu_tps65090.o pmu_tps65090_charger.o
 common-$(CONFIG_EOPTION)+=eoption.o
 common-$(CONFIG_FLASH)+=flash_common.o fmap.o
@@ -27,6 +29,7 @@ common-$(CONFIG_TASK_I8042CMD)+=i8042.o keyboard.o
 common-$(CONFIG_TASK_LIGHTBAR)+=lightbar.o
 common-$(CONFIG_TASK_POWERSTATE)+=charge_state.o battery_precharge.o
 common-$(CONFIG_TASK_PWM)+=pwm_commands.o
+common-$(CONFIG_TASK_SOFTTIMER)+=soft_timer.o
 common-$(CONFIG_TASK_TEMPSENSOR)+=temp_sensor.o temp_sensor_commands.o
 common-$(CONFIG_TASK_THERMAL)+=thermal.o thermal_commands.o
 common-$(CONFIG_TASK_X86POWER)+=x86_power.o
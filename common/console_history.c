@@ -0,0 +1,187 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Console history for Chrome EC */
+
+#include "atomic.h"
+#include "console_history.h"
+#include "ec_commands.h"
+#include "hooks.h"
+#include "host_command.h"
+#include "system.h"
+#include "util.h"
+
+/* Size of the history in bytes; must be a power of 2 */
+#ifndef CONFIG_CONSOLE_HISTORY_SIZE
+#define CONFIG_CONSOLE_HISTORY_SIZE 2048
+#endif
+
+#define CONSOLE_HISTORY_SYSJUMP_TAG 0x4348  /* "CH" */
+#define CONSOLE_HISTORY_HOOK_VERSION 2
+
+/* Most history carried across a sysjump.  The jump tags stay below the jump
+ * data for the life of the next image, out of its shared memory, so only the
+ * latest output is kept. */
+#define SYSJUMP_HISTORY_SIZE 512
+
+/* Data of the main sysjump tag; the chunks hold bytes start to head - 1 */
+struct console_history_jump {
+	uint32_t start;
+	uint32_t head;
+};
+
+/* A jump tag holds at most 255 bytes, so the history is saved in chunks, each
+ * in its own tag, numbered from this one */
+#define CONSOLE_HISTORY_CHUNK_TAG 0x6300  /* "c" + chunk number */
+#define CHUNK_SIZE 252
+
+#define HISTORY_MASK (CONFIG_CONSOLE_HISTORY_SIZE - 1)
+
+static char history[CONFIG_CONSOLE_HISTORY_SIZE];
+/* Number of bytes ever added; the next one goes in history[head & mask] */
+static uint32_t history_head;
+/* Number of the oldest byte kept, if the history hasn't wrapped since */
+static uint32_t history_start;
+
+/* Return the number of the oldest byte in the history */
+static uint32_t history_oldest(uint32_t head)
+{
+	if (head - history_start > CONFIG_CONSOLE_HISTORY_SIZE)
+		return head - CONFIG_CONSOLE_HISTORY_SIZE;
+	return history_start;
+}
+
+/* Copy len bytes of history from byte number pos */
+static void history_copy(uint8_t *dest, uint32_t pos, int len)
+{
+	int offs = pos & HISTORY_MASK;
+	int n = MIN(len, CONFIG_CONSOLE_HISTORY_SIZE - offs);
+
+	memcpy(dest, history + offs, n);
+	if (n < len)
+		memcpy(dest + n, history, len - n);
+}
+
+
+void console_history_add(const char *s, int len)
+{
+	uint32_t pos;
+	int offs, n;
+
+	/* Reserve the space, so other callers add theirs after it */
+	do {
+		pos = history_head;
+	} while (!atomic_cas(&history_head, pos, pos + len));
+
+	offs = pos & HISTORY_MASK;
+	n = MIN(len, CONFIG_CONSOLE_HISTORY_SIZE - offs);
+	memcpy(history + offs, s, n);
+	memcpy(history, s + n, len - n);
+}
+
+
+void console_history_init(void)
+{
+	const struct console_history_jump *prev;
+	const uint8_t *chunk;
+	uint32_t pos;
+	int version, size, n, i;
+
+	BUILD_ASSERT((CONFIG_CONSOLE_HISTORY_SIZE & HISTORY_MASK) == 0);
+
+	prev = (const struct console_history_jump *)system_get_jump_tag(
+		CONSOLE_HISTORY_SYSJUMP_TAG, &version, &size);
+	if (!prev || version != CONSOLE_HISTORY_HOOK_VERSION ||
+	    size != sizeof(*prev) || prev->head - prev->start >
+	    MIN(SYSJUMP_HISTORY_SIZE, CONFIG_CONSOLE_HISTORY_SIZE))
+		return;
+
+	/* Keep the byte numbers of the previous image, so hosts reading the
+	 * history carry on where they were */
+	for (i = 0, pos = prev->start; pos < prev->head; i++, pos += n) {
+		n = MIN(CHUNK_SIZE, prev->head - pos);
+		chunk = system_get_jump_tag(CONSOLE_HISTORY_CHUNK_TAG + i,
+					    &version, &size);
+		if (!chunk || version != CONSOLE_HISTORY_HOOK_VERSION ||
+		    size < n)
+			break;
+		memcpy(history + (pos & HISTORY_MASK), chunk, n);
+	}
+
+	/* If a chunk was missing, only the ones before it were restored */
+	history_start = prev->start;
+	history_head = pos;
+}
+
+
+static int console_history_sysjump(void)
+{
+	struct console_history_jump jump;
+	uint8_t chunk[CHUNK_SIZE];
+	uint32_t pos;
+	int n, i;
+
+	jump.head = history_head;
+	jump.start = history_oldest(jump.head);
+	if (jump.head - jump.start > SYSJUMP_HISTORY_SIZE)
+		jump.start = jump.head - SYSJUMP_HISTORY_SIZE;
+
+	if (system_add_jump_tag(CONSOLE_HISTORY_SYSJUMP_TAG,
+				CONSOLE_HISTORY_HOOK_VERSION,
+				sizeof(jump), &jump) != EC_SUCCESS)
+		return EC_SUCCESS;
+	for (i = 0, pos = jump.start; pos < jump.head; i++, pos += n) {
+		n = MIN(CHUNK_SIZE, jump.head - pos);
+		history_copy(chunk, pos, n);
+		/* Tag sizes must be a multiple of 4.  If RAM runs out, the
+		 * next image restores the chunks saved so far. */
+		if (system_add_jump_tag(CONSOLE_HISTORY_CHUNK_TAG + i,
+					CONSOLE_HISTORY_HOOK_VERSION,
+					(n + 3) & ~3, chunk) != EC_SUCCESS)
+			break;
+	}
+	return EC_SUCCESS;
+}
+/* Last, so the history has whatever the other sysjump hooks printed */
+DECLARE_HOOK(HOOK_SYSJUMP, console_history_sysjump, HOOK_PRIO_LAST);
+
+/*****************************************************************************/
+/* Host commands */
+
+static int console_history_read(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_console_read *p = args->params;
+	struct ec_response_console_read *r = args->response;
+	uint8_t *data = (uint8_t *)(r + 1);
+	uint32_t head = history_head;
+	uint32_t oldest = history_oldest(head);
+	uint32_t start = p->cursor;
+	int len, lost;
+
+	/* Start at the oldest byte if the ones wanted were overwritten, or
+	 * the EC was reset since the host got its cursor */
+	if (start < oldest || start > head)
+		start = oldest;
+
+	len = MIN(head - start, args->response_max - sizeof(*r));
+	history_copy(data, start, len);
+
+	/* Output printed during the copy may have overwritten the start */
+	lost = history_oldest(history_head) - start;
+	if (lost > 0) {
+		lost = MIN(lost, len);
+		len -= lost;
+		memmove(data, data + lost, len);
+		start += lost;
+	}
+
+	r->start = start;
+	r->head = head;
+	args->response_size = sizeof(*r) + len;
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_CONSOLE_READ,
+		     console_history_read,
+		     EC_VER_MASK(0));
@@ -6,6 +6,9 @@
 /* Console output module for Chrome EC */
 
 #include "console.h"
+#include "printf.h"
+#include "task.h"
+#include "timer.h"
 #include "uart.h"
 #include "util.h"
 
@@ -41,6 +44,209 @@ static const char *channel_names[CC_CHANNEL_COUNT] = {
 	"vboot",
 };
 
+#ifdef CONFIG_TASK_CONSOLELOG
+/*****************************************************************************/
+/* Deferred output
+ *
+ * Formatting costs a lot more than the call which asks for it, and some of the
+ * callers are interrupt handlers.  Instead, cputs() and cprintf() pack the
+ * format, the time and the arguments into a record in log_buf, and the
+ * CONSOLELOG task prints the records when nothing else needs the CPU.
+ * Records which don't fit in log_buf are counted and reported, not printed.
+ */
+
+/* Size of the record ring in words; must be a power of 2 */
+#ifndef CONFIG_CONSOLE_LOG_BUF_WORDS
+#define CONFIG_CONSOLE_LOG_BUF_WORDS 256
+#endif
+
+/* Most words of packed arguments in a record */
+#define LOG_ARGS_MAX 16
+
+/* Free space in the UART buffer needed before printing a record, so records
+ * printed in a burst aren't cut off */
+#define LOG_PRINT_ROOM 128
+
+/* How long to wait for room in the UART buffer */
+#define LOG_WAIT_US 1000
+
+/* Record header, followed by the packed arguments */
+struct log_record {
+	uint8_t words;		/* Record size in words, header included */
+	uint8_t channel;
+	uint16_t reserved;
+	const char *format;
+	uint64_t time;		/* Time of the call, printed for %T */
+};
+#define LOG_HEADER_WORDS (sizeof(struct log_record) / sizeof(uint32_t))
+
+static uint32_t log_buf[CONFIG_CONSOLE_LOG_BUF_WORDS];
+/* Words ever added and removed; indices into log_buf after masking */
+static uint32_t log_head, log_tail;
+static int log_enabled = 1;
+/* Records dropped and not yet reported, and statistics */
+static int log_dropped;
+static int log_dropped_total;
+static int log_records;
+static int log_max_words;
+/* Held while printing a record */
+static struct mutex log_print_mutex;
+
+/* Take the oldest record out of the ring into rec.  Returns 0 if there were
+ * no records, in which case *dropped is set to the drops not yet reported.
+ * Call with interrupts disabled. */
+static int log_pop(uint32_t *rec, int *dropped)
+{
+	const struct log_record *r = (const struct log_record *)rec;
+	int i;
+
+	if (log_head == log_tail) {
+		/* Report drops once everything before them is out */
+		*dropped = log_dropped;
+		log_dropped = 0;
+		return 0;
+	}
+	rec[0] = log_buf[log_tail & (CONFIG_CONSOLE_LOG_BUF_WORDS - 1)];
+	for (i = 1; i < r->words; i++)
+		rec[i] = log_buf[(log_tail + i) &
+				 (CONFIG_CONSOLE_LOG_BUF_WORDS - 1)];
+	log_tail += r->words;
+	return 1;
+}
+
+/* Print a record taken by log_pop(), or the drops if there was none */
+static void log_print_popped(int popped, const uint32_t *rec, int dropped)
+{
+	const struct log_record *r = (const struct log_record *)rec;
+
+	if (!popped) {
+		if (dropped)
+			uart_printf("\n[%d console messages dropped]\n",
+				    dropped);
+		return;
+	}
+
+	/* The channel may have been turned off since */
+	if (CC_MASK(r->channel) & channel_mask)
+		uart_printf_packed(r->format, rec + LOG_HEADER_WORDS, r->time);
+}
+
+/* Print the oldest record.  Returns 0 if there were no records. */
+static int log_print_one(void)
+{
+	uint32_t rec[LOG_HEADER_WORDS + LOG_ARGS_MAX];
+	int dropped, popped;
+	uint32_t irq;
+
+	irq = interrupt_disable_save();
+	popped = log_pop(rec, &dropped);
+	interrupt_restore(irq);
+
+	log_print_popped(popped, rec, dropped);
+	return popped;
+}
+
+/* Print the oldest record, without letting another task print one in the
+ * middle of it.  Returns 0 if there were no records. */
+static int log_print_next(void)
+{
+	int rv;
+
+	/* Interrupt handlers can't wait, so they take their chances */
+	if (in_interrupt_context())
+		return log_print_one();
+
+	mutex_lock(&log_print_mutex);
+	rv = log_print_one();
+	mutex_unlock(&log_print_mutex);
+	return rv;
+}
+
+/* Print all the records, waiting for room in the UART buffer as needed */
+static void log_flush(void)
+{
+	do {
+		if (uart_tx_buffer_space() < LOG_PRINT_ROOM)
+			uart_flush_output();
+	} while (log_print_next());
+}
+
+static int log_vprintf(enum console_channel channel, const char *format,
+		       va_list args)
+{
+	uint32_t rec[LOG_HEADER_WORDS + LOG_ARGS_MAX];
+	struct log_record *r = (struct log_record *)rec;
+	uint32_t irq;
+	int was_empty;
+	va_list va;
+	int n, i;
+
+	BUILD_ASSERT(CC_CHANNEL_COUNT <= 0x100);
+	BUILD_ASSERT((CONFIG_CONSOLE_LOG_BUF_WORDS &
+		      (CONFIG_CONSOLE_LOG_BUF_WORDS - 1)) == 0);
+
+	va_copy(va, args);
+	n = printf_pack(rec + LOG_HEADER_WORDS, LOG_ARGS_MAX, format, va);
+	va_end(va);
+	if (n < 0) {
+		/* Too big for a record, so print it now, after the records
+		 * already waiting */
+		log_flush();
+		return uart_vprintf(format, args);
+	}
+
+	r->words = LOG_HEADER_WORDS + n;
+	r->channel = channel;
+	r->reserved = 0;
+	r->format = format;
+	r->time = get_time().val;
+
+	/* Callers may print with interrupts masked; leave them that way */
+	irq = interrupt_disable_save();
+	if (log_head - log_tail + r->words > CONFIG_CONSOLE_LOG_BUF_WORDS) {
+		log_dropped++;
+		log_dropped_total++;
+		interrupt_restore(irq);
+		return EC_ERROR_OVERFLOW;
+	}
+	was_empty = (log_head == log_tail);
+	for (i = 0; i < r->words; i++)
+		log_buf[(log_head + i) & (CONFIG_CONSOLE_LOG_BUF_WORDS - 1)] =
+			rec[i];
+	log_head += r->words;
+	log_records++;
+	if (log_head - log_tail > log_max_words)
+		log_max_words = log_head - log_tail;
+	interrupt_restore(irq);
+
+	/* The task only waits once it has emptied the ring */
+	if (was_empty)
+		task_wake(TASK_ID_CONSOLELOG);
+	return EC_SUCCESS;
+}
+
+static int log_printf(enum console_channel channel, const char *format, ...)
+{
+	int rv;
+	va_list args;
+
+	va_start(args, format);
+	rv = log_vprintf(channel, format, args);
+	va_end(args);
+	return rv;
+}
+
+void console_log_task(void)
+{
+	while (1) {
+		if (uart_tx_buffer_space() < LOG_PRINT_ROOM)
+			usleep(LOG_WAIT_US);
+		else if (!log_print_next())
+			task_wait_event(-1);
+	}
+}
+#endif  /* CONFIG_TASK_CONSOLELOG */
+
 /*****************************************************************************/
 /* Channel-based console output */
 
@@ -50,6 +256,12 @@ int cputs(enum console_channel channel, const char *outstr)
 	if (!(CC_MASK(channel) & channel_mask))
 		return EC_SUCCESS;
 
+#ifdef CONFIG_TASK_CONSOLELOG
+	/* Console commands print straight away, so they stay interactive */
+	if (log_enabled && channel != CC_COMMAND)
+		return log_printf(channel, "%s", outstr);
+#endif
+
 	return uart_puts(outstr);
 }
 
@@ -64,7 +276,12 @@ int cprintf(enum console_channel channel, const char *format, ...)
 		return EC_SUCCESS;
 
 	va_start(args, format);
-	rv = uart_vprintf(format, args);
+#ifdef CONFIG_TASK_CONSOLELOG
+	if (log_enabled && channel != CC_COMMAND)
+		rv = log_vprintf(channel, format, args);
+	else
+#endif
+		rv = uart_vprintf(format, args);
 	va_end(args);
 	return rv;
 }
@@ -72,9 +289,30 @@ int cprintf(enum console_channel channel, const char *format, ...)
 
 void cflush(void)
 {
+#ifdef CONFIG_TASK_CONSOLELOG
+	log_flush();
+#endif
 	uart_flush_output();
 }
 
+void console_emergency_flush(void)
+{
+#ifdef CONFIG_TASK_CONSOLELOG
+	uint32_t rec[LOG_HEADER_WORDS + LOG_ARGS_MAX];
+	int dropped, popped;
+
+	/* The CONSOLELOG task may not run again before the reset, so print
+	 * the records here, without waiting on its mutex or changing the
+	 * interrupt state. */
+	do {
+		uart_emergency_flush();
+		popped = log_pop(rec, &dropped);
+		log_print_popped(popped, rec, dropped);
+	} while (popped);
+#endif
+	uart_emergency_flush();
+}
+
 /*****************************************************************************/
 /* Console commands */
 
@@ -113,3 +351,30 @@ DECLARE_CONSOLE_COMMAND(chan, command_ch,
 			"[mask]",
 			"Get or set console channel mask",
 			NULL);
+
+#ifdef CONFIG_TASK_CONSOLELOG
+static int command_deferlog(int argc, char **argv)
+{
+	if (argc == 2) {
+		if (!strcasecmp(argv[1], "on"))
+			log_enabled = 1;
+		else if (!strcasecmp(argv[1], "off"))
+			log_enabled = 0;
+		else
+			return EC_ERROR_PARAM1;
+		/* Keep output in order across the switch */
+		cflush();
+	}
+
+	ccprintf("Deferred output: %s\n", log_enabled ? "on" : "off");
+	ccprintf("Records:   %d\n", log_records);
+	ccprintf("Dropped:   %d\n", log_dropped_total);
+	ccprintf("Max words: %d / %d\n", log_max_words,
+		 CONFIG_CONSOLE_LOG_BUF_WORDS);
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(deferlog, command_deferlog,
+			"[on | off]",
+			"Get or set deferred console output",
+			NULL);
+#endif
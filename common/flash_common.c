@@ -227,13 +227,13 @@ DECLARE_HOST_COMMAND(EC_CMD_FLASH_INFO,
 static int flash_command_read(struct host_cmd_handler_args *args)
 {
 	const struct ec_params_flash_read *p = args->params;
+	char *data;
 
-	if (flash_dataptr(p->offset, p->size, 1, (char **)&args->response) < 0)
+	if (flash_dataptr(p->offset, p->size, 1, &data) < 0)
 		return EC_RES_ERROR;
 
-	args->response_size = p->size;
-
-	return EC_RES_SUCCESS;
+	/* Sent straight from flash */
+	return host_response_from(args, data, p->size);
 }
 DECLARE_HOST_COMMAND(EC_CMD_FLASH_READ,
 		     flash_command_read,
@@ -242,8 +242,16 @@ DECLARE_HOST_COMMAND(EC_CMD_FLASH_READ,
 static int flash_command_write(struct host_cmd_handler_args *args)
 {
 	const struct ec_params_flash_write *p = args->params;
+	int data_max = sizeof(p->data);
 
-	if (p->size > sizeof(p->data))
+	/* Version 1 data fills the params */
+	if (args->version == 1) {
+		if (args->params_size < sizeof(*p) - sizeof(p->data))
+			return EC_RES_INVALID_PARAM;
+		data_max = args->params_size - (sizeof(*p) - sizeof(p->data));
+	}
+
+	if (p->size > data_max)
 		return EC_RES_INVALID_PARAM;
 
 	if (system_unsafe_to_overwrite(p->offset, p->size))
@@ -254,9 +262,9 @@ static int flash_command_write(struct host_cmd_handler_args *args)
 
 	return EC_RES_SUCCESS;
 }
-DECLARE_HOST_COMMAND(EC_CMD_FLASH_WRITE,
-		     flash_command_write,
-		     EC_VER_MASK(0));
+DECLARE_HOST_COMMAND_FLASH(EC_CMD_FLASH_WRITE,
+			   flash_command_write,
+			   EC_VER_MASK(0) | EC_VER_MASK(1));
 
 static int flash_command_erase(struct host_cmd_handler_args *args)
 {
@@ -270,9 +278,9 @@ static int flash_command_erase(struct host_cmd_handler_args *args)
 
 	return EC_RES_SUCCESS;
 }
-DECLARE_HOST_COMMAND(EC_CMD_FLASH_ERASE,
-		     flash_command_erase,
-		     EC_VER_MASK(0));
+DECLARE_HOST_COMMAND_SLOW(EC_CMD_FLASH_ERASE,
+			  flash_command_erase,
+			  EC_VER_MASK(0));
 
 static int flash_command_protect(struct host_cmd_handler_args *args)
 {
@@ -329,9 +337,9 @@ static int flash_command_protect(struct host_cmd_handler_args *args)
 
 	return EC_RES_SUCCESS;
 }
-DECLARE_HOST_COMMAND(EC_CMD_FLASH_PROTECT,
-		     flash_command_protect,
-		     EC_VER_MASK(1));
+DECLARE_HOST_COMMAND_FLASH(EC_CMD_FLASH_PROTECT,
+			   flash_command_protect,
+			   EC_VER_MASK(1));
 
 static int flash_command_region_info(struct host_cmd_handler_args *args)
 {
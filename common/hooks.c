@@ -5,8 +5,12 @@
 
 /* System hooks for Chrome EC */
 
+#include "console.h"
 #include "hooks.h"
+#include "host_command.h"
 #include "link_defs.h"
+#include "soft_timer.h"
+#include "timer.h"
 #include "util.h"
 
 struct hook_ptrs {
@@ -28,42 +32,198 @@ static const struct hook_ptrs hook_list[] = {
 	{__hooks_lid_change, __hooks_lid_change_end},
 };
 
+/* Set once the hooks of each type are sorted by priority, at the first
+ * notification, so hook_notify() doesn't have to search for the next
+ * priority. */
+static int hook_order_ready;
+
+/* Time taken by the last notification of each type */
+static uint32_t hook_type_last_us[ARRAY_SIZE(hook_list)];
+
+
+/* Sort the hooks of each type by priority, into the call pointers of their
+ * states.  Hooks of the same priority stay in link order, as they were called
+ * before. */
+static void hook_sort(void)
+{
+	int type, i, j;
+
+	for (type = 0; type < ARRAY_SIZE(hook_list); type++) {
+		const struct hook_data *start = hook_list[type].start;
+		int count = hook_list[type].end - start;
+
+		/* Insertion sort; there are only a few hooks of each type */
+		for (i = 0; i < count; i++) {
+			int prio = start[i].priority;
+
+			for (j = i; j > 0 &&
+			     start[j - 1].state->call->priority > prio; j--)
+				start[j].state->call = start[j - 1].state->call;
+			start[j].state->call = start + i;
+		}
+	}
+
+	hook_order_ready = 1;
+}
+
 
 int hook_notify(enum hook_type type, int stop_on_error)
 {
-	const struct hook_data *start, *end, *p;
-	int count, called = 0;
-	int last_prio = HOOK_PRIO_FIRST - 1, prio;
+	const struct hook_data *p;
 	int rv_error = EC_SUCCESS, rv;
+	timestamp_t t0, t1;
+	uint32_t start;
 
-	start = hook_list[type].start;
-	end = hook_list[type].end;
-	count = ((uint32_t)end - (uint32_t)start) / sizeof(struct hook_data);
+	/* The first notification comes from main() before task scheduling
+	 * starts: HOOK_INIT, or HOOK_SYSJUMP if vboot jumps to another image
+	 * first.  So nothing can race with the sort. */
+	if (!hook_order_ready)
+		hook_sort();
+
+	start = get_time().le.lo;
 
 	/* Call all the hooks in priority order */
-	while (called < count) {
-		/* Find the lowest remaining priority */
-		for (p = start, prio = HOOK_PRIO_LAST + 1; p < end; p++) {
-			if (p->priority < prio && p->priority > last_prio)
-				prio = p->priority;
-		}
-		last_prio = prio;
-
-		/* Call all the hooks with that priority */
-		for (p = start; p < end; p++) {
-			if (p->priority == prio) {
-				called++;
-				rv = p->routine();
-				if (rv != EC_SUCCESS) {
-					if (stop_on_error)
-						return rv;
-					else if (rv_error == EC_SUCCESS)
-						rv_error = rv;
-				}
-			}
+	for (p = hook_list[type].start; p < hook_list[type].end; p++) {
+		const struct hook_data *h = p->state->call;
+
+		t0 = get_time();
+		rv = h->routine();
+		t1 = get_time();
+
+		h->state->last_us = t1.le.lo - t0.le.lo;
+		if (h->state->last_us > h->state->max_us)
+			h->state->max_us = h->state->last_us;
+
+		if (rv != EC_SUCCESS) {
+			if (stop_on_error) {
+				rv_error = rv;
+				break;
+			} else if (rv_error == EC_SUCCESS)
+				rv_error = rv;
 		}
 	}
 
+	hook_type_last_us[type] = get_time().le.lo - start;
+
 	/* Return the first error seen, if any */
 	return rv_error;
 }
+
+
+#ifdef CONFIG_TASK_SOFTTIMER
+
+/* Timers used for the deferred calls; same order as __deferred_funcs */
+static struct soft_timer deferred_timers[DEFERRABLE_MAX_COUNT];
+
+
+static void deferred_call(void *data)
+{
+	((const struct deferred_data *)data)->routine();
+}
+
+
+int hook_call_deferred(void (*routine)(void), int us)
+{
+	const struct deferred_data *p;
+	struct soft_timer *timer;
+
+	for (p = __deferred_funcs; p < __deferred_funcs_end; p++) {
+		if (p->routine == routine)
+			break;
+	}
+	if (p == __deferred_funcs_end)
+		return EC_ERROR_INVAL;  /* Not a deferrable function */
+	if (p - __deferred_funcs >= DEFERRABLE_MAX_COUNT)
+		return EC_ERROR_OVERFLOW;
+
+	timer = deferred_timers + (p - __deferred_funcs);
+	if (us == -1) {
+		soft_timer_stop(timer);
+		return EC_SUCCESS;
+	}
+
+	timer->routine = deferred_call;
+	timer->data = (void *)p;
+	return soft_timer_start(timer, us, 0);
+}
+
+#endif  /* CONFIG_TASK_SOFTTIMER */
+
+/*****************************************************************************/
+/* Console commands */
+
+static int command_hook_stats(int argc, char **argv)
+{
+	static const char * const type_names[] = {
+		"init", "freq_change", "sysjump", "chipset_startup",
+		"chipset_resume", "chipset_suspend", "chipset_shutdown",
+		"ac_change", "lid_change",
+	};
+	const struct hook_data *p;
+	int type;
+
+	BUILD_ASSERT(ARRAY_SIZE(type_names) == ARRAY_SIZE(hook_list));
+
+	if (!hook_order_ready)
+		hook_sort();
+
+	for (type = 0; type < ARRAY_SIZE(hook_list); type++) {
+		ccprintf("%s: last %d us\n", type_names[type],
+			 hook_type_last_us[type]);
+		for (p = hook_list[type].start; p < hook_list[type].end; p++) {
+			const struct hook_data *h = p->state->call;
+
+			ccprintf("  0x%08x  prio %4d  last %8d us"
+				 "  max %8d us\n",
+				 (uint32_t)h->routine, h->priority,
+				 h->state->last_us, h->state->max_us);
+		}
+		cflush();
+	}
+
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(hookstats, command_hook_stats,
+			NULL,
+			"Print hook execution times",
+			NULL);
+
+/*****************************************************************************/
+/* Host commands */
+
+static int hook_command_stats(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_hook_stats *p = args->params;
+	struct ec_response_hook_stats *r = args->response;
+	const struct hook_data *h;
+	int count;
+
+	if (p->type >= ARRAY_SIZE(hook_list))
+		return EC_RES_INVALID_PARAM;
+
+	count = hook_list[p->type].end - hook_list[p->type].start;
+
+	if (!hook_order_ready)
+		hook_sort();
+
+	r->type_count = ARRAY_SIZE(hook_list);
+	r->hook_count = count;
+	r->reserved[0] = r->reserved[1] = 0;
+	r->type_last_us = hook_type_last_us[p->type];
+	if (p->index < count) {
+		h = hook_list[p->type].start[p->index].state->call;
+		r->routine = (uint32_t)h->routine;
+		r->priority = h->priority;
+		r->last_us = h->state->last_us;
+		r->max_us = h->state->max_us;
+	} else {
+		r->routine = r->priority = r->last_us = r->max_us = 0;
+	}
+
+	args->response_size = sizeof(*r);
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_HOOK_STATS,
+		     hook_command_stats,
+		     EC_VER_MASK(0));
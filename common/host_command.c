@@ -5,12 +5,15 @@
 
 /* Host command module for Chrome EC */
 
+#include "boot_time.h"
 #include "common.h"
 #include "console.h"
 #include "ec_commands.h"
+#include "hooks.h"
 #include "host_command.h"
 #include "link_defs.h"
 #include "lpc.h"
+#include "shared_mem.h"
 #include "system.h"
 #include "task.h"
 #include "timer.h"
@@ -22,7 +25,25 @@
 
 #define TASK_EVENT_CMD_PENDING TASK_EVENT_CUSTOM(1)
 
-static struct host_cmd_handler_args *pending_args;
+/* Queue of received commands.  Size must be a power of 2. */
+#define HOST_CMD_QUEUE_SIZE 4
+
+static struct host_cmd_handler_args *cmd_queue[HOST_CMD_QUEUE_SIZE];
+static uint32_t cmd_queue_time[HOST_CMD_QUEUE_SIZE];  /* When received */
+static uint32_t cmd_queue_head;  /* Next command to process */
+static uint32_t cmd_queue_tail;  /* Next free slot */
+
+#ifdef CONFIG_TASK_HCSLOW
+/*
+ * Slow command running in the background.  It gets its own copy of the args
+ * and a private buffer for params and response, since the transport buffer is
+ * reused by the next command.
+ */
+static struct host_cmd_handler_args slow_args;
+static uint8_t slow_buf[EC_HOST_PARAM_SIZE];
+static volatile int slow_busy;
+static enum ec_status slow_result = EC_RES_UNAVAILABLE;
+#endif
 
 #ifndef CONFIG_LPC
 static uint8_t host_memmap[EC_MEMMAP_SIZE];
@@ -30,6 +51,10 @@ static uint8_t host_memmap[EC_MEMMAP_SIZE];
 
 static int hcdebug;  /* Enable extra host command debug output */
 
+static const struct host_command *find_host_command(int command);
+static enum ec_status host_command_dispatch(const struct host_command *cmd,
+					    struct host_cmd_handler_args *args);
+
 uint8_t *host_get_memmap(int offset)
 {
 #ifdef CONFIG_LPC
@@ -41,7 +66,10 @@ uint8_t *host_get_memmap(int offset)
 
 void host_command_received(struct host_cmd_handler_args *args)
 {
-	/* TODO: should warn if we already think we're in a command */
+	const struct host_command *cmd;
+	uint32_t i;
+	int queued = 0;
+	int fast;
 
 	/*
 	 * If this is the reboot command, reboot immediately.  This gives the
@@ -57,29 +85,293 @@ void host_command_received(struct host_cmd_handler_args *args)
 	/* If the driver has signalled an error, send the response now */
 	if (args->result) {
 		args->send_response(args);
+		return;
+	}
+
+	cmd = find_host_command(args->command);
+	fast = cmd && (cmd->flags & HOST_CMD_FLAG_FAST);
+
+	/* Commands may arrive from several transports at different interrupt
+	 * priorities, so the queue is only touched with interrupts off. */
+	interrupt_disable();
+
+	/* A transport with a command still queued has overwritten it with
+	 * this one, so there's nothing more to queue. */
+	for (i = cmd_queue_head; i != cmd_queue_tail; i++) {
+		if (cmd_queue[i & (HOST_CMD_QUEUE_SIZE - 1)] == args) {
+			queued = 1;
+			break;
+		}
+	}
+	if (!queued && !fast &&
+	    cmd_queue_tail - cmd_queue_head < HOST_CMD_QUEUE_SIZE) {
+		i = cmd_queue_tail++ & (HOST_CMD_QUEUE_SIZE - 1);
+		cmd_queue[i] = args;
+		cmd_queue_time[i] = get_time().le.lo;
+		queued = 2;
+	}
+
+	interrupt_enable();
+
+	if (queued == 1) {
+		CPRINTF("[%T HC overlap 0x%02x]\n", args->command);
+	} else if (fast) {
+		/*
+		 * Trivial command; run it now, instead of waking the task.
+		 * Quietly, since this is interrupt context.
+		 */
+		args->result = host_command_dispatch(cmd, args);
+		args->send_response(args);
+		return;
+	} else if (!queued) {
+		/* Queue is full; one per transport means this shouldn't
+		 * happen. */
+		args->result = EC_RES_BUSY;
+		args->send_response(args);
+		return;
+	}
+
+	/* Wake up the task to handle the command */
+	task_set_event(TASK_ID_HOSTCMD, TASK_EVENT_CMD_PENDING, 0);
+}
+
+/*
+ * Remove the next command from the queue, and set *received_time to when it
+ * was received.  Returns NULL if the queue is empty.
+ */
+static struct host_cmd_handler_args *host_command_dequeue(
+	uint32_t *received_time)
+{
+	struct host_cmd_handler_args *args = NULL;
+	uint32_t i;
+
+	interrupt_disable();
+	if (cmd_queue_head != cmd_queue_tail) {
+		i = cmd_queue_head++ & (HOST_CMD_QUEUE_SIZE - 1);
+		args = cmd_queue[i];
+		*received_time = cmd_queue_time[i];
+	}
+	interrupt_enable();
+
+	return args;
+}
+
+/*****************************************************************************/
+/* Protocol version 3 */
+
+/*
+ * Release the buffer for a multi-packet command, if any, and forget the
+ * command, so no more params packets are taken for it.
+ */
+static void host_packet_release(struct host_packet *pkt)
+{
+	if (pkt->buf) {
+		shared_mem_release(pkt->buf);
+		pkt->buf = NULL;
+	}
+	pkt->received = 0;
+	pkt->args.params_size = 0;
+}
+
+/*
+ * Send a reply packet.  If a response is available, it holds the response
+ * data from pkt->sent on, as much as fits.  The packet is padded to the size
+ * the host asked for, since I2C hosts read a fixed number of bytes.
+ */
+static void host_packet_reply(struct host_packet *pkt, enum ec_status result)
+{
+	struct ec_host_response *r = pkt->response;
+	uint8_t *out = (uint8_t *)(r + 1);
+	int total = pkt->have_response ? pkt->args.response_size : 0;
+	int len = MIN(total - pkt->sent, pkt->data_max);
+
+	if (len > 0) {
+		const uint8_t *src = (const uint8_t *)pkt->args.response +
+			pkt->sent;
+
+		if (src != out)
+			memmove(out, src, len);
+	} else {
+		len = 0;
+	}
+
+	r->struct_version = EC_HOST_RESPONSE_VERSION;
+	r->checksum = 0;
+	r->result = result;
+	r->reserved = 0;
+	r->data_len = len;
+	r->offset = pkt->sent;
+	r->total_len = total;
+	r->reserved2[0] = r->reserved2[1] = r->reserved2[2] = 0;
+
+	r->checksum = -sum_bytes(r, sizeof(*r) + len);
+
+	memset(out + len, 0, pkt->data_max - len);
+	pkt->response_size = sizeof(*r) + pkt->data_max;
+
+	/* Done with the response once it has all been sent.  Other replies,
+	 * such as asking for more params, keep the command. */
+	pkt->sent += len;
+	if (pkt->have_response && pkt->sent >= total) {
+		pkt->have_response = 0;
+		host_packet_release(pkt);
+	}
+
+	pkt->send_response(pkt);
+}
+
+/* Send the response to a multi-packet or single packet command */
+static void host_packet_respond(struct host_cmd_handler_args *args)
+{
+	struct host_packet *pkt = (struct host_packet *)args;
+
+	/* Errors have no response data */
+	if (args->result != EC_RES_SUCCESS)
+		args->response_size = 0;
+
+	pkt->sent = 0;
+	pkt->have_response = 1;
+	host_packet_reply(pkt, args->result);
+}
+
+void host_packet_receive(struct host_packet *pkt)
+{
+	const struct ec_host_request *r = pkt->request;
+	const uint8_t *data = (const uint8_t *)(r + 1);
+	struct host_cmd_handler_args *args = &pkt->args;
+
+	/* Reply to a bad header with as little data as possible */
+	pkt->data_max = 0;
+
+	if (pkt->request_size < sizeof(*r) ||
+	    r->struct_version != EC_HOST_REQUEST_VERSION ||
+	    sizeof(*r) + r->data_len > pkt->request_size) {
+		host_packet_reply(pkt, EC_RES_INVALID_PARAM);
+		return;
+	}
+
+	if ((uint8_t)sum_bytes(r, sizeof(*r) + r->data_len)) {
+		host_packet_reply(pkt, EC_RES_INVALID_CHECKSUM);
+		return;
+	}
+
+	pkt->data_max = MIN(r->response_max, pkt->response_max -
+			    sizeof(struct ec_host_response));
+
+	/* Next part of the response */
+	if (r->flags & EC_HOST_REQUEST_FLAG_FETCH) {
+		if (!pkt->have_response || r->command != args->command ||
+		    r->offset != pkt->sent) {
+			pkt->have_response = 0;
+			host_packet_release(pkt);
+			host_packet_reply(pkt, EC_RES_INVALID_PARAM);
+		} else {
+			host_packet_reply(pkt, EC_RES_SUCCESS);
+		}
+		return;
+	}
+
+	/* Params; the first packet starts a new command */
+	if (r->offset == 0) {
+		pkt->have_response = 0;
+		host_packet_release(pkt);
+		args->command = r->command;
+		args->version = r->command_version;
+		args->params_size = r->total_len;
+	}
+
+	/* Later packets only continue a multi-packet command */
+	if (r->offset != pkt->received || r->command != args->command ||
+	    r->total_len != args->params_size ||
+	    r->offset + r->data_len > r->total_len ||
+	    (r->offset && !pkt->buf)) {
+		host_packet_release(pkt);
+		host_packet_reply(pkt, EC_RES_INVALID_PARAM);
+		return;
+	}
+
+	if (r->data_len == r->total_len) {
+		/* Whole command in one packet; process it in place */
+		args->params = data;
+		args->response = (uint8_t *)pkt->response +
+			sizeof(struct ec_host_response);
+		args->response_max = pkt->response_max -
+			sizeof(struct ec_host_response);
 	} else {
-		/* Save the command */
-		pending_args = args;
+		if (r->offset == 0) {
+			/* Room for a full size response to any command */
+			int size = MAX(r->total_len, EC_HOST_PARAM_SIZE);
+
+			if (size > shared_mem_size()) {
+				host_packet_reply(pkt, EC_RES_INVALID_PARAM);
+				return;
+			}
+			if (shared_mem_acquire(size, 0, (char **)&pkt->buf) !=
+			    EC_SUCCESS) {
+				host_packet_reply(pkt, EC_RES_BUSY);
+				return;
+			}
+			args->response_max = size;
+		}
 
-		/* Wake up the task to handle the command */
-		task_set_event(TASK_ID_HOSTCMD, TASK_EVENT_CMD_PENDING, 0);
+		memcpy(pkt->buf + r->offset, data, r->data_len);
+		pkt->received += r->data_len;
+
+		if (pkt->received < r->total_len) {
+			/* Ask for more */
+			host_packet_reply(pkt, EC_RES_SUCCESS);
+			return;
+		}
+
+		args->params = pkt->buf;
+		args->response = pkt->buf;
 	}
+
+	args->send_response = host_packet_respond;
+	args->transport = pkt->transport;
+	args->response_size = 0;
+	args->result = EC_RES_SUCCESS;
+	host_command_received(args);
 }
 
 /*
- * Find a command by command number.  Returns the command structure, or NULL if
- * no match found.
+ * Index of each command in __hcmds by command number, so finding a command
+ * doesn't have to search the whole section.  HCMD_NONE if not supported.
  */
-static const struct host_command *find_host_command(int command)
+#define HCMD_NONE 0xff
+static uint8_t hcmd_index[256];
+
+static int host_command_index_init(void)
 {
 	const struct host_command *cmd;
 
-	for (cmd = __hcmds; cmd < __hcmds_end; cmd++) {
-		if (command == cmd->command)
-			return cmd;
+	ASSERT(__hcmds_end - __hcmds < HCMD_NONE);
+
+	memset(hcmd_index, HCMD_NONE, sizeof(hcmd_index));
+
+	/* Backwards, so the first declaration of a command wins as before */
+	for (cmd = __hcmds_end - 1; cmd >= __hcmds; cmd--) {
+		if (cmd->command >= 0 && cmd->command < ARRAY_SIZE(hcmd_index))
+			hcmd_index[cmd->command] = cmd - __hcmds;
 	}
 
-	return NULL;
+	return EC_SUCCESS;
+}
+/* First, since commands may be processed as soon as HOOK_INIT sets up the
+ * host interface */
+DECLARE_HOOK(HOOK_INIT, host_command_index_init, HOOK_PRIO_FIRST);
+
+/*
+ * Find a command by command number.  Returns the command structure, or NULL if
+ * no match found.
+ */
+static const struct host_command *find_host_command(int command)
+{
+	if (command < 0 || command >= ARRAY_SIZE(hcmd_index) ||
+	    hcmd_index[command] == HCMD_NONE)
+		return NULL;
+
+	return __hcmds + hcmd_index[command];
 }
 
 static int host_command_proto_version(struct host_cmd_handler_args *args)
@@ -91,9 +383,9 @@ static int host_command_proto_version(struct host_cmd_handler_args *args)
 
 	return EC_RES_SUCCESS;
 }
-DECLARE_HOST_COMMAND(EC_CMD_PROTO_VERSION,
-		     host_command_proto_version,
-		     EC_VER_MASK(0));
+DECLARE_HOST_COMMAND_FAST(EC_CMD_PROTO_VERSION,
+			  host_command_proto_version,
+			  EC_VER_MASK(0));
 
 static int host_command_hello(struct host_cmd_handler_args *args)
 {
@@ -106,9 +398,9 @@ static int host_command_hello(struct host_cmd_handler_args *args)
 
 	return EC_RES_SUCCESS;
 }
-DECLARE_HOST_COMMAND(EC_CMD_HELLO,
-		     host_command_hello,
-		     EC_VER_MASK(0));
+DECLARE_HOST_COMMAND_FAST(EC_CMD_HELLO,
+			  host_command_hello,
+			  EC_VER_MASK(0));
 
 static int host_command_read_test(struct host_cmd_handler_args *args)
 {
@@ -150,14 +442,11 @@ static int host_command_read_memmap(struct host_cmd_handler_args *args)
 	    offset + size > EC_MEMMAP_SIZE)
 		return EC_RES_INVALID_PARAM;
 
-	args->response = host_get_memmap(offset);
-	args->response_size = size;
-
-	return EC_RES_SUCCESS;
+	return host_response_from(args, host_get_memmap(offset), size);
 }
-DECLARE_HOST_COMMAND(EC_CMD_READ_MEMMAP,
-		     host_command_read_memmap,
-		     EC_VER_MASK(0));
+DECLARE_HOST_COMMAND_FAST(EC_CMD_READ_MEMMAP,
+			  host_command_read_memmap,
+			  EC_VER_MASK(0));
 #endif
 
 static int host_command_get_cmd_versions(struct host_cmd_handler_args *args)
@@ -176,13 +465,213 @@ static int host_command_get_cmd_versions(struct host_cmd_handler_args *args)
 
 	return EC_RES_SUCCESS;
 }
-DECLARE_HOST_COMMAND(EC_CMD_GET_CMD_VERSIONS,
-		     host_command_get_cmd_versions,
+DECLARE_HOST_COMMAND_FAST(EC_CMD_GET_CMD_VERSIONS,
+			  host_command_get_cmd_versions,
+			  EC_VER_MASK(0));
+
+static int host_command_get_cmd_list(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_get_cmd_list *p = args->params;
+	struct ec_response_get_cmd_list *r = args->response;
+	int c = p->start_cmd;  /* Read before the response overwrites it */
+	int header = sizeof(*r) - sizeof(r->entry);
+	int n_max = MIN((args->response_max - header) /
+			(int)sizeof(r->entry[0]),
+			EC_CMD_LIST_MAX_ENTRIES);
+	int n = 0;
+
+	if (n_max <= 0)
+		return EC_RES_INVALID_PARAM;
+
+	for (; c < ARRAY_SIZE(hcmd_index); c++) {
+		if (hcmd_index[c] == HCMD_NONE)
+			continue;
+		if (n == n_max)
+			break;
+		r->entry[n].cmd = c;
+		r->entry[n].version_mask = __hcmds[hcmd_index[c]].version_mask;
+		n++;
+	}
+
+	memset(r->entry + n, 0, (n_max - n) * sizeof(r->entry[0]));
+	r->count = n;
+	r->more = (c < ARRAY_SIZE(hcmd_index));
+	r->reserved[0] = r->reserved[1] = 0;
+
+	/* As many entries as the transport has room for, whether or not they
+	 * are used, so I2C hosts get the full response they read */
+	args->response_size = header + n_max * sizeof(r->entry[0]);
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_GET_CMD_LIST,
+		     host_command_get_cmd_list,
+		     EC_VER_MASK(0));
+
+/*****************************************************************************/
+/* Statistics */
+
+#ifdef CONFIG_HOST_COMMAND_STATS
+static uint32_t hcmd_unknown_calls;
+
+/* Return the statistics for a command, or NULL if it isn't supported */
+static struct host_command_stats *hcstats_find(int command)
+{
+	if (command < 0 || command >= ARRAY_SIZE(hcmd_index) ||
+	    hcmd_index[command] == HCMD_NONE)
+		return NULL;
+
+	return __hcmds[hcmd_index[command]].stats;
+}
+
+static uint16_t saturate_u16(uint32_t v)
+{
+	return v > 0xffff ? 0xffff : v;
+}
+
+/* Record a call to a command, which took us microseconds.  Fast commands
+ * record from interrupt context, so the update is done with interrupts
+ * masked. */
+static void hcstats_record(int command, enum ec_status rv, uint32_t us)
+{
+	struct host_command_stats *s = hcstats_find(command);
+	uint32_t irq;
+
+	if (!s)
+		return;
+
+	irq = interrupt_disable_save();
+	if (!s->calls || us < s->min_us)
+		s->min_us = us;
+	if (us > s->max_us)
+		s->max_us = us;
+	s->total_us += us;
+	s->calls++;
+	if (rv != EC_RES_SUCCESS && rv != EC_RES_IN_PROGRESS)
+		s->errors++;
+	interrupt_restore(irq);
+}
+
+/* Record how long a command waited in the queue */
+static void hcstats_queued(int command, uint32_t us)
+{
+	struct host_command_stats *s = hcstats_find(command);
+	uint32_t irq;
+
+	if (!s)
+		return;
+
+	irq = interrupt_disable_save();
+	s->total_queue_us += us;
+	if (us > s->max_queue_us)
+		s->max_queue_us = us;
+	interrupt_restore(irq);
+}
+
+static void hcstats_clear(void)
+{
+	const struct host_command *cmd;
+
+	for (cmd = __hcmds; cmd < __hcmds_end; cmd++)
+		memset(cmd->stats, 0, sizeof(*cmd->stats));
+	hcmd_unknown_calls = 0;
+}
+
+static int host_command_stats(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_host_cmd_stats *p = args->params;
+	struct ec_response_host_cmd_stats *r = args->response;
+	int c = p->start_cmd;  /* Read before the response overwrites it */
+	int header = sizeof(*r) - sizeof(r->entry);
+	int n_max = MIN((args->response_max - header) /
+			(int)sizeof(r->entry[0]),
+			EC_HOST_CMD_STATS_MAX_ENTRIES);
+	int n = 0;
+
+	if (n_max <= 0)
+		return EC_RES_INVALID_PARAM;
+
+	if (p->flags & EC_HOST_CMD_STATS_FLAG_CLEAR) {
+		hcstats_clear();
+		c = ARRAY_SIZE(hcmd_index);
+	}
+
+	for (; c < ARRAY_SIZE(hcmd_index); c++) {
+		const struct host_command_stats *s = hcstats_find(c);
+
+		if (!s || !s->calls)
+			continue;
+		if (n == n_max)
+			break;
+		r->entry[n].cmd = c;
+		r->entry[n].reserved = 0;
+		r->entry[n].errors = saturate_u16(s->errors);
+		r->entry[n].calls = s->calls;
+		r->entry[n].total_us = s->total_us;
+		r->entry[n].total_queue_us = s->total_queue_us;
+		r->entry[n].min_us = saturate_u16(s->min_us);
+		r->entry[n].max_us = saturate_u16(s->max_us);
+		r->entry[n].max_queue_us = saturate_u16(s->max_queue_us);
+		r->entry[n].reserved2 = 0;
+		n++;
+	}
+
+	memset(r->entry + n, 0, (n_max - n) * sizeof(r->entry[0]));
+	r->count = n;
+	r->more = (c < ARRAY_SIZE(hcmd_index));
+	r->reserved[0] = r->reserved[1] = 0;
+	r->unknown_calls = hcmd_unknown_calls;
+
+	/* As many entries as the transport has room for, whether or not they
+	 * are used, so I2C hosts get the full response they read */
+	args->response_size = header + n_max * sizeof(r->entry[0]);
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_HOST_CMD_STATS,
+		     host_command_stats,
 		     EC_VER_MASK(0));
 
+#else
+static inline void hcstats_record(int command, enum ec_status rv,
+				  uint32_t us) { }
+static inline void hcstats_queued(int command, uint32_t us) { }
+#endif  /* CONFIG_HOST_COMMAND_STATS */
+
+/* Check the version and run a command, without any debug output */
+static enum ec_status host_command_dispatch(const struct host_command *cmd,
+					    struct host_cmd_handler_args *args)
+{
+	enum ec_status rv;
+	timestamp_t t0;
+
+	if (!cmd) {
+#ifdef CONFIG_HOST_COMMAND_STATS
+		hcmd_unknown_calls++;
+#endif
+		return EC_RES_INVALID_COMMAND;
+	}
+
+	if (!(EC_VER_MASK(args->version) & cmd->version_mask)) {
+		rv = EC_RES_INVALID_VERSION;
+		hcstats_record(args->command, rv, 0);
+#ifdef CONFIG_TASK_HCSLOW
+	} else if ((cmd->flags & HOST_CMD_FLAG_FLASH) && slow_busy) {
+		/* Would change flash under the slow command */
+		rv = EC_RES_BUSY;
+		hcstats_record(args->command, rv, 0);
+#endif
+	} else {
+		t0 = get_time();
+		rv = cmd->handler(args);
+		hcstats_record(args->command, rv, get_time().le.lo - t0.le.lo);
+	}
+
+	return rv;
+}
+
 enum ec_status host_command_process(struct host_cmd_handler_args *args)
 {
-	const struct host_command *cmd = find_host_command(args->command);
 	enum ec_status rv;
 
 	if (hcdebug && args->params_size)
@@ -191,12 +680,7 @@ enum ec_status host_command_process(struct host_cmd_handler_args *args)
 	else
 		CPRINTF("[%T HC 0x%02x]\n", args->command);
 
-	if (!cmd)
-		rv = EC_RES_INVALID_COMMAND;
-	else if (!(EC_VER_MASK(args->version) & cmd->version_mask))
-		rv = EC_RES_INVALID_VERSION;
-	else
-		rv = cmd->handler(args);
+	rv = host_command_dispatch(find_host_command(args->command), args);
 
 	if (rv != EC_RES_SUCCESS) {
 		CPRINTF("[%T HC err %d]\n", rv);
@@ -208,6 +692,228 @@ enum ec_status host_command_process(struct host_cmd_handler_args *args)
 	return rv;
 }
 
+#ifdef CONFIG_TASK_HCSLOW
+static void slow_send_response(struct host_cmd_handler_args *args)
+{
+	/* Nothing to do; result is kept for EC_CMD_RESEND_RESPONSE */
+}
+
+/*
+ * Hand a slow command to the slow command task.  Returns EC_RES_IN_PROGRESS
+ * if started, or an error if the command can't be started now.
+ */
+static enum ec_status host_command_start_slow(
+	struct host_cmd_handler_args *args)
+{
+	if (slow_busy)
+		return EC_RES_BUSY;
+	if (args->params_size > sizeof(slow_buf))
+		return EC_RES_INVALID_PARAM;
+
+	slow_args = *args;
+	memcpy(slow_buf, args->params, args->params_size);
+	slow_args.send_response = slow_send_response;
+	slow_args.params = slow_buf;
+	slow_args.response = slow_buf;
+	slow_args.response_max = sizeof(slow_buf);
+	slow_args.response_size = 0;
+
+	slow_result = EC_RES_IN_PROGRESS;
+	slow_busy = 1;
+	task_wake(TASK_ID_HCSLOW);
+
+	return EC_RES_IN_PROGRESS;
+}
+
+void host_command_slow_task(void)
+{
+	while (1) {
+		task_wait_event(-1);
+		if (!slow_busy)
+			continue;
+
+		slow_result = host_command_process(&slow_args);
+		/* Only allow a new command once the result is stored */
+		slow_busy = 0;
+	}
+}
+#endif
+
+/* Process a command from the queue and send its response */
+static void host_command_run(struct host_cmd_handler_args *args,
+			     uint32_t received_time)
+{
+#ifdef CONFIG_TASK_HCSLOW
+	const struct host_command *cmd = find_host_command(args->command);
+#endif
+
+	hcstats_queued(args->command, get_time().le.lo - received_time);
+
+#ifdef CONFIG_TASK_HCSLOW
+	if (cmd && (cmd->flags & HOST_CMD_FLAG_SLOW) &&
+	    (EC_VER_MASK(args->version) & cmd->version_mask)) {
+		args->result = host_command_start_slow(args);
+		args->response_size = 0;
+		args->send_response(args);
+		return;
+	}
+#endif
+
+	args->result = host_command_process(args);
+	args->send_response(args);
+}
+
+static int host_command_get_comms_status(struct host_cmd_handler_args *args)
+{
+	struct ec_response_get_comms_status *r = args->response;
+
+#ifdef CONFIG_TASK_HCSLOW
+	r->flags = slow_busy ? EC_COMMS_STATUS_PROCESSING : 0;
+#else
+	r->flags = 0;
+#endif
+	args->response_size = sizeof(*r);
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND_FAST(EC_CMD_GET_COMMS_STATUS,
+			  host_command_get_comms_status,
+			  EC_VER_MASK(0));
+
+static int host_command_resend_response(struct host_cmd_handler_args *args)
+{
+#ifdef CONFIG_TASK_HCSLOW
+	if (slow_busy)
+		return EC_RES_BUSY;
+	if (slow_result == EC_RES_UNAVAILABLE)
+		return EC_RES_UNAVAILABLE;
+
+	host_response_from(args, slow_args.response, slow_args.response_size);
+
+	return slow_result;
+#else
+	return EC_RES_UNAVAILABLE;
+#endif
+}
+DECLARE_HOST_COMMAND(EC_CMD_RESEND_RESPONSE,
+		     host_command_resend_response,
+		     EC_VER_MASK(0));
+
+/*
+ * Run one command of a batch.  Params are in p; the response is written at
+ * out, which has room for req->response_max bytes.  Handlers assume a full
+ * size response buffer, so they get scratch, which is EC_HOST_PARAM_SIZE
+ * bytes.  Returns the result.
+ */
+static enum ec_status batch_run_one(struct host_cmd_handler_args *args,
+				    const struct ec_batch_request *req,
+				    const uint8_t *p, uint8_t *scratch,
+				    uint8_t *out, int *response_size)
+{
+	const struct host_command *cmd = find_host_command(req->command);
+	struct host_cmd_handler_args sub;
+	enum ec_status rv;
+
+	*response_size = 0;
+
+	/* No nesting, and nothing which would hold up the batch */
+	if (req->command == EC_CMD_BATCH ||
+	    (cmd && (cmd->flags & HOST_CMD_FLAG_SLOW)))
+		return EC_RES_INVALID_PARAM;
+
+	memset(&sub, 0, sizeof(sub));
+	sub.command = req->command;
+	sub.version = req->version;
+	sub.params = p;
+	sub.params_size = req->params_size;
+	sub.response = scratch;
+	sub.response_max = EC_HOST_PARAM_SIZE;
+	sub.transport = args->transport;
+
+	rv = host_command_process(&sub);
+	if (rv != EC_RES_SUCCESS)
+		return rv;
+	if (sub.response_size > req->response_max)
+		return EC_RES_INVALID_RESPONSE;
+
+	memcpy(out, sub.response, sub.response_size);
+	*response_size = sub.response_size;
+
+	return EC_RES_SUCCESS;
+}
+
+static int host_command_batch(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_batch *p;
+	struct ec_response_batch *r = args->response;
+	uint8_t *params, *scratch;
+	int scratch_offs = (args->params_size + 3) & ~3;
+	int in = sizeof(*p), out = sizeof(*r);
+	int i;
+
+	if (args->params_size < sizeof(*p) ||
+	    args->response_max < sizeof(*r))
+		return EC_RES_INVALID_PARAM;
+
+	/*
+	 * Params and response may share a buffer, so copy the params.  The
+	 * scratch response buffer for each command follows them.
+	 */
+	if (shared_mem_acquire(scratch_offs + EC_HOST_PARAM_SIZE, 0,
+			       (char **)&params) != EC_SUCCESS)
+		return EC_RES_BUSY;
+	memcpy(params, args->params, args->params_size);
+	p = (const struct ec_params_batch *)params;
+	scratch = params + scratch_offs;
+
+	r->count = 0;
+	r->reserved[0] = r->reserved[1] = r->reserved[2] = 0;
+
+	for (i = 0; i < p->count; i++) {
+		const struct ec_batch_request *req =
+			(const struct ec_batch_request *)(params + in);
+		struct ec_batch_response *resp =
+			(struct ec_batch_response *)((uint8_t *)r + out);
+		int size;
+
+		if (in + sizeof(*req) > args->params_size ||
+		    in + EC_BATCH_RECORD_SIZE(req->params_size) >
+		    args->params_size) {
+			shared_mem_release(params);
+			return EC_RES_INVALID_PARAM;
+		}
+
+		/* Stop if the response might not fit */
+		if (out + EC_BATCH_RECORD_SIZE(req->response_max) >
+		    args->response_max)
+			break;
+
+		resp->command = req->command;
+		resp->result = batch_run_one(args, req,
+					     (const uint8_t *)(req + 1),
+					     scratch, (uint8_t *)(resp + 1),
+					     &size);
+		resp->response_size = size;
+		resp->reserved = 0;
+
+		in += EC_BATCH_RECORD_SIZE(req->params_size);
+		out += EC_BATCH_RECORD_SIZE(size);
+		r->count++;
+
+		if (resp->result != EC_RES_SUCCESS &&
+		    (p->flags & EC_BATCH_FLAG_STOP_ON_ERROR))
+			break;
+	}
+
+	shared_mem_release(params);
+	args->response_size = out;
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_BATCH,
+		     host_command_batch,
+		     EC_VER_MASK(0));
+
 /*****************************************************************************/
 /* Initialization / task */
 
@@ -229,16 +935,18 @@ static int host_command_init(void)
 void host_command_task(void)
 {
 	host_command_init();
+	boot_time_mark(EC_BOOT_TIME_HOST_CMD_READY);
 
 	while (1) {
+		struct host_cmd_handler_args *args;
+		uint32_t received_time;
+
 		/* wait for the next command event */
-		int evt = task_wait_event(-1);
-		/* process it */
-		if ((evt & TASK_EVENT_CMD_PENDING) && pending_args) {
-			pending_args->result =
-					host_command_process(pending_args);
-			pending_args->send_response(pending_args);
-		}
+		task_wait_event(-1);
+
+		/* process everything queued so far */
+		while ((args = host_command_dequeue(&received_time)) != NULL)
+			host_command_run(args, received_time);
 	}
 }
 
@@ -349,3 +1057,38 @@ DECLARE_CONSOLE_COMMAND(hcdebug, command_hcdebug,
 			"hcdebug [on | off]",
 			"Toggle extra host command debug output",
 			NULL);
+
+#ifdef CONFIG_HOST_COMMAND_STATS
+static int command_hcstats(int argc, char **argv)
+{
+	int c;
+
+	if (argc > 1) {
+		if (strcasecmp(argv[1], "clear"))
+			return EC_ERROR_PARAM1;
+		hcstats_clear();
+		return EC_SUCCESS;
+	}
+
+	ccputs("Cmd    Calls Errors  Min us  Avg us  Max us  "
+	       "Avg queue  Max queue\n");
+	for (c = 0; c < ARRAY_SIZE(hcmd_index); c++) {
+		const struct host_command_stats *s = hcstats_find(c);
+
+		if (!s || !s->calls)
+			continue;
+		ccprintf("0x%02x %7d %6d %7d %7d %7d %10d %10d\n", c,
+			 s->calls, s->errors, s->min_us, s->total_us / s->calls,
+			 s->max_us, s->total_queue_us / s->calls,
+			 s->max_queue_us);
+		cflush();
+	}
+	ccprintf("Unknown commands: %d\n", hcmd_unknown_calls);
+
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(hcstats, command_hcstats,
+			"[clear]",
+			"Print or clear host command statistics",
+			NULL);
+#endif
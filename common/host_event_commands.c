@@ -145,9 +145,9 @@ static int host_event_get_smi_mask(struct host_cmd_handler_args *args)
 
 	return EC_RES_SUCCESS;
 }
-DECLARE_HOST_COMMAND(EC_CMD_HOST_EVENT_GET_SMI_MASK,
-		     host_event_get_smi_mask,
-		     EC_VER_MASK(0));
+DECLARE_HOST_COMMAND_FAST(EC_CMD_HOST_EVENT_GET_SMI_MASK,
+			  host_event_get_smi_mask,
+			  EC_VER_MASK(0));
 
 static int host_event_get_sci_mask(struct host_cmd_handler_args *args)
 {
@@ -158,9 +158,9 @@ static int host_event_get_sci_mask(struct host_cmd_handler_args *args)
 
 	return EC_RES_SUCCESS;
 }
-DECLARE_HOST_COMMAND(EC_CMD_HOST_EVENT_GET_SCI_MASK,
-		     host_event_get_sci_mask,
-		     EC_VER_MASK(0));
+DECLARE_HOST_COMMAND_FAST(EC_CMD_HOST_EVENT_GET_SCI_MASK,
+			  host_event_get_sci_mask,
+			  EC_VER_MASK(0));
 
 static int host_event_get_wake_mask(struct host_cmd_handler_args *args)
 {
@@ -171,9 +171,9 @@ static int host_event_get_wake_mask(struct host_cmd_handler_args *args)
 
 	return EC_RES_SUCCESS;
 }
-DECLARE_HOST_COMMAND(EC_CMD_HOST_EVENT_GET_WAKE_MASK,
-		     host_event_get_wake_mask,
-		     EC_VER_MASK(0));
+DECLARE_HOST_COMMAND_FAST(EC_CMD_HOST_EVENT_GET_WAKE_MASK,
+			  host_event_get_wake_mask,
+			  EC_VER_MASK(0));
 
 static int host_event_set_smi_mask(struct host_cmd_handler_args *args)
 {
@@ -219,9 +219,9 @@ static int host_event_get_b(struct host_cmd_handler_args *args)
 
 	return EC_RES_SUCCESS;
 }
-DECLARE_HOST_COMMAND(EC_CMD_HOST_EVENT_GET_B,
-		     host_event_get_b,
-		     EC_VER_MASK(0));
+DECLARE_HOST_COMMAND_FAST(EC_CMD_HOST_EVENT_GET_B,
+			  host_event_get_b,
+			  EC_VER_MASK(0));
 
 static int host_event_clear(struct host_cmd_handler_args *args)
 {
@@ -35,10 +35,12 @@
 static int i8042_irq_enabled;
 
 
+/* Serializes the producers of to_host: the keyboard scan task and the i8042
+ * command task.  The consumer side needs no lock. */
 static struct mutex to_host_mutex;
 static uint8_t to_host_buffer[16];
 static struct queue to_host = {
-	.buf_bytes  = ARRAY_SIZE(to_host_buffer),
+	.buf_units  = ARRAY_SIZE(to_host_buffer),
 	.unit_bytes = sizeof(uint8_t),
 	.buf        = to_host_buffer,
 };
@@ -53,11 +55,11 @@ struct host_byte {
 	uint8_t byte;
 };
 /* 4 is big enough for all i8042 commands */
-static uint8_t from_host_buffer[4 * sizeof(struct host_byte)];
+static struct host_byte from_host_buffer[4];
 static struct queue from_host = {
-	.buf_bytes  = ARRAY_SIZE(from_host_buffer),
+	.buf_units  = ARRAY_SIZE(from_host_buffer),
 	.unit_bytes = sizeof(struct host_byte),
-	.buf        = from_host_buffer,
+	.buf        = (uint8_t *)from_host_buffer,
 };
 
 
@@ -154,7 +156,7 @@ void i8042_command_task(void)
 			}
 
 			/* Get a char from buffer. */
-			kblog_put('k', to_host.head);
+			kblog_put('k', to_host.head & (to_host.buf_units - 1));
 			queue_remove_unit(&to_host, &chr);
 			kblog_put('K', chr);
 
@@ -175,7 +177,8 @@ static void enq_to_host(int len, const uint8_t *bytes)
 	/* Check if the buffer has enough space, then copy them to buffer. */
 	if (queue_has_space(&to_host, len)) {
 		for (i = 0; i < len; ++i) {
-			kblog_put('t', to_host.tail);
+			kblog_put('t', (to_host.tail + i) &
+				  (to_host.buf_units - 1));
 			kblog_put('T', bytes[i]);
 		}
 		queue_add_units(&to_host, bytes, len);
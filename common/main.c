@@ -5,8 +5,10 @@
  * Main routine for Chrome EC
  */
 
+#include "boot_time.h"
 #include "clock.h"
 #include "common.h"
+#include "console_history.h"
 #include "cpu.h"
 #include "eeprom.h"
 #include "eoption.h"
@@ -16,6 +18,7 @@
 #include "jtag.h"
 #include "keyboard.h"
 #include "keyboard_scan.h"
+#include "shared_mem.h"
 #include "system.h"
 #include "task.h"
 #include "timer.h"
@@ -51,6 +54,18 @@ int main(void)
 	system_pre_init();
 	system_common_pre_init();
 
+	/* Restore the boot time log from the previous image, if any */
+	boot_time_init();
+	boot_time_mark(EC_BOOT_TIME_PRE_INIT);
+
+#ifdef CONFIG_CONSOLE_HISTORY
+	/* Restore the console history from the previous image, if any */
+	console_history_init();
+#endif
+
+	/* Shared memory spans up to the jump data found above. */
+	shared_mem_init();
+
 #ifdef CONFIG_FLASH
 	/*
 	 * Initialize flash and apply write protecte if necessary.  Requires
@@ -61,6 +76,7 @@ int main(void)
 
 	/* Set the CPU clocks / PLLs.  System is now running at full speed. */
 	clock_init();
+	boot_time_mark(EC_BOOT_TIME_CLOCK_INIT);
 
 	/*
 	 * Initialize timer.  Everything after this can be benchmarked.
@@ -70,12 +86,14 @@ int main(void)
 	 * timer init() must be before uart_init().
 	 */
 	timer_init();
+	boot_time_mark(EC_BOOT_TIME_TIMER_INIT);
 
 	/* Main initialization stage.  Modules may enable interrupts here. */
 	cpu_init();
 
 	/* Initialize UART.  uart_printf(), etc. may now be used. */
 	uart_init();
+	boot_time_mark(EC_BOOT_TIME_UART_INIT);
 	if (system_jumped_to_this_image())
 		uart_printf("[%T UART initialized after sysjump]\n");
 	else {
@@ -113,6 +131,7 @@ int main(void)
 #endif
 #ifdef CONFIG_TASK_KEYSCAN
 	keyboard_scan_init();
+	boot_time_mark(EC_BOOT_TIME_KEYSCAN_INIT);
 #endif
 
 #ifdef CONFIG_VBOOT_SIG
@@ -125,6 +144,7 @@ int main(void)
 	 * RO image and once in the RW image.
 	 */
 	vboot_check_signature();
+	boot_time_mark(EC_BOOT_TIME_VBOOT);
 
 	/*
 	 * If system is locked, disable system jumps now that vboot has had its
@@ -140,6 +160,7 @@ int main(void)
 	 * functions, not here.
 	 */
 	hook_notify(HOOK_INIT, 0);
+	boot_time_mark(EC_BOOT_TIME_HOOK_INIT);
 
 #ifdef BOARD_link
 	/* Reduce core clock now that init is done */
@@ -153,5 +174,6 @@ int main(void)
 	uart_printf("[%T Inits done]\n");
 
 	/* Launch task scheduling (never returns) */
+	boot_time_mark(EC_BOOT_TIME_TASK_START);
 	return task_start();
 }
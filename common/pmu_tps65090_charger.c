@@ -9,10 +9,12 @@
 #include "chipset.h"
 #include "console.h"
 #include "gpio.h"
+#include "host_command.h"
 #include "pmu_tpschrome.h"
 #include "smart_battery.h"
 #include "system.h"
 #include "task.h"
+#include "telemetry.h"
 #include "timer.h"
 #include "util.h"
 
@@ -281,6 +283,20 @@ static int calc_next_state(int state)
 	return wait_t1_idle();
 }
 
+/* Update the battery values in the memory map, for the telemetry history */
+static void update_battery_memmap(void)
+{
+	int d;
+
+	if (!battery_voltage(&d))
+		*(uint32_t *)host_get_memmap(EC_MEMMAP_BATT_VOLT) = d;
+	if (!battery_current(&d))
+		*(uint32_t *)host_get_memmap(EC_MEMMAP_BATT_RATE) =
+			d < 0 ? -d : d;
+	if (!battery_remaining_capacity(&d))
+		*(uint32_t *)host_get_memmap(EC_MEMMAP_BATT_CAP) = d;
+}
+
 void pmu_charger_task(void)
 {
 	int state = ST_IDLE;
@@ -297,6 +313,9 @@ void pmu_charger_task(void)
 			state = next_state;
 		}
 
+		update_battery_memmap();
+		telemetry_sample();
+
 		/* TODO(sjg@chromium.org): root cause crosbug.com/p/11285 */
 		usleep(5000 * 1000);
 	}
@@ -13,18 +13,156 @@ static const char error_str[] = "ERROR";
 
 #define MAX_FORMAT 1024  /* Maximum chars in a single format field */
 
+#define USEC_PER_SEC 1000000
+
+/* Powers of 10 which fit in 32 bits */
+static const uint32_t pow10[10] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+	1000000000
+};
+
+/* Seconds printed by the last %T.  A single word, so it needs no lock; the
+ * microseconds at the start of that second are worked out from it. */
+static uint32_t last_time_sec;
+
+/* Where the arguments for a format come from */
+struct printf_args {
+	va_list *va;		/* Variable arguments, or NULL if packed */
+	const uint32_t *words;	/* Arguments from printf_pack() */
+	uint64_t time;		/* Time for %T if packed */
+};
+
 static int hexdigit(int c)
 {
 	return c > 9 ? (c + 'a' - 10) : (c + '0');
 }
 
-int vfnprintf(int (*addchar)(void *context, int c), void *context,
-	      const char *format, va_list args)
+/* Words taken by len bytes of packed data */
+static inline int data_words(int len)
+{
+	return (len + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+}
+
+static uint32_t next_word(struct printf_args *a)
+{
+	if (a->va)
+		return va_arg(*a->va, uint32_t);
+	return *a->words++;
+}
+
+static uint64_t next_dword(struct printf_args *a)
+{
+	uint64_t v;
+
+	if (a->va)
+		return va_arg(*a->va, uint64_t);
+	memcpy(&v, a->words, sizeof(v));
+	a->words += 2;
+	return v;
+}
+
+/* Return the string for %s, or the data for a %h of len bytes */
+static char *next_data(struct printf_args *a, int is_string, int len)
+{
+	char *data;
+
+	if (a->va)
+		return va_arg(*a->va, char *);
+
+	/* Strings are packed with their length, since it isn't in the
+	 * format */
+	if (is_string)
+		len = *a->words++ + 1;
+	data = (char *)a->words;
+	a->words += data_words(len);
+	return data;
+}
+
+/* Write v in base 2, 10 or 16 backwards before end, zero padded to at least
+ * min_digits.  Returns the first character written. */
+static char *put_uint32(char *end, uint32_t v, int base, int min_digits,
+			int upper)
+{
+	const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	int shift = (base == 16 ? 4 : 1);
+	uint32_t q;
+
+	if (base == 10) {
+		/* Division by a constant is a multiply by its reciprocal */
+		do {
+			q = v / 10;
+			*(--end) = '0' + (v - q * 10);
+			v = q;
+		} while (--min_digits > 0 || v);
+	} else {
+		do {
+			*(--end) = digits[v & (base - 1)];
+			v >>= shift;
+		} while (--min_digits > 0 || v);
+	}
+	return end;
+}
+
+/* Same as put_uint32() for 64-bit values; only the digits above 32 bits take
+ * the slow 64-bit division, 9 decimal digits at a time. */
+static char *put_uint64(char *end, uint64_t v, int base, int min_digits,
+			int upper)
+{
+	int chunk;
+
+	while (v >> 32) {
+		if (base == 10) {
+			end = put_uint32(end, uint64divmod(&v, pow10[9]),
+					 10, 9, 0);
+			min_digits -= 9;
+		} else {
+			chunk = (base == 16 ? 8 : 32);
+			end = put_uint32(end, (uint32_t)v, base, chunk, upper);
+			v >>= 32;
+			min_digits -= chunk;
+		}
+	}
+	return put_uint32(end, (uint32_t)v, base, min_digits, upper);
+}
+
+/* Split the bottom digits decimal digits off *v, for fixed point output */
+static uint32_t split_pow10(uint64_t *v, int digits)
+{
+	uint32_t v32 = (uint32_t)*v, r;
+
+	if (*v >> 32)
+		return uint64divmod(v, pow10[digits]);
+	r = v32 % pow10[digits];
+	*v = v32 / pow10[digits];
+	return r;
+}
+
+/* Split a time in us into seconds and *usec.  Times within 71 minutes of the
+ * last one printed only need a 32-bit division. */
+static uint64_t time_split(uint64_t t, uint32_t *usec)
 {
-	char intbuf[34];
-		/* Longest uint64 in decimal = 20
-		 * longest uint32 in binary  = 32
-		 */
+	uint64_t sec = last_time_sec;
+	uint64_t start = sec * USEC_PER_SEC;
+	uint32_t d;
+
+	if (t >= start && !((t - start) >> 32)) {
+		d = (uint32_t)(t - start);
+		sec += d / USEC_PER_SEC;
+		*usec = d % USEC_PER_SEC;
+	} else {
+		*usec = uint64divmod(&t, USEC_PER_SEC);
+		sec = t;
+	}
+	if (!(sec >> 32))
+		last_time_sec = (uint32_t)sec;
+	return sec;
+}
+
+static int format_args(int (*addchar)(void *context, int c), void *context,
+		       const char *format, struct printf_args *args)
+{
+	char intbuf[66];
+		/* Longest uint64 in binary = 64 */
 	int dropped_chars = 0;
 	int is_left;
 	int pad_zero;
@@ -53,7 +191,7 @@ int vfnprintf(int (*addchar)(void *context, int c), void *context,
 
 		/* Handle %c */
 		if (c == 'c') {
-			c = va_arg(args, int);
+			c = next_word(args);
 			dropped_chars |= addchar(context, c);
 			continue;
 		}
@@ -71,7 +209,7 @@ int vfnprintf(int (*addchar)(void *context, int c), void *context,
 		/* Count padding length */
 		pad_width = 0;
 		if (c == '*') {
-			pad_width = va_arg(args, int);
+			pad_width = next_word(args);
 			c = *format++;
 		} else {
 			while (c >= '0' && c <= '9') {
@@ -90,7 +228,7 @@ int vfnprintf(int (*addchar)(void *context, int c), void *context,
 		if (c == '.') {
 			c = *format++;
 			if (c == '*') {
-				precision = va_arg(args, int);
+				precision = next_word(args);
 				c = *format++;
 			} else {
 				while (c >= '0' && c <= '9') {
@@ -106,18 +244,19 @@ int vfnprintf(int (*addchar)(void *context, int c), void *context,
 		}
 
 		if (c == 's') {
-			vstr = va_arg(args, char *);
+			vstr = next_data(args, 1, 0);
 			if (vstr == NULL)
 				vstr = "(NULL)";
 		} else if (c == 'h') {
 			/* Hex dump output */
-			vstr = va_arg(args, char *);
-
 			if (!precision) {
+				/* Consume the argument anyway */
+				next_data(args, 0, 0);
 				/* Hex dump requires precision */
 				format = error_str;
 				continue;
 			}
+			vstr = next_data(args, 0, precision);
 
 			for ( ; precision; precision--, vstr++) {
 				dropped_chars |=
@@ -143,13 +282,11 @@ int vfnprintf(int (*addchar)(void *context, int c), void *context,
 
 			/* Special-case: %T = current time */
 			if (c == 'T') {
-				v = get_time().val;
-				is_64bit = 1;
-				precision = 6;
+				v = args->va ? get_time().val : args->time;
 			} else if (is_64bit) {
-				v = va_arg(args, uint64_t);
+				v = next_dword(args);
 			} else {
-				v = va_arg(args, uint32_t);
+				v = next_word(args);
 			}
 
 			switch (c) {
@@ -190,35 +327,39 @@ int vfnprintf(int (*addchar)(void *context, int c), void *context,
 			vstr = intbuf + sizeof(intbuf) - 1;
 			*(vstr) = '\0';
 
-			/*
-			 * Fixed-point precision must fit in our buffer.
-			 * Leave space for "0." and the terminating null.
-			 */
-			if (precision > sizeof(intbuf) - 3)
-				precision = sizeof(intbuf) - 3;
+			if (c == 'T') {
+				uint32_t usec;
 
-			/*
-			 * Handle digits to right of decimal for fixed point
-			 * numbers.
-			 */
-			for (vlen = 0; vlen < precision; vlen++)
-				*(--vstr) = '0' + uint64divmod(&v, 10);
-			if (precision)
+				/* Seconds, then 6 digits of microseconds */
+				v = time_split(v, &usec);
+				vstr = put_uint32(vstr, usec, 10, 6, 0);
 				*(--vstr) = '.';
-
-			if (!v)
-				*(--vstr) = '0';
-
-			while (v) {
-				int digit = uint64divmod(&v, base);
-				if (digit < 10)
-					*(--vstr) = '0' + digit;
-				else if (c == 'X')
-					*(--vstr) = 'A' + digit - 10;
-				else
-					*(--vstr) = 'a' + digit - 10;
+			} else {
+				/*
+				 * Fixed-point precision must fit in our
+				 * buffer.  Leave space for "0." and the
+				 * terminating null.
+				 */
+				if (precision > sizeof(intbuf) - 3)
+					precision = sizeof(intbuf) - 3;
+
+				/*
+				 * Handle digits to right of decimal for fixed
+				 * point numbers.
+				 */
+				for (vlen = precision; vlen > 0; vlen -= 9) {
+					int n = MIN(vlen, 9);
+
+					vstr = put_uint32(vstr,
+							  split_pow10(&v, n),
+							  10, n, 0);
+				}
+				if (precision)
+					*(--vstr) = '.';
 			}
 
+			vstr = put_uint64(vstr, v, base, 1, c == 'X');
+
 			if (is_negative)
 				*(--vstr) = '-';
 
@@ -257,6 +398,145 @@ int vfnprintf(int (*addchar)(void *context, int c), void *context,
 }
 
 
+int vfnprintf(int (*addchar)(void *context, int c), void *context,
+	      const char *format, va_list args)
+{
+	struct printf_args a;
+	va_list va;
+	int rv;
+
+	va_copy(va, args);
+	a.va = &va;
+	rv = format_args(addchar, context, format, &a);
+	va_end(va);
+	return rv;
+}
+
+
+int vfnprintf_packed(int (*addchar)(void *context, int c), void *context,
+		     const char *format, const uint32_t *words, uint64_t time)
+{
+	struct printf_args a;
+
+	a.va = NULL;
+	a.words = words;
+	a.time = time;
+	return format_args(addchar, context, format, &a);
+}
+
+
+/* Add a word to the packed arguments, or fail if there is no room */
+#define PACK_WORD(w) do {			\
+		if (n >= max_words)		\
+			return -1;		\
+		words[n++] = (w);		\
+	} while (0)
+
+int printf_pack(uint32_t *words, int max_words, const char *format,
+		va_list args)
+{
+	int n = 0;
+	int c, len;
+	int pad_width, precision;
+	const char *data;
+
+	/* Same parsing as format_args(), taking the arguments in the same
+	 * order.  Stop where it would give up on the format. */
+	while (*format) {
+		if (*format++ != '%')
+			continue;
+
+		c = *format++;
+		if (c == '%')
+			continue;
+		if (c == '\0')
+			break;
+		if (c == 'c') {
+			PACK_WORD(va_arg(args, int));
+			continue;
+		}
+
+		if (c == '-')
+			c = *format++;
+		if (c == '0')
+			c = *format++;
+
+		pad_width = 0;
+		if (c == '*') {
+			pad_width = va_arg(args, int);
+			PACK_WORD(pad_width);
+			c = *format++;
+		} else {
+			while (c >= '0' && c <= '9')
+				c = *format++;
+		}
+		if (pad_width < 0 || pad_width > MAX_FORMAT)
+			break;
+
+		precision = 0;
+		if (c == '.') {
+			c = *format++;
+			if (c == '*') {
+				precision = va_arg(args, int);
+				PACK_WORD(precision);
+				c = *format++;
+			} else {
+				while (c >= '0' && c <= '9') {
+					precision = (10 * precision) + c - '0';
+					c = *format++;
+				}
+			}
+			if (precision < 0 || precision > MAX_FORMAT)
+				break;
+		}
+
+		if (c == 's') {
+			/* Copy the string, since it may be gone by the time
+			 * it is printed */
+			data = va_arg(args, const char *);
+			if (data == NULL)
+				data = "(NULL)";
+			len = strlen(data);
+			if (n + 1 + data_words(len + 1) > max_words)
+				return -1;
+			words[n++] = len;
+			memcpy(words + n, data, len + 1);
+			n += data_words(len + 1);
+		} else if (c == 'h') {
+			data = va_arg(args, const char *);
+			if (!precision)
+				break;
+			if (n + data_words(precision) > max_words)
+				return -1;
+			memcpy(words + n, data, precision);
+			n += data_words(precision);
+		} else {
+			int is_64bit = (c == 'l');
+
+			if (is_64bit)
+				c = *format++;
+			if (c == 'T')
+				continue;
+			if (is_64bit) {
+				uint64_t v = va_arg(args, uint64_t);
+
+				if (n + 2 > max_words)
+					return -1;
+				memcpy(words + n, &v, sizeof(v));
+				n += 2;
+			} else {
+				PACK_WORD(va_arg(args, uint32_t));
+			}
+			if (c != 'd' && c != 'u' && c != 'x' && c != 'X' &&
+			    c != 'p' && c != 'b')
+				break;
+		}
+	}
+
+	return n;
+}
+
+
 /* Context for snprintf() */
 struct snprintf_context {
 	char *str;
@@ -4,50 +4,104 @@
  *
  * Queue data structure implementation.
  */
+#include "atomic.h"
 #include "queue.h"
 #include "util.h"
 
-void queue_reset(struct queue *queue)
+/* Fields of mp_state */
+#define MP_PRODUCER 0x10000
+#define MP_END_MASK 0xffff
+
+void queue_reset(struct queue *q)
 {
-	queue->head = queue->tail = 0;
+	q->head = q->tail;
 }
 
-int queue_is_empty(const struct queue *q)
+int queue_add_units(struct queue *q, const void *src, int unit_count)
 {
-	return q->head == q->tail;
+	const uint8_t *s = (const uint8_t *)src;
+	void *d;
+	int done, span;
+
+	if (!queue_has_space(q, unit_count))
+		return 0;
+
+	/* At most two spans: up to the end of the buffer, then from its
+	 * start. */
+	for (done = 0; done < unit_count; done += span) {
+		span = MIN(queue_reserve(q, &d), unit_count - done);
+		memcpy(d, s + done * q->unit_bytes, span * q->unit_bytes);
+		/* Publish each span, so the consumer can start on it */
+		queue_commit_add(q, span);
+	}
+
+	return unit_count;
 }
 
-int queue_has_space(const struct queue *q, int unit_count)
+/* Move tail up to end, the low 16 bits of the new tail, unless another
+ * producer already moved it past that. */
+static void queue_mp_publish(struct queue *q, uint32_t end)
 {
-	return (q->tail + unit_count * q->unit_bytes) <=
-	       (q->head + q->buf_bytes - q->unit_bytes);
+	uint32_t tail;
+	int16_t ahead;
+
+	do {
+		tail = q->tail;
+		ahead = (int16_t)(end - tail);
+		if (ahead <= 0)
+			return;
+	} while (!atomic_cas((uint32_t *)&q->tail, tail, tail + ahead));
 }
 
-void queue_add_units(struct queue *q, const void *src, int unit_count)
+int queue_mp_add_units(struct queue *q, const void *src, int unit_count)
 {
 	const uint8_t *s = (const uint8_t *)src;
+	uint32_t state, start, offset;
+	int span;
 
-	if (!queue_has_space(q, unit_count))
-		return;
+	/* Reserve the space, and count ourselves as a producer */
+	do {
+		state = q->mp_state;
+		start = state & MP_END_MASK;
+		if (((start - q->head) & MP_END_MASK) + unit_count >
+		    q->buf_units)
+			return 0;
+	} while (!atomic_cas((uint32_t *)&q->mp_state, state,
+			     ((state + MP_PRODUCER) & ~MP_END_MASK) |
+			     ((start + unit_count) & MP_END_MASK)));
 
-	for (unit_count *= q->unit_bytes; unit_count; unit_count--) {
-		q->buf[q->tail++] = *(s++);
-		q->tail %= q->buf_bytes;
-	}
+	/* At most two spans: up to the end of the buffer, then from its
+	 * start. */
+	offset = start & (q->buf_units - 1);
+	span = MIN(unit_count, q->buf_units - offset);
+	memcpy(q->buf + offset * q->unit_bytes, s, span * q->unit_bytes);
+	memcpy(q->buf, s + span * q->unit_bytes,
+	       (unit_count - span) * q->unit_bytes);
+
+	/* Done; the last producer out publishes everything reserved */
+	do {
+		state = q->mp_state;
+	} while (!atomic_cas((uint32_t *)&q->mp_state, state,
+			     state - MP_PRODUCER));
+	if (state < 2 * MP_PRODUCER)
+		queue_mp_publish(q, state & MP_END_MASK);
+
+	return unit_count;
 }
 
-int queue_remove_unit(struct queue *q, void *dest)
+int queue_remove_units(struct queue *q, void *dest, int unit_count)
 {
-	int count;
 	uint8_t *d = (uint8_t *)dest;
+	void *s;
+	int done, span;
 
-	if (queue_is_empty(q))
-		return 0;
+	unit_count = MIN(unit_count, queue_count(q));
 
-	for (count = q->unit_bytes; count; count--) {
-		*(d++) = q->buf[q->head++];
-		q->head %= q->buf_bytes;
+	for (done = 0; done < unit_count; done += span) {
+		span = MIN(queue_peek(q, &s), unit_count - done);
+		memcpy(d + done * q->unit_bytes, s, span * q->unit_bytes);
+		queue_commit_remove(q, span);
 	}
 
-	return 1;
+	return unit_count;
 }
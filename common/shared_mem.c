@@ -5,12 +5,134 @@
 
 /* Shared memory module for Chrome EC */
 
+#include "atomic.h"
 #include "config.h"
+#include "console.h"
 #include "link_defs.h"
 #include "shared_mem.h"
 #include "system.h"
+#include "task.h"
+#include "util.h"
 
-static int buf_in_use;
+/*
+ * The shared memory buffer is split into a list of contiguous blocks, each
+ * starting with a header.  Allocation is first-fit, splitting the block when
+ * the remainder is big enough to be useful; released blocks are merged with
+ * their free neighbours.  The list is only walked with interrupts disabled,
+ * so acquisitions and releases are atomic.
+ */
+struct shm_block {
+	uint32_t size;   /* Size of the block, header included, in bytes */
+	uint32_t owner;  /* Task owning the block + 1, or 0 if the block is
+			  * free */
+};
+
+/* Block sizes and addresses are multiples of the header size */
+#define SHM_ALIGN sizeof(struct shm_block)
+/* Smallest remainder worth splitting into a free block */
+#define SHM_MIN_SPLIT (2 * SHM_ALIGN)
+
+static struct shm_block *shm_start;
+static struct shm_block *shm_end;
+
+/* Tasks waiting in shared_mem_acquire() */
+static uint32_t shm_waiters;
+
+/* Statistics */
+static int shm_used;         /* Bytes allocated, headers included */
+static int shm_peak_used;    /* Peak of shm_used */
+static int shm_blocks_used;  /* Allocated blocks */
+static int shm_peak_blocks;  /* Peak of shm_blocks_used */
+static int shm_acquires;     /* Successful acquisitions */
+static int shm_failures;     /* Requests which failed as busy */
+static int shm_waits;        /* Times a task blocked for memory */
+
+
+static inline struct shm_block *next_block(struct shm_block *b)
+{
+	return (struct shm_block *)((uint8_t *)b + b->size);
+}
+
+
+/* Allocate a block for at least size bytes of data.  Interrupts must be
+ * disabled. */
+static void *shm_alloc(int size)
+{
+	uint32_t need = (sizeof(struct shm_block) + size + SHM_ALIGN - 1) &
+		~(SHM_ALIGN - 1);
+	struct shm_block *b;
+
+	for (b = shm_start; b < shm_end; b = next_block(b)) {
+		if (b->owner || b->size < need)
+			continue;
+
+		if (b->size - need >= SHM_MIN_SPLIT) {
+			struct shm_block *rest =
+				(struct shm_block *)((uint8_t *)b + need);
+
+			rest->size = b->size - need;
+			rest->owner = 0;
+			b->size = need;
+		}
+		b->owner = task_get_current() + 1;
+
+		shm_used += b->size;
+		if (shm_used > shm_peak_used)
+			shm_peak_used = shm_used;
+		if (++shm_blocks_used > shm_peak_blocks)
+			shm_peak_blocks = shm_blocks_used;
+		shm_acquires++;
+
+		return b + 1;
+	}
+
+	return NULL;
+}
+
+
+/* Merge every run of adjacent free blocks.  Interrupts must be disabled. */
+static void shm_merge(void)
+{
+	struct shm_block *b, *n;
+
+	for (b = shm_start; b < shm_end; b = next_block(b)) {
+		if (b->owner)
+			continue;
+		for (n = next_block(b); n < shm_end && !n->owner;
+		     n = next_block(b))
+			b->size += n->size;
+	}
+}
+
+
+/* Wait for a block to be released, keeping the other events pending. */
+static void shm_wait(void)
+{
+	uint32_t evt = 0;
+
+	do {
+		evt |= task_wait_event(-1);
+	} while (!(evt & TASK_EVENT_SHARED_MEM));
+
+	evt &= ~TASK_EVENT_SHARED_MEM;
+	if (evt)
+		atomic_or(task_get_event_bitmap(task_get_current()), evt);
+}
+
+
+int shared_mem_init(void)
+{
+	uint32_t start = ((uint32_t)__shared_mem_buf + SHM_ALIGN - 1) &
+		~(SHM_ALIGN - 1);
+	uint32_t end = system_usable_ram_end() & ~(SHM_ALIGN - 1);
+
+	shm_start = (struct shm_block *)start;
+	shm_end = (struct shm_block *)end;
+	shm_start->size = end - start;
+	shm_start->owner = 0;
+
+	return EC_SUCCESS;
+}
 
 
 int shared_mem_size(void)
@@ -18,32 +140,110 @@ int shared_mem_size(void)
 	/* Use all the RAM we can.  The shared memory buffer is the
 	 * last thing allocated from the start of RAM, so we can use
 	 * everything up to the jump data at the end of RAM. */
-	return system_usable_ram_end() - (uint32_t)__shared_mem_buf;
+	return (uint32_t)shm_end - (uint32_t)shm_start -
+		sizeof(struct shm_block);
 }
 
 
 int shared_mem_acquire(int size, int wait, char **dest_ptr)
 {
+	void *p;
+
 	if (size > shared_mem_size() || size <= 0)
 		return EC_ERROR_INVAL;
 
-	/* TODO: if task_start() hasn't been called, fail immediately
-	 * if not available. */
+	/* Only tasks can wait; before task_start() or in interrupt context,
+	 * fail immediately if the memory is not available. */
+	if (!task_start_called() || in_interrupt_context())
+		wait = 0;
+
+	while (1) {
+		interrupt_disable();
+		p = shm_alloc(size);
+		if (!p && wait) {
+			shm_waiters |= 1 << task_get_current();
+			shm_waits++;
+		}
+		interrupt_enable();
+
+		if (p || !wait)
+			break;
 
-	/* TODO: wait if requested; for now, we fail immediately if
-	 * not available. */
-	if (buf_in_use)
+		shm_wait();
+	}
+
+	if (!p) {
+		shm_failures++;
 		return EC_ERROR_BUSY;
+	}
 
-	/* TODO: atomically acquire buf_in_use. */
-	buf_in_use = 1;
-	*dest_ptr = __shared_mem_buf;
+	*dest_ptr = p;
 	return EC_SUCCESS;
 }
 
 
 void shared_mem_release(void *ptr)
 {
-	/* TODO: use event to wake up a previously-blocking acquire */
-	buf_in_use = 0;
+	struct shm_block *b = (struct shm_block *)ptr - 1;
+	uint32_t waiters;
+
+	ASSERT(b >= shm_start && b < shm_end && b->owner);
+
+	interrupt_disable();
+	shm_used -= b->size;
+	shm_blocks_used--;
+	b->owner = 0;
+	shm_merge();
+	waiters = shm_waiters;
+	shm_waiters = 0;
+	interrupt_enable();
+
+	/* Let all the waiting tasks retry */
+	while (waiters) {
+		task_id_t id = 31 - __builtin_clz(waiters);
+
+		task_set_event(id, TASK_EVENT_SHARED_MEM, 0);
+		waiters &= ~(1 << id);
+	}
+}
+
+/*****************************************************************************/
+/* Console commands */
+
+static int command_shmem(int argc, char **argv)
+{
+	struct shm_block *b;
+	int free_bytes = 0, free_blocks = 0, largest = 0;
+
+	interrupt_disable();
+	for (b = shm_start; b < shm_end; b = next_block(b)) {
+		if (b->owner)
+			continue;
+		free_bytes += b->size;
+		free_blocks++;
+		if (b->size > largest)
+			largest = b->size;
+	}
+	interrupt_enable();
+
+	ccprintf("Size:          %6d bytes\n", shared_mem_size());
+	ccprintf("Used:          %6d bytes in %d blocks\n",
+		 shm_used, shm_blocks_used);
+	ccprintf("Peak used:     %6d bytes in %d blocks\n",
+		 shm_peak_used, shm_peak_blocks);
+	ccprintf("Free:          %6d bytes in %d blocks\n",
+		 free_bytes, free_blocks);
+	ccprintf("Largest free:  %6d bytes\n", largest);
+	/* Share of the free memory unusable by a single allocation */
+	ccprintf("Fragmentation: %6d%%\n",
+		 free_bytes ? 100 - largest * 100 / free_bytes : 0);
+	ccprintf("Acquires:      %6d\n", shm_acquires);
+	ccprintf("Busy failures: %6d\n", shm_failures);
+	ccprintf("Waits:         %6d\n", shm_waits);
+
+	return EC_SUCCESS;
 }
+DECLARE_CONSOLE_COMMAND(shmem, command_shmem,
+			NULL,
+			"Print shared memory stats",
+			NULL);
@@ -0,0 +1,163 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Software timers for Chrome EC */
+
+#include "console.h"
+#include "soft_timer.h"
+#include "task.h"
+#include "timer.h"
+#include "uart.h"
+#include "util.h"
+
+/* Maximum number of software timers running at the same time */
+#ifndef CONFIG_SOFT_TIMER_COUNT
+#define CONFIG_SOFT_TIMER_COUNT 32
+#endif
+
+/*
+ * Running timers, ordered by deadline.  The heap is modified with interrupts
+ * masked, since timers may be started or stopped from interrupt context.
+ */
+static struct timer_heap_node *queue_nodes[CONFIG_SOFT_TIMER_COUNT];
+static struct timer_heap queue = {queue_nodes, CONFIG_SOFT_TIMER_COUNT};
+
+/* Statistics */
+static uint32_t expired_count;   /* Number of callbacks run */
+static uint32_t max_latency;     /* Worst delay between deadline and call */
+static int max_queue_size;       /* Peak number of running timers */
+
+
+/* Return the running timer with the earliest deadline, or NULL if none.
+ * Interrupts must be masked. */
+static struct soft_timer *queue_first(void)
+{
+	return (struct soft_timer *)timer_heap_first(&queue);
+}
+
+
+/* Insert a stopped timer into the queue.  Interrupts must be masked. */
+static void queue_insert(struct soft_timer *timer)
+{
+	timer_heap_insert(&queue, &timer->node);
+
+	if (queue.size > max_queue_size)
+		max_queue_size = queue.size;
+}
+
+
+int soft_timer_start(struct soft_timer *timer, uint32_t delay_us,
+		     uint32_t period_us)
+{
+	timestamp_t deadline = get_time();
+	uint32_t irq;
+	int first;
+
+	deadline.val += delay_us;
+
+	/* Callers in interrupt context may already have interrupts masked */
+	irq = interrupt_disable_save();
+	if (soft_timer_is_running(timer))
+		timer_heap_remove(&queue, &timer->node);
+	if (queue.size >= queue.max) {
+		interrupt_restore(irq);
+		return EC_ERROR_OVERFLOW;
+	}
+	timer->node.deadline = deadline;
+	timer->period_us = period_us;
+	queue_insert(timer);
+	first = (queue_first() == timer);
+	interrupt_restore(irq);
+
+	/* The next deadline has changed; let the timer task re-arm itself */
+	if (first && task_start_called())
+		task_wake(TASK_ID_SOFTTIMER);
+
+	return EC_SUCCESS;
+}
+
+
+void soft_timer_stop(struct soft_timer *timer)
+{
+	uint32_t irq = interrupt_disable_save();
+
+	if (soft_timer_is_running(timer))
+		timer_heap_remove(&queue, &timer->node);
+	interrupt_restore(irq);
+
+	/* No need to wake the timer task; it will just wake up for nothing at
+	 * the old deadline. */
+}
+
+
+/* Task running all the software timer callbacks */
+void soft_timer_task(void)
+{
+	struct soft_timer *timer;
+	timestamp_t now;
+	int wait_us;
+
+	while (1) {
+		now = get_time();
+
+		interrupt_disable();
+		while ((timer = queue_first()) &&
+		       timer->node.deadline.val <= now.val) {
+			timestamp_t *deadline = &timer->node.deadline;
+
+			timer_heap_remove(&queue, &timer->node);
+
+			if (now.val - deadline->val > max_latency)
+				max_latency = now.val - deadline->val;
+
+			/* Re-arm periodic timers before the call, so the
+			 * callback can stop them.  If we are already late
+			 * for the next period, skip the missed ones. */
+			if (timer->period_us) {
+				deadline->val += timer->period_us;
+				if (deadline->val <= now.val)
+					deadline->val =
+						now.val + timer->period_us;
+				queue_insert(timer);
+			}
+			interrupt_enable();
+
+			expired_count++;
+			timer->routine(timer->data);
+
+			now = get_time();
+			interrupt_disable();
+		}
+
+		/* Sleep until the next deadline, or until a new first timer
+		 * is started. */
+		timer = queue_first();
+		if (!timer)
+			wait_us = -1;
+		else if (timer->node.deadline.val - now.val > 0x7fffffff)
+			wait_us = 0x7fffffff;
+		else
+			wait_us = timer->node.deadline.val - now.val;
+		interrupt_enable();
+
+		task_wait_event(wait_us);
+	}
+}
+
+/*****************************************************************************/
+/* Console commands */
+
+static int command_soft_timer_info(int argc, char **argv)
+{
+	ccprintf("Running timers: %d (peak %d / %d)\n",
+		 queue.size, max_queue_size, queue.max);
+	ccprintf("Callbacks run:  %d\n", expired_count);
+	ccprintf("Max latency:    %d us\n", max_latency);
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(stimerinfo, command_soft_timer_info,
+			NULL,
+			"Print software timer info",
+			NULL);
@@ -14,6 +14,7 @@
 #include "gpio.h"
 #include "hooks.h"
 #include "host_command.h"
+#include "link_defs.h"
 #include "lpc.h"
 #include "system.h"
 #include "task.h"
@@ -168,9 +169,13 @@ int system_add_jump_tag(uint16_t tag, int version, int size, const void *data)
 	if (jdata->magic != JUMP_DATA_MAGIC)
 		return EC_ERROR_UNKNOWN;
 
-	/* Make room for the new tag */
+	/* Make room for the new tag, without reaching into the shared memory
+	 * below, which other sysjump hooks may still be using */
 	if (size > 255 || (size & 3))
 		return EC_ERROR_INVAL;
+	if (system_usable_ram_end() - (uint32_t)__shared_mem_buf <
+	    size + sizeof(struct jump_tag))
+		return EC_ERROR_OVERFLOW;
 	jdata->jump_tag_total += size + sizeof(struct jump_tag);
 
 	t = (struct jump_tag *)system_usable_ram_end();
@@ -307,9 +312,9 @@ static void jump_to_image(uint32_t init_addr)
 	gpio_set_level(GPIO_ENTERING_RW, 1);
 #endif
 
-	/* Flush UART output unless the UART hasn't been initialized yet */
+	/* Flush console output unless the UART hasn't been initialized yet */
 	if (uart_init_done())
-		uart_flush_output();
+		cflush();
 
 	/* Disable interrupts before jump */
 	interrupt_disable();
@@ -803,6 +808,30 @@ DECLARE_HOST_COMMAND(EC_CMD_GET_BOARD_VERSION,
 		     host_command_get_board_version,
 		     EC_VER_MASK(0));
 
+static int host_command_task_stack_info(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_task_stack_info *p = args->params;
+	struct ec_response_task_stack_info *r = args->response;
+	task_id_t id = p->task_id;
+	int size, used;
+
+	if (task_get_stack_info(id, &size, &used) != EC_SUCCESS)
+		return EC_RES_INVALID_PARAM;
+
+	r->task_count = TASK_ID_COUNT;
+	r->reserved[0] = r->reserved[1] = r->reserved[2] = 0;
+	r->stack_size = size;
+	r->stack_used = used;
+	strzcpy(r->name, task_get_name(id), sizeof(r->name));
+
+	args->response_size = sizeof(*r);
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_TASK_STACK_INFO,
+		     host_command_task_stack_info,
+		     EC_VER_MASK(0));
+
 int host_command_reboot(struct host_cmd_handler_args *args)
 {
 	struct ec_params_reboot_ec p;
@@ -0,0 +1,203 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Telemetry history for Chrome EC */
+
+#include "console.h"
+#include "ec_commands.h"
+#include "hooks.h"
+#include "host_command.h"
+#include "lpc.h"
+#include "shared_mem.h"
+#include "telemetry.h"
+#include "timer.h"
+#include "util.h"
+
+/* Tries at a consistent copy before giving up; samples are seconds apart, so
+ * more than one retry means something is badly wrong. */
+#define TELEMETRY_COPY_TRIES 4
+
+/* Keep the compiler from moving memory accesses across this point.  The host
+ * reads the history while we write it, so the sample must be written before
+ * seq says it is there. */
+#define telemetry_barrier() asm volatile("" : : : "memory")
+
+#ifndef CONFIG_LPC
+static struct ec_telemetry telemetry_data;
+#endif
+
+/* Return the telemetry history */
+static inline struct ec_telemetry *telemetry_get(void)
+{
+#ifdef CONFIG_LPC
+	/* In its own LPC window so the host can read it directly */
+	return (struct ec_telemetry *)lpc_get_telemetry_range();
+#else
+	return &telemetry_data;
+#endif
+}
+
+/* Return the number of samples taken, as the host would read it */
+static inline uint32_t telemetry_seq(void)
+{
+	return ((volatile struct ec_telemetry *)telemetry_get())->seq;
+}
+
+
+void telemetry_sample(void)
+{
+	struct ec_telemetry *t = telemetry_get();
+	struct ec_telemetry_sample s;
+	const uint8_t *temps = host_get_memmap(EC_MEMMAP_TEMP_SENSOR);
+	const uint16_t *fans = (const uint16_t *)host_get_memmap(EC_MEMMAP_FAN);
+	uint64_t now = get_time().val;
+	uint32_t seq = telemetry_seq();
+	int i;
+
+	uint64divmod(&now, 1000);
+	s.time_ms = (uint32_t)now;
+	for (i = 0; i < EC_TELEMETRY_TEMPS; i++)
+		s.temp[i] = temps[i];
+	for (i = 0; i < EC_TELEMETRY_FANS; i++)
+		s.fan_rpm[i] = fans[i];
+	s.batt_volt = *(uint32_t *)host_get_memmap(EC_MEMMAP_BATT_VOLT);
+	s.batt_rate = *(uint32_t *)host_get_memmap(EC_MEMMAP_BATT_RATE);
+	s.batt_cap = *(uint32_t *)host_get_memmap(EC_MEMMAP_BATT_CAP);
+	s.batt_flag = *host_get_memmap(EC_MEMMAP_BATT_FLAG);
+	s.reserved = 0;
+
+	memcpy(t->sample + seq % EC_TELEMETRY_SAMPLES, &s, sizeof(s));
+	telemetry_barrier();
+	((volatile struct ec_telemetry *)t)->seq = seq + 1;
+}
+
+
+/* Copy the history to dest, retrying until seq did not change during the
+ * copy.  The slot for the next sample may still be torn, so only the last
+ * EC_TELEMETRY_SAMPLES - 1 samples of the copy are valid.  Returns EC_SUCCESS,
+ * or EC_ERROR_BUSY if the history kept changing. */
+static int telemetry_copy(struct ec_telemetry *dest)
+{
+	int tries;
+
+	for (tries = 0; tries < TELEMETRY_COPY_TRIES; tries++) {
+		uint32_t seq = telemetry_seq();
+
+		telemetry_barrier();
+		memcpy(dest, telemetry_get(), sizeof(*dest));
+		telemetry_barrier();
+		if (telemetry_seq() == seq && dest->seq == seq)
+			return EC_SUCCESS;
+	}
+	return EC_ERROR_BUSY;
+}
+
+
+static int telemetry_init(void)
+{
+	struct ec_telemetry *t = telemetry_get();
+
+	BUILD_ASSERT(sizeof(*t) <= EC_HOST_PARAM_SIZE);
+
+	memset(t, 0, sizeof(*t));
+	t->version = EC_TELEMETRY_VERSION;
+	t->sample_size = sizeof(struct ec_telemetry_sample);
+	t->sample_count = EC_TELEMETRY_SAMPLES;
+
+	return EC_SUCCESS;
+}
+/* After lpc_init() at HOOK_PRIO_INIT_LPC, so the window is there to fill */
+DECLARE_HOOK(HOOK_INIT, telemetry_init, HOOK_PRIO_DEFAULT);
+
+/*****************************************************************************/
+/* Console commands */
+
+static int command_telemetry(int argc, char **argv)
+{
+	struct ec_telemetry *t;
+	uint32_t n, first;
+	int rv;
+
+	/* Too big to put on the console task stack */
+	rv = shared_mem_acquire(sizeof(*t), 0, (char **)&t);
+	if (rv)
+		return rv;
+
+	rv = telemetry_copy(t);
+	if (rv) {
+		shared_mem_release(t);
+		return rv;
+	}
+
+	ccprintf("Samples: %d\n", t->seq);
+	first = t->seq >= EC_TELEMETRY_SAMPLES ?
+		t->seq - EC_TELEMETRY_SAMPLES + 1 : 0;
+	ccputs("   Seq    Time (ms)  Temps (K)        Fans (rpm)   "
+	       "mV     mA     mAh    Flags\n");
+	for (n = first; n < t->seq; n++) {
+		const struct ec_telemetry_sample *s =
+			t->sample + n % EC_TELEMETRY_SAMPLES;
+
+		ccprintf("%6d  %11d  %3d %3d %3d %3d  %5d %5d  "
+			 "%5d  %5d  %5d  0x%02x\n",
+			 n, s->time_ms,
+			 s->temp[0] + EC_TEMP_SENSOR_OFFSET,
+			 s->temp[1] + EC_TEMP_SENSOR_OFFSET,
+			 s->temp[2] + EC_TEMP_SENSOR_OFFSET,
+			 s->temp[3] + EC_TEMP_SENSOR_OFFSET,
+			 s->fan_rpm[0], s->fan_rpm[1],
+			 s->batt_volt, s->batt_rate, s->batt_cap,
+			 s->batt_flag);
+		cflush();
+	}
+
+	shared_mem_release(t);
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(telemetry, command_telemetry,
+			NULL,
+			"Print telemetry history",
+			NULL);
+
+/*****************************************************************************/
+/* Host commands */
+
+static int telemetry_command_get(struct host_cmd_handler_args *args)
+{
+	struct ec_telemetry *r = args->response;
+	struct ec_telemetry *t;
+	int header = sizeof(*t) - sizeof(t->sample);
+	int count = MIN((args->response_max - header) /
+			(int)sizeof(t->sample[0]), EC_TELEMETRY_SAMPLES);
+	uint32_t n;
+
+	/* The slot for the next sample is never valid, so need two */
+	if (count < 2)
+		return EC_RES_INVALID_PARAM;
+
+	if (shared_mem_acquire(sizeof(*t), 0, (char **)&t))
+		return EC_RES_BUSY;
+	if (telemetry_copy(t)) {
+		shared_mem_release(t);
+		return EC_RES_BUSY;
+	}
+
+	/* Only the latest samples if the history doesn't fit, in a history
+	 * of fewer slots, so the host finds them the same way */
+	memcpy(r, t, header);
+	r->sample_count = count;
+	memset(r->sample, 0, count * sizeof(r->sample[0]));
+	for (n = t->seq >= count ? t->seq - count + 1 : 0; n < t->seq; n++)
+		memcpy(r->sample + n % count,
+		       t->sample + n % EC_TELEMETRY_SAMPLES,
+		       sizeof(r->sample[0]));
+
+	shared_mem_release(t);
+	args->response_size = header + count * sizeof(r->sample[0]);
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_TELEMETRY,
+		     telemetry_command_get,
+		     EC_VER_MASK(0));
@@ -14,6 +14,7 @@
 #include "host_command.h"
 #include "peci.h"
 #include "task.h"
+#include "telemetry.h"
 #include "temp_sensor.h"
 #include "thermal.h"
 #include "timer.h"
@@ -141,6 +142,7 @@ void temp_sensor_task(void)
 		}
 		poll_slow_sensors();
 		update_mapped_memory();
+		telemetry_sample();
 	}
 }
 
@@ -0,0 +1,79 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Min-heap of timer deadlines.
+ */
+
+#include "timer_heap.h"
+
+static inline int before(const struct timer_heap *h, int a, int b)
+{
+	return h->nodes[a]->deadline.val < h->nodes[b]->deadline.val;
+}
+
+
+static void swap(struct timer_heap *h, int a, int b)
+{
+	struct timer_heap_node *t = h->nodes[a];
+
+	h->nodes[a] = h->nodes[b];
+	h->nodes[b] = t;
+	h->nodes[a]->pos = a + 1;
+	h->nodes[b]->pos = b + 1;
+}
+
+
+static void sift_up(struct timer_heap *h, int i)
+{
+	while (i > 0 && before(h, i, (i - 1) / 2)) {
+		swap(h, i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+
+static void sift_down(struct timer_heap *h, int i)
+{
+	while (1) {
+		int child = 2 * i + 1;
+
+		if (child >= h->size)
+			return;
+		if (child + 1 < h->size && before(h, child + 1, child))
+			child++;
+		if (!before(h, child, i))
+			return;
+		swap(h, i, child);
+		i = child;
+	}
+}
+
+
+void timer_heap_insert(struct timer_heap *h, struct timer_heap_node *n)
+{
+	int i = h->size++;
+
+	h->nodes[i] = n;
+	n->pos = i + 1;
+	sift_up(h, i);
+}
+
+
+void timer_heap_remove(struct timer_heap *h, struct timer_heap_node *n)
+{
+	int i = n->pos - 1;
+	struct timer_heap_node *moved;
+
+	n->pos = 0;
+	h->size--;
+	if (i == h->size)
+		return;
+
+	/* Move the last leaf into the hole and restore the heap order */
+	moved = h->nodes[h->size];
+	h->nodes[i] = moved;
+	moved->pos = i + 1;
+	sift_up(h, i);
+	sift_down(h, moved->pos - 1);
+}
@@ -9,7 +9,9 @@
 
 #include "common.h"
 #include "console.h"
+#include "console_history.h"
 #include "printf.h"
+#include "queue.h"
 #include "task.h"
 #include "uart.h"
 #include "util.h"
@@ -33,7 +35,6 @@
 #define RX_LINE_SIZE 80
 
 /* Macros to advance in the circular buffers */
-#define TX_BUF_NEXT(i) (((i) + 1) & (CONFIG_UART_TX_BUF_SIZE - 1))
 #define RX_BUF_NEXT(i) (((i) + 1) & (CONFIG_UART_RX_BUF_SIZE - 1))
 #define RX_BUF_PREV(i) (((i) - 1) & (CONFIG_UART_RX_BUF_SIZE - 1))
 #define CMD_HIST_NEXT(i) (((i) + 1) & (HISTORY_SIZE - 1))
@@ -45,10 +46,14 @@
 /* ASCII control character; for example, CTRL('C') = ^C */
 #define CTRL(c) ((c) - '@')
 
-/* Transmit and receive buffers */
-static volatile char tx_buf[CONFIG_UART_TX_BUF_SIZE];
-static volatile int tx_buf_head;
-static volatile int tx_buf_tail;
+/* Transmit and receive buffers.  rx_buf also stores the command history, so
+ * it is not a plain queue. */
+static char tx_buf[CONFIG_UART_TX_BUF_SIZE];
+static struct queue tx_queue = {
+	.buf_units  = CONFIG_UART_TX_BUF_SIZE,
+	.unit_bytes = sizeof(char),
+	.buf        = (uint8_t *)tx_buf,
+};
 static volatile char rx_buf[CONFIG_UART_RX_BUF_SIZE];
 static volatile int rx_buf_head;
 static volatile int rx_buf_tail;
@@ -80,28 +85,100 @@ static volatile int cmd_history_ptr;
 
 static int console_mode = 1;
 
+#ifdef CONFIG_UART_TX_DMA
+/* Bytes at the head of tx_queue which the DMA is sending */
+static int tx_dma_len;
+#endif
+
+
+/* Output is gathered a line at a time, then added to the transmit buffer in
+ * one piece, so lines printed at the same time by several tasks and
+ * interrupts don't get mixed up. */
+#define TX_LINE_SIZE 64
 
-/* Put a single character into the transmit buffer.  Does not enable
- * the transmit interrupt; assumes that happens elsewhere.  Returns
- * zero if the character was transmitted, 1 if it was dropped.  We only
- * have a single transmit buffer, so context is ignored. */
+struct tx_line {
+	int len;
+	char buf[TX_LINE_SIZE];
+};
+
+/* Add the output gathered in a line to the transmit buffer.  Returns zero if
+ * it was added, 1 if it was dropped. */
+static int tx_line_flush(struct tx_line *line)
+{
+	int dropped = !queue_mp_add_units(&tx_queue, line->buf, line->len);
+
+#ifdef CONFIG_CONSOLE_HISTORY
+	/* The history keeps everything, so output carries on when the
+	 * transmit buffer is full; only the UART misses some of it. */
+	console_history_add(line->buf, line->len);
+	dropped = 0;
+#endif
+	line->len = 0;
+	return dropped;
+}
+
+/* Add a single character of output to the struct tx_line in context, and send
+ * the line to the transmit buffer at a newline or when it is full.  Does not
+ * enable the transmit interrupt; assumes that happens elsewhere.  Returns
+ * zero if the character was transmitted, 1 if it was dropped. */
 static int __tx_char(void *context, int c)
 {
-	int tx_buf_next;
+	struct tx_line *line = (struct tx_line *)context;
 
 	/* Do newline to CRLF translation */
-	if (console_mode && c == '\n' && __tx_char(NULL, '\r'))
-		return 1;
-
-	tx_buf_next = TX_BUF_NEXT(tx_buf_head);
-	if (tx_buf_next == tx_buf_tail)
-		return 1;
+	if (console_mode && c == '\n')
+		line->buf[line->len++] = '\r';
+	line->buf[line->len++] = c;
 
-	tx_buf[tx_buf_head] = c;
-	tx_buf_head = tx_buf_next;
+	/* Keep room for a CRLF */
+	if (c == '\n' || line->len >= TX_LINE_SIZE - 1)
+		return tx_line_flush(line);
 	return 0;
 }
 
+/* Send the rest of a line of output and make sure the transmit interrupt is
+ * on.  Returns rv, or EC_ERROR_OVERFLOW if the rest was dropped. */
+static int tx_line_finish(struct tx_line *line, int rv)
+{
+	if (line->len && tx_line_flush(line))
+		rv = EC_ERROR_OVERFLOW;
+
+	if (uart_tx_stopped())
+		uart_tx_start();
+
+	return rv;
+}
+
+
+/* Copy output from buffer until TX fifo full or output buffer empty */
+static void tx_fifo_fill(void)
+{
+	char *p;
+#ifdef CONFIG_UART_TX_DMA
+	/* Send the contiguous output at the head of the buffer in one
+	 * transfer.  It stays in the buffer until the DMA is done with it. */
+	if (tx_dma_len) {
+		if (!uart_tx_dma_ready())
+			return;
+		queue_commit_remove(&tx_queue, tx_dma_len);
+	}
+
+	tx_dma_len = queue_peek(&tx_queue, (void **)&p);
+	if (tx_dma_len)
+		uart_tx_dma_start(p, tx_dma_len);
+#else
+	int count, i;
+
+	while ((count = queue_peek(&tx_queue, (void **)&p)) != 0) {
+		for (i = 0; i < count && uart_tx_ready(); i++)
+			uart_write_char(p[i]);
+		queue_commit_remove(&tx_queue, i);
+		if (i < count)
+			break;
+	}
+#endif
+}
+
 
 /**
  * Write a number directly to the UART.
@@ -507,13 +584,10 @@ void uart_process(void)
 	}
 
 	/* Copy output from buffer until TX fifo full or output buffer empty */
-	while (uart_tx_ready() && (tx_buf_head != tx_buf_tail)) {
-		uart_write_char(tx_buf[tx_buf_tail]);
-		tx_buf_tail = TX_BUF_NEXT(tx_buf_tail);
-	}
+	tx_fifo_fill();
 
 	/* If output buffer is empty, disable transmit interrupt */
-	if (tx_buf_tail == tx_buf_head)
+	if (queue_is_empty(&tx_queue))
 		uart_tx_stop();
 }
 
@@ -529,28 +603,40 @@ void uart_set_console_mode(int enable)
 
 int uart_puts(const char *outstr)
 {
+	struct tx_line line;
+
+	line.len = 0;
+
 	/* Put all characters in the output buffer */
 	while (*outstr) {
-		if (__tx_char(NULL, *outstr++) != 0)
-			break;
+		if (__tx_char(&line, *outstr++) != 0)
+			return tx_line_finish(&line, EC_ERROR_OVERFLOW);
 	}
 
-	if (uart_tx_stopped())
-		uart_tx_start();
-
-	/* Successful if we consumed all output */
-	return *outstr ? EC_ERROR_OVERFLOW : EC_SUCCESS;
+	return tx_line_finish(&line, EC_SUCCESS);
 }
 
 
 int uart_vprintf(const char *format, va_list args)
 {
-	int rv = vfnprintf(__tx_char, NULL, format, args);
+	struct tx_line line;
+	int rv;
 
-	if (uart_tx_stopped())
-		uart_tx_start();
+	line.len = 0;
+	rv = vfnprintf(__tx_char, &line, format, args);
+	return tx_line_finish(&line, rv);
+}
 
-	return rv;
+
+int uart_printf_packed(const char *format, const uint32_t *args,
+		       uint64_t time)
+{
+	struct tx_line line;
+	int rv;
+
+	line.len = 0;
+	rv = vfnprintf_packed(__tx_char, &line, format, args, time);
+	return tx_line_finish(&line, rv);
 }
 
 
@@ -602,10 +688,16 @@ void VbExDebug(const char *format, ...)
 	__attribute__((weak, alias("uart_printf")));
 
 
+int uart_tx_buffer_space(void)
+{
+	return CONFIG_UART_TX_BUF_SIZE - queue_count(&tx_queue);
+}
+
+
 void uart_flush_output(void)
 {
 	/* Wait for buffer to empty */
-	while (tx_buf_head != tx_buf_tail) {
+	while (!queue_is_empty(&tx_queue)) {
 		/* It's possible we're in some other interrupt, and the
 		 * previous context was doing a printf() or puts() but hadn't
 		 * enabled the UART interrupt.  Check if the interrupt is
@@ -627,14 +719,10 @@ void uart_emergency_flush(void)
 		/* Copy output from buffer until TX fifo full
 		 * or output buffer empty
 		 */
-		while (uart_tx_ready() &&
-		       (tx_buf_head != tx_buf_tail)) {
-			uart_write_char(tx_buf[tx_buf_tail]);
-			tx_buf_tail = TX_BUF_NEXT(tx_buf_tail);
-		}
+		tx_fifo_fill();
 		/* Wait for transmit FIFO empty */
 		uart_tx_flush();
-	} while (tx_buf_head != tx_buf_tail);
+	} while (!queue_is_empty(&tx_queue));
 }
 
 
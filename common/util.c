@@ -139,12 +139,55 @@ int strtoi(const char *nptr, char **endptr, int base)
 }
 
 
+/* The mem* functions below move whole words when both pointers have the same
+ * alignment, 4 words per iteration so the compiler can use LDM/STM, and only
+ * handle the unaligned head and tail a byte at a time. */
+
+#define WORD_BYTES ((int)sizeof(uint32_t))
+/* Bytes per iteration of the unrolled word loops */
+#define WORD_BLOCK (4 * WORD_BYTES)
+
+/* Return non-zero if a and b have the same alignment within a word */
+static inline int same_alignment(const void *a, const void *b)
+{
+	return !(((uint32_t)a ^ (uint32_t)b) & (WORD_BYTES - 1));
+}
+
+/* Return the number of bytes before p is word-aligned, at most len */
+static inline int align_head(const void *p, int len)
+{
+	int head = -(uint32_t)p & (WORD_BYTES - 1);
+
+	return head < len ? head : len;
+}
+
+
 int memcmp(const void *s1, const void *s2, int len)
 {
 	const char *sa = s1;
 	const char *sb = s2;
 
 	int diff = 0;
+
+	if (same_alignment(sa, sb)) {
+		int head = align_head(sa, len);
+
+		while (head-- > 0) {
+			diff = *(sa++) - *(sb++);
+			if (diff)
+				return diff;
+			len--;
+		}
+		/* Skip the equal words; the bytes of the first different word
+		 * are compared below. */
+		while (len >= WORD_BYTES &&
+		       *(const uint32_t *)sa == *(const uint32_t *)sb) {
+			sa += WORD_BYTES;
+			sb += WORD_BYTES;
+			len -= WORD_BYTES;
+		}
+	}
+
 	while (len-- > 0) {
 		diff = *(sa++) - *(sb++);
 		if (diff)
@@ -157,9 +200,37 @@ int memcmp(const void *s1, const void *s2, int len)
 
 void *memcpy(void *dest, const void *src, int len)
 {
-	/* TODO: optimized version using LDM/STM would be much faster */
 	char *d = (char *)dest;
 	const char *s = (const char *)src;
+
+	if (same_alignment(d, s)) {
+		int head = align_head(d, len);
+		uint32_t *dw;
+		const uint32_t *sw;
+
+		len -= head;
+		while (head-- > 0)
+			*(d++) = *(s++);
+
+		dw = (uint32_t *)d;
+		sw = (const uint32_t *)s;
+		while (len >= WORD_BLOCK) {
+			dw[0] = sw[0];
+			dw[1] = sw[1];
+			dw[2] = sw[2];
+			dw[3] = sw[3];
+			dw += 4;
+			sw += 4;
+			len -= WORD_BLOCK;
+		}
+		while (len >= WORD_BYTES) {
+			*(dw++) = *(sw++);
+			len -= WORD_BYTES;
+		}
+		d = (char *)dw;
+		s = (const char *)sw;
+	}
+
 	while (len > 0) {
 		*(d++) = *(s++);
 		len--;
@@ -170,8 +241,30 @@ void *memcpy(void *dest, const void *src, int len)
 
 void *memset(void *dest, int c, int len)
 {
-	/* TODO: optimized version using STM would be much faster */
 	char *d = (char *)dest;
+	int head = align_head(d, len);
+	uint32_t cw = (c & 0xff) * 0x01010101;
+	uint32_t *dw;
+
+	len -= head;
+	while (head-- > 0)
+		*(d++) = c;
+
+	dw = (uint32_t *)d;
+	while (len >= WORD_BLOCK) {
+		dw[0] = cw;
+		dw[1] = cw;
+		dw[2] = cw;
+		dw[3] = cw;
+		dw += 4;
+		len -= WORD_BLOCK;
+	}
+	while (len >= WORD_BYTES) {
+		*(dw++) = cw;
+		len -= WORD_BYTES;
+	}
+
+	d = (char *)dw;
 	while (len > 0) {
 		*(d++) = c;
 		len--;
@@ -191,7 +284,38 @@ void *memmove(void *dest, const void *src, int len)
 		/* Copy from end, so we don't overwrite the source */
 		char *d = (char *)dest + len;
 		const char *s = (const char *)src + len;
-		/* TODO: optimized version using LDM/STM would be much faster */
+
+		if (same_alignment(d, s)) {
+			/* Bytes after the last word boundary */
+			int tail = (uint32_t)d & (WORD_BYTES - 1);
+			uint32_t *dw;
+			const uint32_t *sw;
+
+			if (tail > len)
+				tail = len;
+			len -= tail;
+			while (tail-- > 0)
+				*(--d) = *(--s);
+
+			dw = (uint32_t *)d;
+			sw = (const uint32_t *)s;
+			while (len >= WORD_BLOCK) {
+				dw -= 4;
+				sw -= 4;
+				dw[3] = sw[3];
+				dw[2] = sw[2];
+				dw[1] = sw[1];
+				dw[0] = sw[0];
+				len -= WORD_BLOCK;
+			}
+			while (len >= WORD_BYTES) {
+				*(--dw) = *(--sw);
+				len -= WORD_BYTES;
+			}
+			d = (char *)dw;
+			s = (const char *)sw;
+		}
+
 		while (len > 0) {
 			*(--d) = *(--s);
 			len--;
@@ -201,6 +325,99 @@ void *memmove(void *dest, const void *src, int len)
 }
 
 
+/*
+ * Byte sums are done a word at a time, with the bytes of each word added into
+ * two 16-bit lanes.  Each word adds at most 2 * 0xff to a lane, so this many
+ * words can be added before the lanes must be folded into the sum.
+ */
+#define SUM_LANE_WORDS 128
+
+static inline uint32_t sum_lanes(uint32_t w)
+{
+	return (w & 0x00ff00ff) + ((w >> 8) & 0x00ff00ff);
+}
+
+static inline int fold_lanes(uint32_t lanes)
+{
+	return (lanes & 0xffff) + (lanes >> 16);
+}
+
+
+int sum_bytes(const void *data, int len)
+{
+	const uint8_t *s = data;
+	int head = align_head(s, len);
+	const uint32_t *sw;
+	int sum = 0;
+
+	len -= head;
+	while (head-- > 0)
+		sum += *(s++);
+
+	sw = (const uint32_t *)s;
+	while (len >= WORD_BYTES) {
+		int n = MIN(len / WORD_BYTES, SUM_LANE_WORDS);
+		uint32_t lanes = 0;
+
+		len -= n * WORD_BYTES;
+		while (n-- > 0)
+			lanes += sum_lanes(*(sw++));
+		sum += fold_lanes(lanes);
+	}
+	s = (const uint8_t *)sw;
+
+	while (len-- > 0)
+		sum += *(s++);
+
+	return sum;
+}
+
+
+int memcpy_sum(void *dest, const void *src, int len)
+{
+	uint8_t *d = dest;
+	const uint8_t *s = src;
+	int sum = 0;
+
+	if (same_alignment(d, s)) {
+		int head = align_head(d, len);
+		uint32_t *dw;
+		const uint32_t *sw;
+
+		len -= head;
+		while (head-- > 0) {
+			sum += *s;
+			*(d++) = *(s++);
+		}
+
+		dw = (uint32_t *)d;
+		sw = (const uint32_t *)s;
+		while (len >= WORD_BYTES) {
+			int n = MIN(len / WORD_BYTES, SUM_LANE_WORDS);
+			uint32_t lanes = 0;
+
+			len -= n * WORD_BYTES;
+			while (n-- > 0) {
+				uint32_t w = *(sw++);
+
+				*(dw++) = w;
+				lanes += sum_lanes(w);
+			}
+			sum += fold_lanes(lanes);
+		}
+		d = (uint8_t *)dw;
+		s = (const uint8_t *)sw;
+	}
+
+	while (len-- > 0) {
+		sum += *s;
+		*(d++) = *(s++);
+	}
+
+	return sum;
+}
+
+
 char *strzcpy(char *dest, const char *src, int len)
 {
 	char *d = dest;
@@ -64,4 +64,26 @@ static inline uint32_t atomic_read_clear(uint32_t *addr)
 
 	return ret;
 }
+
+/**
+ * Set *addr to new if it is old.  Returns non-zero if it was set, zero if
+ * *addr held something else.
+ */
+static inline int atomic_cas(uint32_t *addr, uint32_t old, uint32_t new)
+{
+	uint32_t val, fail = 1;
+
+	__asm__ __volatile__("1: ldrex   %0, [%2]\n"
+	                     "   cmp     %0, %3\n"
+	                     "   bne     2f\n"
+	                     "   strex   %1, %4, [%2]\n"
+	                     "   teq     %1, #0\n"
+	                     "   bne     1b\n"
+	                     "2: clrex"
+	                     : "=&r" (val), "+&r" (fail)
+	                     : "r" (addr), "r" (old), "r" (new)
+	                     : "cc", "memory");
+
+	return !fail;
+}
 #endif  /* __CROS_EC_ATOMIC_H */
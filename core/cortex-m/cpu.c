@@ -16,4 +16,9 @@ void cpu_init(void)
 	/* Enable reporting of memory faults, bus faults and usage faults */
 	CPU_NVIC_SHCSR |= CPU_NVIC_SHCSR_MEMFAULTENA |
 		CPU_NVIC_SHCSR_BUSFAULTENA | CPU_NVIC_SHCSR_USGFAULTENA;
+
+	/* Start the cycle counter, for measuring short code paths */
+	CPU_DEMCR |= CPU_DEMCR_TRCENA;
+	CPU_DWT_CYCCNT = 0;
+	CPU_DWT_CTRL |= CPU_DWT_CTRL_CYCCNTENA;
 }
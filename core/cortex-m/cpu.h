@@ -31,6 +31,12 @@
 #define CPU_NVIC_MFAR          CPUREG(0xe000ed34)
 #define CPU_NVIC_BFAR          CPUREG(0xe000ed38)
 
+/* Debug exception and monitor control, and the cycle counter of the Data
+ * Watchpoint and Trace unit */
+#define CPU_DEMCR              CPUREG(0xe000edfc)
+#define CPU_DWT_CTRL           CPUREG(0xe0001000)
+#define CPU_DWT_CYCCNT         CPUREG(0xe0001004)
+
 enum {
 	CPU_NVIC_MMFS_BFARVALID		= 1 << 15,
 	CPU_NVIC_MMFS_MFARVALID		= 1 << 7,
@@ -45,6 +51,9 @@ enum {
 	CPU_NVIC_SHCSR_MEMFAULTENA	= 1 << 16,
 	CPU_NVIC_SHCSR_BUSFAULTENA	= 1 << 17,
 	CPU_NVIC_SHCSR_USGFAULTENA	= 1 << 18,
+
+	CPU_DEMCR_TRCENA		= 1 << 24,
+	CPU_DWT_CTRL_CYCCNTENA		= 1 << 0,
 };
 
 /* Set up the cpu to detect faults */
@@ -6,6 +6,7 @@
 #include <stdarg.h>
 
 #include "config.h"
+#include "console.h"
 #include "cpu.h"
 #include "panic.h"
 #include "system.h"
@@ -31,7 +32,8 @@ static struct save_area
 
 void panic_putc(int ch)
 {
-	uart_emergency_flush();
+	/* Output from before the panic goes first */
+	console_emergency_flush();
 	if (ch == '\n')
 		panic_putc('\r');
 	uart_write_char(ch);
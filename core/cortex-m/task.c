@@ -7,6 +7,7 @@
 
 #include "config.h"
 #include "atomic.h"
+#include "clock.h"
 #include "console.h"
 #include "cpu.h"
 #include "link_defs.h"
@@ -15,33 +16,22 @@
 #include "uart.h"
 #include "util.h"
 
-/**
- * Global memory size for a task : 512 bytes
- * including its contexts and its stack
- */
-#define TASK_SIZE_LOG2 9
-#define TASK_SIZE      (1<<TASK_SIZE_LOG2)
-
-typedef union {
-	struct {
-		uint32_t sp;       /* saved stack pointer for context switch */
-		uint32_t events;   /* bitmaps of received events */
-		uint64_t runtime;  /* Time spent in task */
-		uint32_t guard;    /* Guard value to detect stack overflow */
-		uint8_t stack[0];  /* task stack */
-	};
-	uint32_t context[TASK_SIZE/4];
+typedef struct {
+	uint32_t sp;       /* saved stack pointer for context switch */
+	uint32_t events;   /* bitmaps of received events */
+	uint64_t runtime;  /* Time spent in task */
+	uint32_t *stack;   /* Start of stack */
 } task_;
 
 /* declare task routine prototypes */
-#define TASK(n, r, d) int r(void *);
+#define TASK(n, r, d, s) int r(void *);
 #include TASK_LIST
 static void __idle(void);
 CONFIG_TASK_LIST
 #undef TASK
 
 /* store the task names for easier debugging */
-#define TASK(n, r, d)  #n,
+#define TASK(n, r, d, s)  #n,
 #include TASK_LIST
 static const char * const task_names[] = {
 	"<< idle >>",
@@ -72,9 +62,15 @@ void __idle(void)
 	cprintf(CC_TASK, "[%T idle task started]\n");
 
 	while (1) {
+#ifdef CONFIG_LOW_POWER_IDLE
+		/* Sleep as deeply as the next timer deadline allows, until
+		 * the next irq event. */
+		clock_idle();
+#else
 		/* Wait for the next irq event.  This stops the CPU clock
 		 * (sleep / deep sleep, depending on chip config). */
 		asm("wfi");
+#endif
 	}
 }
 
@@ -89,32 +85,45 @@ static void task_exit_trap(void)
 }
 
 
-#define GUARD_VALUE 0x12345678
+/* Value used to fill the unused part of the task stacks.  Used to compute
+ * the stack high-water mark and to detect stack overflow. */
+#define STACK_UNUSED_VALUE 0xdeadd00d
 
 /* Startup parameters for all tasks. */
-#define TASK(n, r, d)  {	\
+#define TASK(n, r, d, s)  {	\
 	.r0 = (uint32_t)d,	\
 	.pc = (uint32_t)r,	\
+	.stack_size = s,	\
 },
 #include TASK_LIST
 static const struct {
 	uint32_t r0;
 	uint32_t pc;
+	uint16_t stack_size;
 } const tasks_init[] = {
-	TASK(IDLE, __idle, 0)
+	TASK(IDLE, __idle, 0, IDLE_TASK_STACK_SIZE)
 	CONFIG_TASK_LIST
 };
 #undef TASK
-/* Contexts and stacks for all tasks. */
-static task_ tasks[TASK_ID_COUNT] __attribute__((section(".bss.tasks")))
-		__attribute__((aligned(TASK_SIZE)));
-/* Reserve space to discard context on first context switch.  This must
- * immediately follow tasks, so that it is start-aligned to TASK_SIZE so that
- * __get_current(scratchpad) == scratchpad.  Note that aligned(TASK_SIZE) also
- * size-aligns it, which wastes (512 - 17*4) bytes of RAM, so we simply put it
- * in its own section which immediately follows .bss.tasks in ec.lds.S. */
+
+/* Contexts for all tasks. */
+static task_ tasks[TASK_ID_COUNT];
+
+/* Stacks for all tasks, back to back in task order. */
+#define TASK(n, r, d, s)  + (s)
+#include TASK_LIST
+uint8_t task_stacks[0
+		    TASK(IDLE, __idle, 0, IDLE_TASK_STACK_SIZE)
+		    CONFIG_TASK_LIST
+] __attribute__((section(".bss.task_stacks"))) __attribute__((aligned(8)));
+#undef TASK
+
+/* Reserve space to discard context on first context switch. */
 uint32_t scratchpad[17] __attribute__((section(".bss.task_scratchpad")));
 
+/* Task currently running; scratchpad until the first context switch. */
+static task_ *current_task = (task_ *)scratchpad;
+
 /* Should IRQs chain to svc_handler()?  This should be set if either of the
  * following is true:
  *
@@ -133,29 +142,24 @@ static int need_resched_or_profiling = 0;
  */
 static uint32_t tasks_ready = (1<<TASK_ID_COUNT) - 1;
 
-static int start_called;  /* Has task swapping started */
-
+/**
+ * bitmap of tasks blocked on a contended mutex
+ *
+ * Such a task lends its priority to the owner of the mutex it is waiting for
+ * (see __next_task_id()), so a lower priority owner cannot be starved by
+ * middle priority tasks while a higher priority task waits for it.
+ */
+static uint32_t tasks_mutex_wait;
 
-static task_ *__get_current(void)
-{
-	unsigned sp;
+/* mutex each task of tasks_mutex_wait is blocked on */
+static struct mutex *task_wait_mutex[TASK_ID_COUNT];
 
-	asm("mov %0, sp":"=r"(sp));
-	return (task_ *)((sp - 4) & ~(TASK_SIZE-1));
-}
+static int start_called;  /* Has task swapping started */
 
 
-/**
- * Return a pointer to the task preempted by the current exception
- *
- * designed to be called from interrupt context.
- */
-static task_ *__get_task_scheduled(void)
+static inline task_ *__get_current(void)
 {
-	unsigned sp;
-
-	asm("mrs %0, psp":"=r"(sp));
-	return (task_ *)((sp - 16) & ~(TASK_SIZE-1));
+	return current_task;
 }
 
 
@@ -177,6 +181,22 @@ void interrupt_enable(void)
 }
 
 
+uint32_t interrupt_disable_save(void)
+{
+	uint32_t primask;
+
+	asm volatile("mrs %0, primask\n"
+		     "cpsid i\n" : "=r"(primask));
+	return primask;
+}
+
+
+void interrupt_restore(uint32_t state)
+{
+	asm volatile("msr primask, %0" :: "r"(state));
+}
+
+
 inline int in_interrupt_context(void)
 {
 	int ret;
@@ -196,17 +216,61 @@ inline int get_interrupt_context(void)
 
 task_id_t task_from_addr(uint32_t addr)
 {
-	task_id_t id = (addr - (uint32_t)tasks) >> TASK_SIZE_LOG2;
-	if (id >= TASK_ID_COUNT)
-		id = TASK_ID_INVALID;
+	task_id_t id;
+
+	/* Task context */
+	if (addr >= (uint32_t)tasks && addr < (uint32_t)(tasks + TASK_ID_COUNT))
+		return (addr - (uint32_t)tasks) / sizeof(task_);
 
-	return id;
+	/* Task stack; stacks are not the same size, so look for it */
+	for (id = 0; id < TASK_ID_COUNT; id++) {
+		uint32_t stack = (uint32_t)tasks[id].stack;
+
+		if (addr >= stack && addr < stack + tasks_init[id].stack_size)
+			return id;
+	}
+
+	return TASK_ID_INVALID;
 }
 
 
 task_id_t task_get_current(void)
 {
-	return task_from_addr((uint32_t)__get_current());
+	/* Interrupts and the code before task_start() don't run in a task */
+	if (!start_called || in_interrupt_context())
+		return TASK_ID_INVALID;
+
+	return current_task - tasks;
+}
+
+
+int task_get_stack_info(task_id_t tskid, int *size, int *used)
+{
+	const uint32_t *sp;
+	const uint32_t *top;
+
+	if (tskid >= TASK_ID_COUNT)
+		return EC_ERROR_INVAL;
+
+	/* Count the words at the bottom of the stack which were never
+	 * overwritten since task_pre_init(). */
+	sp = tasks[tskid].stack;
+	top = sp + tasks_init[tskid].stack_size / 4;
+	while (sp < top && *sp == STACK_UNUSED_VALUE)
+		sp++;
+
+	*size = tasks_init[tskid].stack_size;
+	*used = (top - sp) * 4;
+	return EC_SUCCESS;
+}
+
+
+const char *task_get_name(task_id_t tskid)
+{
+	if (tskid >= TASK_ID_COUNT)
+		return "<< unknown >>";
+
+	return task_names[tskid];
 }
 
 
@@ -223,6 +287,49 @@ int task_start_called(void)
 }
 
 
+/**
+ * Return the task which should run next.
+ *
+ * This is the highest priority ready task, unless a higher priority task is
+ * blocked on a mutex whose owner (or the owner of the mutex that owner is
+ * itself blocked on, and so on) is ready: that owner then runs with the
+ * priority of the waiter.
+ */
+static task_id_t __next_task_id(void)
+{
+	uint32_t candidates = tasks_ready | tasks_mutex_wait;
+	task_id_t id, run;
+	int depth;
+
+	/* Fast path : no priority inheritance in progress */
+	if (!tasks_mutex_wait)
+		return 31 - __builtin_clz(tasks_ready);
+
+	while (candidates) {
+		id = 31 - __builtin_clz(candidates);
+		if (tasks_ready & (1 << id))
+			return id;
+
+		/* Follow the chain of mutex owners */
+		run = id;
+		for (depth = 0; depth < TASK_ID_COUNT; depth++) {
+			if (!(tasks_mutex_wait & (1 << run)))
+				break;
+			run = task_wait_mutex[run]->owner;
+			/* Mutex was released in the meantime */
+			if (run == TASK_ID_IDLE || run >= TASK_ID_COUNT)
+				break;
+			if (tasks_ready & (1 << run))
+				return run;
+		}
+
+		candidates &= ~(1 << id);
+	}
+
+	return 31 - __builtin_clz(tasks_ready);
+}
+
+
 /* Scheduling system call */
 void svc_handler(int desched, task_id_t resched)
 {
@@ -246,9 +353,10 @@ void svc_handler(int desched, task_id_t resched)
 	}
 #endif
 
-	current = __get_task_scheduled();
+	current = current_task;
 #ifdef CONFIG_OVERFLOW_DETECT
-	ASSERT(current->guard == GUARD_VALUE);
+	ASSERT(current == (task_ *)scratchpad ||
+	       *current->stack == STACK_UNUSED_VALUE);
 #endif
 
 	if (desched && !current->events) {
@@ -258,7 +366,7 @@ void svc_handler(int desched, task_id_t resched)
 	tasks_ready |= 1 << resched;
 
 	ASSERT(tasks_ready);
-	next = __task_id_to_ptr(31 - __builtin_clz(tasks_ready));
+	next = __task_id_to_ptr(__next_task_id());
 
 #ifdef CONFIG_TASK_PROFILING
 	/* Track time in interrupts */
@@ -283,6 +391,7 @@ void svc_handler(int desched, task_id_t resched)
 #ifdef CONFIG_TASK_PROFILING
 	task_switches++;
 #endif
+	current_task = next;
 	__switchto(current, next);
 }
 
@@ -450,9 +559,12 @@ static void __nvic_init_irqs(void)
 void mutex_lock(struct mutex *mtx)
 {
 	uint32_t value;
-	uint32_t id = 1 << task_get_current();
+	task_id_t me = task_get_current();
+	uint32_t id = 1 << me;
+	timestamp_t start;
+	int contended = 0;
 
-	ASSERT(id != TASK_ID_INVALID);
+	ASSERT(me != TASK_ID_INVALID);
 	atomic_or(&mtx->waiters, id);
 
 	do {
@@ -468,11 +580,29 @@ void mutex_lock(struct mutex *mtx)
 		 */
 		if (value == 2) {
 			/* contention on the mutex */
+			if (!contended) {
+				contended = 1;
+				start = get_time();
+			}
+			/* lend our priority to the owner while we wait */
+			task_wait_mutex[me] = mtx;
+			atomic_or(&tasks_mutex_wait, id);
 			task_wait_event(0);
+			atomic_clear(&tasks_mutex_wait, id);
 		}
 	} while (value);
 
+	mtx->owner = me;
 	atomic_clear(&mtx->waiters, id);
+
+	/* Statistics are only updated by the owner, so need no locking */
+	if (contended) {
+		uint32_t wait_us = time_since32(start);
+
+		mtx->contentions++;
+		if (wait_us > mtx->max_wait_us)
+			mtx->max_wait_us = wait_us;
+	}
 }
 
 
@@ -481,6 +611,9 @@ void mutex_unlock(struct mutex *mtx)
 	uint32_t waiters;
 	task_ *tsk = __get_current();
 
+	/* no more owner to boost for the tasks still blocked on the mutex */
+	mtx->owner = TASK_ID_IDLE;
+
 	__asm__ __volatile__("   ldr     %0, [%2]\n"
 			     "   str     %3, [%1]\n"
 			     : "=&r" (waiters)
@@ -499,13 +632,15 @@ void mutex_unlock(struct mutex *mtx)
 
 void task_print_list(void)
 {
-	int i;
-	ccputs("Task Ready Name         Events      Time (s)\n");
+	int i, size, used;
+	ccputs("Task Ready Name         Events      Time (s)  StkUsed\n");
 
 	for (i = 0; i < TASK_ID_COUNT; i++) {
 		char is_ready = (tasks_ready & (1<<i)) ? 'R' : ' ';
-		ccprintf("%4d %c %-16s %08x %11.6ld\n", i, is_ready,
-			 task_names[i], tasks[i].events, tasks[i].runtime);
+		task_get_stack_info(i, &size, &used);
+		ccprintf("%4d %c %-16s %08x %11.6ld  %3d/%3d\n", i, is_ready,
+			 task_names[i], tasks[i].events, tasks[i].runtime,
+			 used, size);
 		if (in_interrupt_context())
 			uart_emergency_flush();
 		else
@@ -575,27 +710,41 @@ DECLARE_CONSOLE_COMMAND(taskready, command_task_ready,
 
 int task_pre_init(void)
 {
+	uint32_t *stack_next = (uint32_t *)task_stacks;
+	uint32_t *sp;
 	int i;
 
 	/* fill the task memory with initial values */
 	for (i = 0; i < TASK_ID_COUNT; i++) {
-		tasks[i].sp = (uint32_t)(tasks + i + 1) - 64;
-		tasks[i].guard = GUARD_VALUE;
-		/* initial context on stack */
-		tasks[i].context[TASK_SIZE/4 - 8/*r0*/] = tasks_init[i].r0;
-		tasks[i].context[TASK_SIZE/4 - 3/*lr*/] =
-			(uint32_t)task_exit_trap;
-		tasks[i].context[TASK_SIZE/4 - 2/*pc*/] = tasks_init[i].pc;
-		tasks[i].context[TASK_SIZE/4 - 1/*psr*/] = 0x01000000;
-	}
+		int ssize = tasks_init[i].stack_size;
+
+		tasks[i].stack = stack_next;
 
-	/* Fill in guard value in scratchpad to prevent stack overflow
-	 * detection failure on the first context switch. */
-	((task_ *)scratchpad)->guard = GUARD_VALUE;
+		/* initial context on stack : the 8-word exception frame, and
+		 * below it r4-r11 restored by __switchto() */
+		sp = stack_next + ssize / 4 - 16;
+		tasks[i].sp = (uint32_t)sp;
+		sp[8] = tasks_init[i].r0;             /* r0 */
+		sp[13] = (uint32_t)task_exit_trap;    /* lr */
+		sp[14] = tasks_init[i].pc;            /* pc */
+		sp[15] = 0x01000000;                  /* psr */
+
+		/* fill the unused stack to track its high-water mark */
+		for (sp = stack_next; sp < (uint32_t *)tasks[i].sp; sp++)
+			*sp = STACK_UNUSED_VALUE;
+
+		stack_next += ssize / 4;
+	}
 
 	/* sanity checks about static task invariants */
 	BUILD_ASSERT(TASK_ID_COUNT <= sizeof(unsigned) * 8);
 	BUILD_ASSERT(TASK_ID_COUNT < (1 << (sizeof(task_id_t) * 8)));
+	/* stacks must stay 64-bit aligned */
+#define TASK(n, r, d, s)  BUILD_ASSERT((s) % 8 == 0);
+#include TASK_LIST
+	BUILD_ASSERT(IDLE_TASK_STACK_SIZE % 8 == 0);
+	CONFIG_TASK_LIST
+#undef TASK
 
 	/* Initialize IRQs */
 	__nvic_init_irqs();
@@ -7,6 +7,7 @@
 
 #include "atomic.h"
 #include "console.h"
+#include "cpu.h"
 #include "hooks.h"
 #include "hwtimer.h"
 #include "system.h"
@@ -14,6 +15,7 @@
 #include "util.h"
 #include "task.h"
 #include "timer.h"
+#include "timer_heap.h"
 
 /* high word of the 64-bit timestamp counter  */
 static volatile uint32_t clksrc_high;
@@ -22,17 +24,34 @@ static volatile uint32_t clksrc_high;
 static uint32_t timer_running = 0;
 
 /* deadlines of all timers */
-static timestamp_t timer_deadline[TASK_ID_COUNT];
+static struct timer_heap_node timer_nodes[TASK_ID_COUNT];
 static uint32_t next_deadline = 0xffffffff;
 
+/**
+ * Running timers, ordered by deadline.
+ *
+ * The heap is only modified by tasks with interrupts masked (timer_arm /
+ * timer_cancel) and by the timer interrupt routine itself.
+ */
+static struct timer_heap_node *timer_heap_nodes[TASK_ID_COUNT];
+static struct timer_heap timer_heap = {timer_heap_nodes, TASK_ID_COUNT};
+
 /* Hardware timer routine IRQ number */
 static int timer_irq;
 
+/* Timer interrupt statistics */
+static uint32_t timer_irq_count;      /* Number of calls to process_timers() */
+static uint32_t timer_expired_count;  /* Number of expired timers */
+static uint64_t timer_irq_time;       /* Total time spent in process_timers() */
+static uint64_t timer_irq_cycles;     /* The same in CPU cycles */
+
 
 static void expire_timer(task_id_t tskid)
 {
 	/* we are done with this timer */
+	timer_heap_remove(&timer_heap, timer_nodes + tskid);
 	atomic_clear(&timer_running, 1<<tskid);
+	timer_expired_count++;
 	/* wake up the taks waiting for this timer */
 	task_set_event(tskid, TASK_EVENT_TIMER, 0);
 }
@@ -51,46 +70,41 @@ int timestamp_expired(timestamp_t deadline, const timestamp_t *now)
 
 void process_timers(int overflow)
 {
-	uint32_t check_timer, running_t0;
+	struct timer_heap_node *first;
 	timestamp_t next;
 	timestamp_t now;
+	timestamp_t start = get_time();
+	uint32_t start_cycles = CPU_DWT_CYCCNT;
 
 	if (overflow)
 		clksrc_high++;
 
+	timer_irq_count++;
+
 	do {
-		next.val = 0xffffffffffffffff;
 		now = get_time();
-		do {
-			/* read atomically the current state of timer running */
-			check_timer = running_t0 = timer_running;
-			while (check_timer) {
-				int tskid = 31 - __builtin_clz(check_timer);
-
-				/* timer has expired ? */
-				if (timer_deadline[tskid].val < now.val)
-					expire_timer(tskid);
-				else if ((timer_deadline[tskid].le.hi ==
-					  now.le.hi) &&
-					 (timer_deadline[tskid].le.lo <
-					  next.le.lo))
-					next.val = timer_deadline[tskid].val;
-
-				check_timer &= ~(1 << tskid);
-			}
-		/* if there is a new timer, let's retry */
-		} while (timer_running & ~running_t0);
-
-		if (next.le.hi == 0xffffffff) {
+
+		/* Expire all the timers at the head of the queue */
+		while ((first = timer_heap_first(&timer_heap)) &&
+		       first->deadline.val <= now.val)
+			expire_timer(first - timer_nodes);
+
+		/* Only program deadlines within the current 32-bit epoch; the
+		 * overflow interrupt brings us back here for later ones. */
+		if (!first || first->deadline.le.hi != now.le.hi) {
 			/* no deadline to set */
 			__hw_clock_event_clear();
 			next_deadline = 0xffffffff;
-			return;
+			break;
 		}
 
+		next = first->deadline;
 		__hw_clock_event_set(next.le.lo);
 		next_deadline = next.le.lo;
 	} while (next.val <= get_time().val);
+
+	timer_irq_time += get_time().val - start.val;
+	timer_irq_cycles += CPU_DWT_CYCCNT - start_cycles;
 }
 
 
@@ -105,13 +119,20 @@ void udelay(unsigned us)
 
 int timer_arm(timestamp_t tstamp, task_id_t tskid)
 {
+	uint32_t irq;
+
 	ASSERT(tskid < TASK_ID_COUNT);
 
 	if (timer_running & (1<<tskid))
 		return EC_ERROR_BUSY;
 
-	timer_deadline[tskid] = tstamp;
+	timer_nodes[tskid].deadline = tstamp;
+
+	/* Queue the timer, keeping the timer interrupt away from the heap */
+	irq = interrupt_disable_save();
+	timer_heap_insert(&timer_heap, timer_nodes + tskid);
 	atomic_or(&timer_running, 1<<tskid);
+	interrupt_restore(irq);
 
 	/* modify the next event if needed */
 	if ((tstamp.le.hi < clksrc_high) ||
@@ -124,9 +145,16 @@ int timer_arm(timestamp_t tstamp, task_id_t tskid)
 
 int timer_cancel(task_id_t tskid)
 {
+	uint32_t irq;
+
 	ASSERT(tskid < TASK_ID_COUNT);
 
-	atomic_clear(&timer_running, 1<<tskid);
+	irq = interrupt_disable_save();
+	if (timer_running & (1<<tskid)) {
+		timer_heap_remove(&timer_heap, timer_nodes + tskid);
+		atomic_clear(&timer_running, 1<<tskid);
+	}
+	interrupt_restore(irq);
 	/* don't bother about canceling the interrupt:
 	 * it would be slow, just do it on the next IT
 	 */
@@ -169,6 +197,26 @@ timestamp_t get_time(void)
 }
 
 
+uint32_t timer_next_event_us(void)
+{
+	timestamp_t now = get_time();
+	/* Time until the 32-bit counter overflows */
+	uint32_t next = 0xffffffff - now.le.lo;
+	struct timer_heap_node *first = timer_heap_first(&timer_heap);
+
+	if (first) {
+		timestamp_t deadline = first->deadline;
+
+		if (deadline.val <= now.val)
+			return 0;
+		if (deadline.val - now.val < next)
+			next = deadline.le.lo - now.le.lo;
+	}
+
+	return next;
+}
+
+
 void timer_print_info(void)
 {
 	uint64_t t = get_time().val;
@@ -180,11 +228,24 @@ void timer_print_info(void)
 		 "Deadline: 0x%016lx -> %11.6ld s from now\n"
 		 "Active timers:\n",
 		 t, deadline, deadline - t);
+	ccprintf("Timer IRQs:    %11d\n"
+		 "Timers expired:%11d\n"
+		 "Time in IRQ:   %11.6ld s\n",
+		 timer_irq_count, timer_expired_count, timer_irq_time);
+	ccprintf("Cycles in IRQ: %11ld\n", timer_irq_cycles);
+	if (timer_expired_count) {
+		/* A heap pop is well under the 1 us timer resolution, so the
+		 * cost per expiry is in cycles */
+		uint64_t per_expiry = timer_irq_cycles;
+
+		uint64divmod(&per_expiry, timer_expired_count);
+		ccprintf("Per expiry:    %11d cycles\n", (uint32_t)per_expiry);
+	}
 	for (tskid = 0; tskid < TASK_ID_COUNT; tskid++) {
 		if (timer_running & (1<<tskid)) {
 			ccprintf("  Tsk %2d  0x%016lx -> %11.6ld\n", tskid,
-				 timer_deadline[tskid].val,
-				 timer_deadline[tskid].val - t);
+				 timer_nodes[tskid].deadline.val,
+				 timer_nodes[tskid].deadline.val - t);
 			if (in_interrupt_context())
 				uart_emergency_flush();
 			else
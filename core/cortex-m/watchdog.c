@@ -8,6 +8,7 @@
 #include "board.h"
 #include "common.h"
 #include "config.h"
+#include "console.h"
 #include "registers.h"
 #include "task.h"
 #include "timer.h"
@@ -36,14 +37,14 @@ void watchdog_trace(uint32_t excep_lr, uint32_t excep_sp)
 	else
 		uart_printf("(task %d) ###\n", task_from_addr(psp));
 	/* Ensure this debug message is always flushed to the UART */
-	uart_emergency_flush();
+	console_emergency_flush();
 
 	/* If we are blocked in a high priority IT handler, the following debug
 	 * messages might not appear but they are useless in that situation. */
 	timer_print_info();
-	uart_emergency_flush();
+	console_emergency_flush();
 	task_print_list();
-	uart_emergency_flush();
+	console_emergency_flush();
 }
 
 
@@ -0,0 +1,24 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Boot time profiler for Chrome EC */
+
+#ifndef __CROS_EC_BOOT_TIME_H
+#define __CROS_EC_BOOT_TIME_H
+
+#include "common.h"
+#include "ec_commands.h"
+
+/* Initialize the module.  Restores the milestones recorded by the previous
+ * image if we jumped to this one, so must be called after
+ * system_common_pre_init() and before the jump data is overwritten. */
+void boot_time_init(void);
+
+/* Record a boot milestone.  Milestones recorded before
+ * EC_BOOT_TIME_TIMER_INIT have no valid time, since get_time() does not work
+ * until timer_init(). */
+void boot_time_mark(enum ec_boot_time_milestone milestone);
+
+#endif  /* __CROS_EC_BOOT_TIME_H */
@@ -23,4 +23,19 @@ int clock_enable_pll(int enable);
  * clocks/timers are initialized. */
 void clock_wait_cycles(uint32_t cycles);
 
+/* Low power states used by the idle task, from the shallowest to the deepest.
+ * Deeper states save more power but take longer to wake up from. */
+enum idle_state {
+	IDLE_STATE_WFI = 0,       /* CPU clock stopped */
+	IDLE_STATE_DEEP_SLEEP,    /* Deep sleep with the PLL powered down */
+	IDLE_STATE_HIBERNATE,     /* Deep sleep, flash and SRAM in low power */
+
+	IDLE_STATE_COUNT
+};
+
+/* Enter the deepest idle state which is allowed and fits before the next timer
+ * deadline, and return once an interrupt is pending.  Called by the idle
+ * task. */
+void clock_idle(void);
+
 #endif  /* __CROS_EC_CLOCK_H */
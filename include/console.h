@@ -72,6 +72,10 @@ int cprintf(enum console_channel channel, const char *format, ...);
 /* Flush the console output for all channels. */
 void cflush(void);
 
+/* Flush the console output, including output not yet formatted, without
+ * waiting on tasks or interrupts.  For panics and watchdog warnings. */
+void console_emergency_flush(void);
+
 /* Convenience macros for printing to the command channel.
  *
  * Modules may define similar macros in their .c files for their own use; it is
@@ -0,0 +1,22 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Console history for Chrome EC */
+
+#ifndef __CROS_EC_CONSOLE_HISTORY_H
+#define __CROS_EC_CONSOLE_HISTORY_H
+
+#include "common.h"
+
+/* Initialize the module.  Restores the history kept by the previous image if
+ * we jumped to this one, so must be called after system_common_pre_init() and
+ * before anything is printed. */
+void console_history_init(void);
+
+/* Add len bytes of console output to the history.  May be called from several
+ * tasks and interrupt routines at once. */
+void console_history_add(const char *s, int len);
+
+#endif  /* __CROS_EC_CONSOLE_HISTORY_H */
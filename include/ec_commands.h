@@ -28,7 +28,7 @@
  */
 
 /* Current version of this protocol */
-#define EC_PROTO_VERSION          0x00000002
+#define EC_PROTO_VERSION          0x00000003
 
 /* Command version mask */
 #define EC_VER_MASK(version) (1UL << (version))
@@ -63,6 +63,9 @@
 #define EC_MEMMAP_SIZE         255 /* ACPI IO buffer max is 255 bytes */
 #define EC_MEMMAP_TEXT_MAX     8   /* Size of a string in the memory map */
 
+/* Telemetry history (struct ec_telemetry), if EC_HOST_CMD_FLAG_TELEMETRY */
+#define EC_LPC_ADDR_TELEMETRY    0xa00
+
 /* The offset address of each type of data in mapped memory. */
 #define EC_MEMMAP_TEMP_SENSOR      0x00 /* Temp sensors */
 #define EC_MEMMAP_FAN              0x10 /* Fan speeds */
@@ -131,6 +134,10 @@
 /* Host command interface flags */
 /* Host command interface supports LPC args (LPC interface only) */
 #define EC_HOST_CMD_FLAG_LPC_ARGS_SUPPORTED  0x01
+/* Host command interface supports protocol version 3 */
+#define EC_HOST_CMD_FLAG_VERSION_3           0x02
+/* Telemetry history is mapped at EC_LPC_ADDR_TELEMETRY (LPC interface only) */
+#define EC_HOST_CMD_FLAG_TELEMETRY           0x04
 
 /* Wireless switch flags */
 #define EC_WIRELESS_SWITCH_WLAN      0x01
@@ -186,6 +193,9 @@ enum ec_status {
 	EC_RES_INVALID_RESPONSE = 5,
 	EC_RES_INVALID_VERSION = 6,
 	EC_RES_INVALID_CHECKSUM = 7,
+	EC_RES_IN_PROGRESS = 8,		/* Accepted, command in progress */
+	EC_RES_UNAVAILABLE = 9,		/* No response available */
+	EC_RES_BUSY = 10,		/* Busy; try again later */
 };
 
 /*
@@ -267,6 +277,66 @@ struct ec_lpc_host_args {
  */
 #define EC_HOST_ARGS_FLAG_TO_HOST   0x02
 
+/*
+ * Protocol version 3
+ *
+ * Commands and responses are sent as packets, each a header followed by
+ * data.  Lengths are 16 bits, so params and response may be up to 64KB (or as
+ * much as the EC can buffer), split into as many packets as needed.
+ *
+ * On LPC, the host writes the request packet at EC_LPC_ADDR_HOST_PACKET, then
+ * writes EC_COMMAND_PROTOCOL_3 to EC_LPC_ADDR_HOST_CMD.  The reply packet is
+ * at EC_LPC_ADDR_HOST_PACKET when the EC is no longer busy.  On I2C, the host
+ * writes EC_COMMAND_PROTOCOL_3 followed by the request packet, then reads
+ * sizeof(struct ec_host_response) + response_max bytes.
+ *
+ * A request whose data doesn't fit in one packet is sent as consecutive
+ * packets with increasing offset; the EC answers each packet except the last
+ * with EC_RES_SUCCESS and total_len 0.  The reply to the last packet holds the
+ * first part of the response; if total_len is more than that, the host gets
+ * the rest with EC_HOST_REQUEST_FLAG_FETCH requests, in order.
+ */
+#define EC_COMMAND_PROTOCOL_3 0xda
+
+#define EC_LPC_ADDR_HOST_PACKET  0x800  /* Packet area; overlays args/params */
+#define EC_LPC_HOST_PACKET_SIZE  0x100  /* Size of packet area in bytes */
+
+/* Largest packet in either direction on any transport */
+#define EC_HOST_PACKET_MAX 248
+
+#define EC_HOST_REQUEST_VERSION 3
+
+struct ec_host_request {
+	uint8_t struct_version;   /* EC_HOST_REQUEST_VERSION */
+	uint8_t checksum;         /* Header and data bytes sum to 0 */
+	uint8_t command;          /* Command code */
+	uint8_t command_version;  /* Command version */
+	uint8_t flags;            /* EC_HOST_REQUEST_FLAG_* */
+	uint8_t reserved;
+	uint16_t data_len;        /* Bytes of data in this packet */
+	uint16_t offset;          /* Offset of this data in the params, or of
+				   * the response data to fetch */
+	uint16_t total_len;       /* Total size of params */
+	uint16_t response_max;    /* Max response data in the reply packet */
+	uint16_t reserved2;
+} __packed;
+
+/* Request fetches the next part of the response; carries no data */
+#define EC_HOST_REQUEST_FLAG_FETCH 0x01
+
+#define EC_HOST_RESPONSE_VERSION 3
+
+struct ec_host_response {
+	uint8_t struct_version;   /* EC_HOST_RESPONSE_VERSION */
+	uint8_t checksum;         /* Header and data bytes sum to 0 */
+	uint8_t result;           /* Result code (EC_RES_*) */
+	uint8_t reserved;
+	uint16_t data_len;        /* Bytes of data in this packet */
+	uint16_t offset;          /* Offset of this data in the response */
+	uint16_t total_len;       /* Total size of response */
+	uint16_t reserved2[3];
+} __packed;
+
 /*
  * Notes on commands:
  *
@@ -388,6 +458,94 @@ struct ec_response_get_cmd_versions {
 	uint32_t version_mask;
 } __packed;
 
+/*
+ * List supported commands and their versions.  Returns the commands numbered
+ * start_cmd and up, in order, as many as fit; if more is set, the host asks
+ * again with start_cmd one past the last command returned.
+ */
+#define EC_CMD_GET_CMD_LIST 0x09
+
+struct ec_params_get_cmd_list {
+	uint8_t start_cmd;        /* First command number to return */
+} __packed;
+
+#define EC_CMD_LIST_MAX_ENTRIES 48
+
+struct ec_response_get_cmd_list {
+	uint8_t count;            /* Number of entries returned */
+	uint8_t more;             /* Non-zero if more commands follow */
+	uint8_t reserved[2];
+	struct {
+		uint8_t cmd;              /* Command number */
+		uint32_t version_mask;    /* Supported versions (EC_VER_MASK) */
+	} __packed entry[EC_CMD_LIST_MAX_ENTRIES];
+} __packed;
+
+/*
+ * Check comms status.  Commands which take a long time (such as flash erase)
+ * may return EC_RES_IN_PROGRESS and finish in the background; the host polls
+ * this until EC_COMMS_STATUS_PROCESSING is clear, then fetches the result with
+ * EC_CMD_RESEND_RESPONSE.  Until then, other commands which change flash
+ * return EC_RES_BUSY.
+ */
+#define EC_CMD_GET_COMMS_STATUS 0x0a
+
+#define EC_COMMS_STATUS_PROCESSING (1 << 0)  /* Processing a command */
+
+struct ec_response_get_comms_status {
+	uint32_t flags;           /* EC_COMMS_STATUS_* */
+} __packed;
+
+/*
+ * Resend the result and response of the last command which returned
+ * EC_RES_IN_PROGRESS.  Returns EC_RES_BUSY if it is still running, or
+ * EC_RES_UNAVAILABLE if there is no such command.
+ */
+#define EC_CMD_RESEND_RESPONSE 0x0b
+
+/*
+ * Run several small commands in one transaction.  The params are a header
+ * followed by count requests, each with its params; the response is a header
+ * followed by a response for each command run, with its response data.  Each
+ * request and response is padded to a multiple of 4 bytes.
+ *
+ * Commands run in order until all have run, or one fails and
+ * EC_BATCH_FLAG_STOP_ON_ERROR is set, or there's no room for the next
+ * command's response.  Batches can't be nested, and slow commands (which
+ * may return EC_RES_IN_PROGRESS) aren't allowed in a batch.
+ */
+#define EC_CMD_BATCH 0x0c
+
+#define EC_BATCH_FLAG_STOP_ON_ERROR (1 << 0)
+
+struct ec_params_batch {
+	uint8_t count;            /* Number of requests which follow */
+	uint8_t flags;            /* EC_BATCH_FLAG_* */
+	uint8_t reserved[2];
+} __packed;
+
+struct ec_batch_request {
+	uint8_t command;          /* Command number */
+	uint8_t version;          /* Command version */
+	uint8_t params_size;      /* Bytes of params which follow */
+	uint8_t response_max;     /* Max bytes of response expected */
+} __packed;
+
+struct ec_response_batch {
+	uint8_t count;            /* Number of responses which follow */
+	uint8_t reserved[3];
+} __packed;
+
+struct ec_batch_response {
+	uint8_t command;          /* Command number */
+	uint8_t result;           /* Result (EC_RES_*) */
+	uint8_t response_size;    /* Bytes of response which follow */
+	uint8_t reserved;
+} __packed;
+
+/* Size of a batch request or response with its data, padded */
+#define EC_BATCH_RECORD_SIZE(data_size) (4 + (((data_size) + 3) & ~3))
+
 /*****************************************************************************/
 /* Flash commands */
 
@@ -435,6 +593,9 @@ struct ec_params_flash_write {
 	/*
 	 * Data to write.  Could really use EC_PARAM_SIZE - 8, but tidiest to
 	 * use a power of 2 so writes stay aligned.
+	 *
+	 * In version 1, data is size bytes, up to the end of the params.  With
+	 * protocol version 3 that may be much larger than 64 bytes.
 	 */
 	uint8_t data[64];
 } __packed;
@@ -922,6 +1083,216 @@ struct ec_params_force_idle {
 	uint8_t enabled;
 } __packed;
 
+/*****************************************************************************/
+/* Debug and statistics commands */
+
+/*
+ * Get stack usage for a task.  The host can iterate over all the tasks by
+ * incrementing task_id from 0 until task_id >= task_count.
+ */
+#define EC_CMD_TASK_STACK_INFO 0xa0
+
+struct ec_params_task_stack_info {
+	uint8_t task_id;         /* Task to query; 0 is the idle task */
+} __packed;
+
+struct ec_response_task_stack_info {
+	uint8_t task_count;      /* Number of tasks, including the idle task */
+	uint8_t reserved[3];
+	uint32_t stack_size;     /* Stack size in bytes */
+	uint32_t stack_used;     /* Maximum stack usage since boot, in bytes */
+	char name[32];           /* Null-terminated task name */
+} __packed;
+
+/* Get idle task residency statistics, per low power state */
+#define EC_CMD_IDLE_STATS 0xa1
+
+#define EC_IDLE_STATE_COUNT 3  /* WFI, deep sleep, hibernate */
+
+struct ec_response_idle_stats {
+	uint32_t time_ms;        /* Time since the stats were reset */
+	struct {
+		uint32_t entries;      /* Times the state was entered */
+		uint32_t residency_ms; /* Total time spent in the state */
+		uint32_t max_exit_us;  /* Longest wake-up latency */
+	} state[EC_IDLE_STATE_COUNT];
+} __packed;
+
+/*
+ * Get execution time statistics for a hook.  The host can iterate over the
+ * hooks of a type by incrementing index from 0 until index >= hook_count, and
+ * over the types by incrementing type until type >= type_count.  Hooks are
+ * returned in the order they are called.
+ */
+#define EC_CMD_HOOK_STATS 0xa2
+
+struct ec_params_hook_stats {
+	uint8_t type;            /* Hook type; 0 is init */
+	uint8_t index;           /* Hook to query, in call order */
+} __packed;
+
+struct ec_response_hook_stats {
+	uint8_t type_count;      /* Number of hook types */
+	uint8_t hook_count;      /* Number of hooks of this type */
+	uint8_t reserved[2];
+	uint32_t type_last_us;   /* Duration of the last notification */
+	uint32_t routine;        /* Hook routine address */
+	uint32_t priority;       /* Hook priority */
+	uint32_t last_us;        /* Duration of the last call */
+	uint32_t max_us;         /* Longest call since boot */
+} __packed;
+
+/*
+ * Get the boot time milestone log.  Milestones are recorded from reset to
+ * task_start() and host command readiness, and are preserved across jumps
+ * between images, so after a RO->RW jump the log covers both boots.  If the
+ * log doesn't fit in the response, only the earliest entries are returned,
+ * and the rest are counted in dropped.
+ */
+#define EC_CMD_BOOT_TIME 0xa3
+
+enum ec_boot_time_milestone {
+	EC_BOOT_TIME_PRE_INIT = 0,     /* system_common_pre_init() done */
+	EC_BOOT_TIME_CLOCK_INIT,       /* clock_init() done */
+	EC_BOOT_TIME_TIMER_INIT,       /* timer_init() done; times valid */
+	EC_BOOT_TIME_UART_INIT,        /* uart_init() done */
+	EC_BOOT_TIME_KEYSCAN_INIT,     /* keyboard_scan_init() done */
+	EC_BOOT_TIME_VBOOT,            /* Signature check done, no jump */
+	EC_BOOT_TIME_HOOK_INIT,        /* HOOK_INIT chain done */
+	EC_BOOT_TIME_TASK_START,       /* Starting task scheduling */
+	EC_BOOT_TIME_HOST_CMD_READY,   /* Host command task ready */
+	EC_BOOT_TIME_SYSJUMP,          /* Jumping to another image */
+
+	EC_BOOT_TIME_MILESTONE_COUNT
+};
+
+/* Entry flags */
+#define EC_BOOT_TIME_FLAG_NO_TIME (1 << 0)  /* Before timer_init(); time_us
+					     * is not valid */
+
+#define EC_BOOT_TIME_MAX_ENTRIES 24
+
+struct ec_response_boot_time {
+	uint8_t count;           /* Number of valid entries */
+	uint8_t dropped;         /* Milestones not returned; no room */
+	uint8_t reserved[2];
+	struct {
+		uint32_t time_us;    /* Time since the last reboot */
+		uint8_t milestone;   /* enum ec_boot_time_milestone */
+		uint8_t image;       /* enum ec_current_image */
+		uint8_t flags;       /* EC_BOOT_TIME_FLAG_* */
+		uint8_t reserved;
+	} entry[EC_BOOT_TIME_MAX_ENTRIES];
+} __packed;
+
+/*
+ * Get per-command host command statistics.  Only commands which have been
+ * called are returned, from start_cmd up, as many as fit; if more is set,
+ * the host asks again with start_cmd one past the last command returned.
+ * Times are in us; the 16-bit fields saturate at 0xffff.
+ */
+#define EC_CMD_HOST_CMD_STATS 0xa4
+
+/* Clear the statistics instead of reading them */
+#define EC_HOST_CMD_STATS_FLAG_CLEAR (1 << 0)
+
+struct ec_params_host_cmd_stats {
+	uint8_t start_cmd;       /* First command number to return */
+	uint8_t flags;           /* EC_HOST_CMD_STATS_FLAG_* */
+} __packed;
+
+#define EC_HOST_CMD_STATS_MAX_ENTRIES 10
+
+struct ec_response_host_cmd_stats {
+	uint8_t count;           /* Number of entries returned */
+	uint8_t more;            /* Non-zero if more commands follow */
+	uint8_t reserved[2];
+	uint32_t unknown_calls;  /* Calls to unsupported commands */
+	struct {
+		uint8_t cmd;             /* Command number */
+		uint8_t reserved;
+		uint16_t errors;         /* Calls which failed */
+		uint32_t calls;          /* Calls since boot or clear */
+		uint32_t total_us;       /* Total time running */
+		uint32_t total_queue_us; /* Total time queued before running */
+		uint16_t min_us;         /* Shortest call */
+		uint16_t max_us;         /* Longest call */
+		uint16_t max_queue_us;   /* Longest time queued */
+		uint16_t reserved2;
+	} entry[EC_HOST_CMD_STATS_MAX_ENTRIES];
+} __packed;
+
+/*
+ * Read the console history: a copy of the console output kept by the EC,
+ * whether or not the UART could send it.  Its latest 512 bytes survive a jump
+ * between images.
+ * Bytes are numbered from 0 at the last EC reset; the host asks for bytes from
+ * cursor onwards and gets as many as fit, then asks again with cursor one past
+ * the last byte returned until it reaches head.
+ */
+#define EC_CMD_CONSOLE_READ 0xa5
+
+struct ec_params_console_read {
+	uint32_t cursor;         /* Number of the first byte wanted */
+} __packed;
+
+/*
+ * Response is followed by the bytes from start, to the end of the response.
+ * If start is after the cursor, the bytes in between were overwritten before
+ * the host read them.  If start is before the cursor, the EC has been reset
+ * since the cursor was returned and start is the oldest byte kept.
+ */
+struct ec_response_console_read {
+	uint32_t start;          /* Number of the first byte returned */
+	uint32_t head;           /* Number of the next byte to be written */
+} __packed;
+
+/*
+ * Get the telemetry history: a ring of periodic samples of the temperature,
+ * fan and battery values in the memory map, so the host can see what happened
+ * between polls.  On LPC the same struct is mapped at EC_LPC_ADDR_TELEMETRY
+ * and can be read without a command.
+ *
+ * The EC writes sample number n to sample[n % sample_count] and then sets seq
+ * to n + 1; it never waits for the host.  To read the history without a lock,
+ * read seq (s1), copy the samples, then read seq again (s2).  Samples n with
+ * s2 - sample_count < n < s1 were copied intact; the others may be torn.  Over
+ * LPC, seq is read a byte at a time, so read it until two reads match.
+ */
+#define EC_CMD_TELEMETRY 0xa7
+
+#define EC_TELEMETRY_VERSION 1
+#define EC_TELEMETRY_SAMPLES 12
+#define EC_TELEMETRY_TEMPS   4  /* First sensors at EC_MEMMAP_TEMP_SENSOR */
+#define EC_TELEMETRY_FANS    2  /* First fans at EC_MEMMAP_FAN */
+
+struct ec_telemetry_sample {
+	uint32_t time_ms;        /* EC time when sampled */
+	uint8_t temp[EC_TELEMETRY_TEMPS];   /* As EC_MEMMAP_TEMP_SENSOR */
+	uint16_t fan_rpm[EC_TELEMETRY_FANS]; /* As EC_MEMMAP_FAN */
+	uint16_t batt_volt;      /* As EC_MEMMAP_BATT_VOLT, in mV */
+	uint16_t batt_rate;      /* As EC_MEMMAP_BATT_RATE, in mA */
+	uint16_t batt_cap;       /* As EC_MEMMAP_BATT_CAP, in mAh */
+	uint8_t batt_flag;       /* As EC_MEMMAP_BATT_FLAG */
+	uint8_t reserved;
+} __packed;
+
+struct ec_telemetry {
+	uint8_t version;         /* EC_TELEMETRY_VERSION */
+	uint8_t sample_size;     /* sizeof(struct ec_telemetry_sample) */
+	uint8_t sample_count;    /* Number of slots in sample[] */
+	uint8_t reserved;
+	uint32_t seq;            /* Number of samples taken since boot */
+	struct ec_telemetry_sample sample[EC_TELEMETRY_SAMPLES];
+} __packed;
+
+/*
+ * Response to EC_CMD_TELEMETRY is struct ec_telemetry, copied while seq did
+ * not change, so samples n with seq - sample_count < n < seq are valid.  If
+ * the transport has no room for the whole history, the response only has the
+ * latest samples, with sample_count reduced to match.
+ */
+
 /*****************************************************************************/
 /* System commands */
 
@@ -49,11 +49,24 @@ enum hook_type {
 };
 
 
+struct hook_data;
+
+/* Run time state of a hook, one per DECLARE_HOOK() */
+struct hook_state {
+	/* Hook called at this hook's position, once the hooks of its type are
+	 * sorted by priority */
+	const struct hook_data *call;
+	uint32_t last_us;  /* Duration of the last call */
+	uint32_t max_us;   /* Longest call */
+};
+
 struct hook_data {
 	/* Hook processing routine; returns EC error code. */
 	int (*routine)(void);
 	/* Priority; low numbers = higher priority. */
 	int priority;
+	/* Run time state */
+	struct hook_state *state;
 };
 
 
@@ -69,8 +82,35 @@ int hook_notify(enum hook_type type, int stop_on_error);
  * HOOK_PRIO_LAST, and should be HOOK_PRIO_DEFAULT unless there's a compelling
  * reason to care about the order in which hooks are called. */
 #define DECLARE_HOOK(hooktype, routine, priority)			\
+	static struct hook_state __hook_state_##hooktype##_##routine;	\
 	const struct hook_data __hook_##hooktype##_##routine		\
 	__attribute__((section(".rodata." #hooktype)))			\
-	     = {routine, priority}
+	     = {routine, priority, &__hook_state_##hooktype##_##routine}
+
+
+struct deferred_data {
+	/* Deferred function pointer */
+	void (*routine)(void);
+};
+
+/* Maximum number of functions which may be declared with DECLARE_DEFERRED() */
+#define DEFERRABLE_MAX_COUNT 16
+
+#ifdef CONFIG_TASK_SOFTTIMER
+/* Call a deferred function from the SOFTTIMER task, <us> microseconds from
+ * now.  If the function is already pending, it is rescheduled to the new
+ * time.  If us == -1, cancels the pending call, if any.  The function must
+ * have been declared with DECLARE_DEFERRED().  May be called from interrupt
+ * context.  Returns EC_SUCCESS, or an error code if the function could not
+ * be scheduled. */
+int hook_call_deferred(void (*routine)(void), int us);
+#endif
+
+/* Register a function which may be called via hook_call_deferred().
+ * <routine> should be void routine(void). */
+#define DECLARE_DEFERRED(routine)					\
+	const struct deferred_data __deferred_##routine			\
+	__attribute__((section(".rodata.deferred")))			\
+	     = {routine}
 
 #endif  /* __CROS_EC_HOOKS_H */
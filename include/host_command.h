@@ -11,6 +11,14 @@
 #include "common.h"
 #include "ec_commands.h"
 
+/* Transports which can deliver host commands */
+enum host_cmd_transport {
+	HOST_TRANSPORT_UNKNOWN = 0,
+	HOST_TRANSPORT_LPC,
+	HOST_TRANSPORT_I2C,
+	HOST_TRANSPORT_SPI,
+};
+
 /* Args for host command handler */
 struct host_cmd_handler_args {
 	/*
@@ -21,8 +29,10 @@ struct host_cmd_handler_args {
 	void (*send_response)(struct host_cmd_handler_args *args);
 	uint8_t command;       /* Command (e.g., EC_CMD_FLASH_GET_INFO) */
 	uint8_t version;       /* Version of command (0-31) */
-	uint8_t params_size;   /* Size of input parameters in bytes */
+	uint16_t params_size;  /* Size of input parameters in bytes */
 	uint8_t i2c_old_response; /* (for I2C) send an old-style response */
+	uint8_t transport;     /* Transport which received the command
+				* (enum host_cmd_transport) */
 	const void *params; /* Input parameters */
 	/*
 	 * Pointer to output response data buffer.  On input to the handler,
@@ -36,8 +46,8 @@ struct host_cmd_handler_args {
 	 * handler changes response to point to its own larger buffer, it may
 	 * return a response_size greater than response_max.
 	 */
-	uint8_t response_max;
-	uint8_t response_size; /* Size of data pointed to by resp_ptr */
+	uint16_t response_max;
+	uint16_t response_size; /* Size of data pointed to by resp_ptr */
 
 	/*
 	 * This is the result returned by command and therefore the status to
@@ -51,6 +61,47 @@ struct host_cmd_handler_args {
 	enum ec_status result;
 };
 
+/* Protocol version 3 packet handling; one per transport */
+struct host_packet {
+	/* Args of the command being assembled or run.  Must be first. */
+	struct host_cmd_handler_args args;
+
+	/*
+	 * Set up by the transport before calling host_packet_receive().  The
+	 * reply is written to the response buffer, which may be the same as
+	 * the request buffer, then send_response() is called.  Request data
+	 * and response data must start at the same offset in their buffers.
+	 */
+	void (*send_response)(struct host_packet *pkt);
+	const void *request;   /* Request packet */
+	int request_size;      /* Bytes received */
+	void *response;        /* Buffer for the reply packet */
+	int response_max;      /* Size of reply buffer */
+	int response_size;     /* Size of reply packet; set before
+				* send_response() */
+	uint8_t transport;     /* enum host_cmd_transport */
+
+	/* Private to host_command.c */
+	uint8_t *buf;          /* Params/response too big for one packet */
+	int received;          /* Params bytes received */
+	int sent;              /* Response bytes sent */
+	int data_max;          /* Response data per reply packet */
+	int have_response;     /* Response of args.command may be fetched */
+};
+
+#ifdef CONFIG_HOST_COMMAND_STATS
+/* Statistics of a host command, one per DECLARE_HOST_COMMAND*() */
+struct host_command_stats {
+	uint32_t calls;
+	uint32_t errors;
+	uint32_t total_us;
+	uint32_t total_queue_us;
+	uint32_t min_us;
+	uint32_t max_us;
+	uint32_t max_queue_us;
+};
+#endif
+
 /* Host command */
 struct host_command {
 	/* Command code */
@@ -62,8 +113,36 @@ struct host_command {
 	int (*handler)(struct host_cmd_handler_args *args);
 	/* Mask of supported versions */
 	int version_mask;
+	/* Flags (HOST_CMD_FLAG_*) */
+	int flags;
+#ifdef CONFIG_HOST_COMMAND_STATS
+	/* Statistics */
+	struct host_command_stats *stats;
+#endif
 };
 
+/*
+ * Command may take a long time.  If there is a task to run slow commands
+ * (HCSLOW), the host is answered EC_RES_IN_PROGRESS at once and the command
+ * runs in the background, so it doesn't hold up other commands.
+ */
+#define HOST_CMD_FLAG_SLOW (1 << 0)
+
+/*
+ * Command is trivial: it runs in constant time, never blocks or prints, and
+ * only touches data which is safe to use from interrupts.  It's run straight
+ * from the transport's interrupt handler, instead of waking the host command
+ * task.
+ */
+#define HOST_CMD_FLAG_FAST (1 << 1)
+
+/*
+ * Command changes flash.  While a slow command (such as flash erase) is
+ * running in the background, it's refused with EC_RES_BUSY, since the flash
+ * controller can only do one thing at a time.
+ */
+#define HOST_CMD_FLAG_FLASH (1 << 2)
+
 /**
  * Return a pointer to the memory-mapped buffer.
  *
@@ -83,6 +162,28 @@ uint8_t *host_get_memmap(int offset);
  */
 enum ec_status host_command_process(struct host_cmd_handler_args *args);
 
+/**
+ * Respond with data which is already somewhere else, such as flash or the
+ * memory map.  Nothing is copied here; the transport copies the data straight
+ * into its response window (summing it on the way), or sends it from where it
+ * is if the response is sent in pieces.
+ *
+ * @param args		Command handler args
+ * @param data		Response data; must stay valid until sent
+ * @param size		Size of response data in bytes
+ * @return EC_RES_SUCCESS, or EC_RES_INVALID_PARAM if too big for a response
+ */
+static inline int host_response_from(struct host_cmd_handler_args *args,
+				     const void *data, int size)
+{
+	if (size < 0 || size > 0xffff)
+		return EC_RES_INVALID_PARAM;
+
+	args->response = (void *)data;
+	args->response_size = size;
+	return EC_RES_SUCCESS;
+}
+
 /**
  * Set one or more host event bits.
  *
@@ -115,13 +216,62 @@ uint32_t host_get_events(void);
 
 /**
  * Called by host interface module when a command is received.
+ *
+ * Commands are queued and processed in order by the host command task, which
+ * calls args->send_response() when done.  The args must remain valid until
+ * then.  Each transport may have only one command in flight; if the same args
+ * are received again while the earlier command is still queued, the args are
+ * not queued a second time, and an overlap is reported on the console.
  */
 void host_command_received(struct host_cmd_handler_args *args);
 
+/**
+ * Called by host interface module when a protocol version 3 packet is
+ * received.  May be called from interrupt context.
+ */
+void host_packet_receive(struct host_packet *pkt);
+
+/* Statistics storage for each command, and its initializer in the command
+ * structure */
+#ifdef CONFIG_HOST_COMMAND_STATS
+#define HOST_CMD_STATS(command)						\
+	static struct host_command_stats __host_cmd_stats_##command;
+#define HOST_CMD_STATS_PTR(command) , &__host_cmd_stats_##command
+#else
+#define HOST_CMD_STATS(command)
+#define HOST_CMD_STATS_PTR(command)
+#endif
+
 /* Register a host command handler */
 #define DECLARE_HOST_COMMAND(command, routine, version_mask)		\
+	HOST_CMD_STATS(command)						\
+	const struct host_command __host_cmd_##command			\
+	__attribute__((section(".rodata.hcmds")))			\
+	     = {command, routine, version_mask, 0			\
+		HOST_CMD_STATS_PTR(command)}
+
+/* Register a host command handler which may take a long time to run */
+#define DECLARE_HOST_COMMAND_SLOW(command, routine, version_mask)	\
+	HOST_CMD_STATS(command)						\
+	const struct host_command __host_cmd_##command			\
+	__attribute__((section(".rodata.hcmds")))			\
+	     = {command, routine, version_mask, HOST_CMD_FLAG_SLOW	\
+		HOST_CMD_STATS_PTR(command)}
+
+/* Register a host command handler which changes flash */
+#define DECLARE_HOST_COMMAND_FLASH(command, routine, version_mask)	\
+	HOST_CMD_STATS(command)						\
+	const struct host_command __host_cmd_##command			\
+	__attribute__((section(".rodata.hcmds")))			\
+	     = {command, routine, version_mask, HOST_CMD_FLAG_FLASH	\
+		HOST_CMD_STATS_PTR(command)}
+
+/* Register a trivial host command handler, which is run in interrupt context */
+#define DECLARE_HOST_COMMAND_FAST(command, routine, version_mask)	\
+	HOST_CMD_STATS(command)						\
 	const struct host_command __host_cmd_##command			\
 	__attribute__((section(".rodata.hcmds")))			\
-	     = {command, routine, version_mask}
+	     = {command, routine, version_mask, HOST_CMD_FLAG_FAST	\
+		HOST_CMD_STATS_PTR(command)}
 
 #endif  /* __CROS_EC_HOST_COMMAND_H */
@@ -52,6 +52,14 @@ void __hw_clock_event_clear(void);
 /* Returns the value of the free-running counter used as clock. */
 uint32_t __hw_clock_source_read(void);
 
+/**
+ * Sets the clock source prescaler for the current clock frequency.
+ *
+ * This is normally done through HOOK_FREQ_CHANGE; code which switches the
+ * clock without notifying the other modules calls it directly.
+ */
+void __hw_clock_source_update_prescaler(void);
+
 /**
  * Initializes the hardware timer used to provide clock services, using the
  * specified start timer value.
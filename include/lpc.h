@@ -22,6 +22,12 @@ void lpc_manual_irq(int irq_num);
  */
 uint8_t *lpc_get_memmap_range(void);
 
+/*
+ * Return a pointer to the telemetry buffer, mapped at EC_LPC_ADDR_TELEMETRY.
+ * Like the memory-mapped buffer, the host can read it at any time.
+ */
+uint8_t *lpc_get_telemetry_range(void);
+
 /* Return true if the TOH is still set */
 int lpc_keyboard_has_char(void);
 
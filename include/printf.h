@@ -64,6 +64,29 @@ int vfnprintf(int (*addchar)(void *context, int c), void *context,
 	      const char *format, va_list args);
 
 
+/**
+ * Pack the arguments for a format into words, to be printed later with
+ * vfnprintf_packed().
+ *
+ * Strings and hex dump data are copied into the words, since they may be gone
+ * by the time the format is printed.  No arguments are needed for %T; the
+ * time is passed to vfnprintf_packed() instead.
+ *
+ * Returns the number of words used, or -1 if the arguments need more than
+ * max_words.
+ */
+int printf_pack(uint32_t *words, int max_words, const char *format,
+		va_list args);
+
+
+/**
+ * Like vfnprintf(), but takes the arguments packed by printf_pack(), and
+ * prints time for %T instead of the current time.
+ */
+int vfnprintf_packed(int (*addchar)(void *context, int c), void *context,
+		     const char *format, const uint32_t *words, uint64_t time);
+
+
 /* Print formatted outut to a string */
 int snprintf(char *str, int size, const char *format, ...);
 
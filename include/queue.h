@@ -5,36 +5,139 @@
  * Queue data structure.
  */
 
+#ifndef __CROS_EC_QUEUE_H
+#define __CROS_EC_QUEUE_H
+
 #include "common.h"
+#include "util.h"
 
-/* Generic queue container.
+/* Generic queue container: a ring buffer of fixed size units.
+ *
+ * The queue needs no lock nor interrupt masking between a single producer and
+ * a single consumer (for example an interrupt routine and a task): only the
+ * producer moves tail, only the consumer moves head, and each side publishes
+ * its index after touching the data.
+ *
+ *   head: number of units removed so far
+ *   tail: number of units added so far
  *
- *   head: next to dequeqe
- *   tail: next to enqueue
+ * Both counters run freely and are masked with (buf_units - 1) to index the
+ * buffer, so buf_units must be a power of 2, and no unit is wasted.
  *
  *   Empty:
  *     head == tail
  *   Full:
- *     ((tail + 1) % buf_bytes) == head
+ *     tail - head == buf_units
  */
 struct queue {
-	int head, tail;
-	int buf_bytes;   /* size of buffer (in byte) */
-	int unit_bytes;  /* size of unit (in byte) */
+	volatile uint32_t head, tail;
+	uint32_t buf_units;   /* size of buffer (in units); power of 2 */
+	uint32_t unit_bytes;  /* size of unit (in byte) */
 	uint8_t *buf;
+	/* Producers partway through queue_mp_add_units() (top 16 bits), and
+	 * the end of the space reserved by them (bottom 16 bits of tail) */
+	volatile uint32_t mp_state;
 };
 
-/* Reset the queue to empty state. */
-void queue_reset(struct queue *queue);
+/* Discard all the units in the queue.  Consumer side. */
+void queue_reset(struct queue *q);
+
+/* Return the number of units in the queue. */
+static inline int queue_count(const struct queue *q)
+{
+	return q->tail - q->head;
+}
 
 /* Return TRUE if the queue is empty. */
-int queue_is_empty(const struct queue *q);
+static inline int queue_is_empty(const struct queue *q)
+{
+	return q->head == q->tail;
+}
+
+/* Return TRUE if the queue has space for unit_count more units. */
+static inline int queue_has_space(const struct queue *q, int unit_count)
+{
+	return q->buf_units - queue_count(q) >= unit_count;
+}
+
+/* Add unit_count units into the queue, if they all fit.  Producer side.
+ *
+ * Returns the number of units added: unit_count or 0. */
+int queue_add_units(struct queue *q, const void *src, int unit_count);
+
+/* Add unit_count units into the queue, if they all fit.  Producer side, for
+ * queues with several producers, which may be tasks or interrupt routines.
+ * The units come out together and whole, in the order their space was
+ * reserved, and interrupts are never masked.  Producers must all use this
+ * instead of the other producer side calls, and buf_units must be at most
+ * 0x8000.
+ *
+ * Each producer reserves its space and fills it.  tail only moves when the
+ * last producer partway through finishes, so a producer which is interrupted
+ * holds back the units added after its own until it is done.
+ *
+ * Returns the number of units added: unit_count or 0. */
+int queue_mp_add_units(struct queue *q, const void *src, int unit_count);
+
+/* Remove up to unit_count units from the beginning of the queue.  Consumer
+ * side.
+ *
+ * Returns the number of units removed. */
+int queue_remove_units(struct queue *q, void *dest, int unit_count);
+
+/* Remove one unit from the beginning of the queue.  Consumer side.
+ *
+ * Returns 1 if a unit was removed, 0 if the queue was empty. */
+static inline int queue_remove_unit(struct queue *q, void *dest)
+{
+	return queue_remove_units(q, dest, 1);
+}
+
+/* Zero-copy access.  queue_peek() and queue_reserve() return the number of
+ * units which can be read or written in place at *ptr, stopping at the end of
+ * the buffer; queue_commit_remove() and queue_commit_add() then consume or
+ * publish count of them. */
+
+/* Keep the compiler from moving buffer accesses across an index access.  The
+ * queue is only shared with interrupts on the same core, so no barrier
+ * instruction is needed. */
+#define queue_barrier() asm volatile("" : : : "memory")
+
+/* Get the units at the beginning of the queue.  Consumer side. */
+static inline int queue_peek(const struct queue *q, void **ptr)
+{
+	uint32_t offset = q->head & (q->buf_units - 1);
+	uint32_t count = queue_count(q);
+
+	queue_barrier();
+	*ptr = q->buf + offset * q->unit_bytes;
+	return MIN(count, q->buf_units - offset);
+}
+
+/* Remove count units previously returned by queue_peek().  Consumer side. */
+static inline void queue_commit_remove(struct queue *q, int count)
+{
+	queue_barrier();
+	q->head += count;
+}
+
+/* Get the free space at the end of the queue.  Producer side. */
+static inline int queue_reserve(const struct queue *q, void **ptr)
+{
+	uint32_t offset = q->tail & (q->buf_units - 1);
+	uint32_t space = q->buf_units - queue_count(q);
 
-/* Return TRUE if the queue has at least one unit space. */
-int queue_has_space(const struct queue *q, int unit_count);
+	queue_barrier();
+	*ptr = q->buf + offset * q->unit_bytes;
+	return MIN(space, q->buf_units - offset);
+}
 
-/* Add multiple units into queue. */
-void queue_add_units(struct queue *q, const void *src, int unit_count);
+/* Add count units written in the space returned by queue_reserve().  Producer
+ * side. */
+static inline void queue_commit_add(struct queue *q, int count)
+{
+	queue_barrier();
+	q->tail += count;
+}
 
-/* Remove one unit from the begin of the queue. */
-int queue_remove_unit(struct queue *q, void *dest);
+#endif  /* __CROS_EC_QUEUE_H */
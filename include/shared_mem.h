@@ -11,25 +11,30 @@
  * verification operation.  It is NOT intended for allocating
  * long-term buffers; those should in general be static variables
  * allocated at compile-time.  It is NOT a full-featured replacement
- * for malloc() / free(). */
+ * for malloc() / free().
+ *
+ * Several areas may be acquired at the same time, by different tasks; the
+ * console command "shmem" prints usage and fragmentation statistics. */
 
 #ifndef __CROS_EC_SHARED_MEM_H
 #define __CROS_EC_SHARED_MEM_H
 
 #include "common.h"
 
-/* Initializes the module. */
+/* Initializes the module.  Must be called after the jump data has been
+ * checked by system_common_pre_init(). */
 int shared_mem_init(void);
 
 /* Returns the maximum amount of shared memory which can be acquired,
- * in bytes. */
+ * in bytes, when nothing else is acquired. */
 int shared_mem_size(void);
 
 /* Acquires a shared memory area of the requested size in bytes.  If
  * wait != 0, will wait for the area to be available; if wait == 0,
  * will fail with EC_ERROR_BUSY if the request cannot be fulfilled
- * immediately.  On success, sets *dest_ptr to the start of the memory
- * area and returns EC_SUCCESS. */
+ * immediately.  Waiting is only possible from a task; before task_start()
+ * and in interrupt context the call never blocks.  On success, sets
+ * *dest_ptr to the start of the memory area and returns EC_SUCCESS. */
 int shared_mem_acquire(int size, int wait, char **dest_ptr);
 
 /* Releases a shared memory area previously allocated via
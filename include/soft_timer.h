@@ -0,0 +1,58 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Software timers for Chrome EC */
+
+#ifndef __CROS_EC_SOFT_TIMER_H
+#define __CROS_EC_SOFT_TIMER_H
+
+#include "common.h"
+#include "timer.h"
+#include "timer_heap.h"
+
+/*
+ * Software timer.  The storage is owned by the caller and must stay valid
+ * while the timer is running; static allocation is the usual case.  All the
+ * callbacks are run, in deadline order, from the SOFTTIMER task.
+ */
+struct soft_timer {
+	/* Next expiration time, and position in the timer queue.  First, so
+	 * the timer is found from the heap node. */
+	struct timer_heap_node node;
+	/* Callback routine; called with the data pointer below. */
+	void (*routine)(void *data);
+	/* Opaque data passed to the routine. */
+	void *data;
+	/* Period in us for a periodic timer, 0 for a one-shot timer. */
+	uint32_t period_us;
+};
+
+/**
+ * Start a software timer.
+ *
+ * If the timer is already running, it is re-armed with the new values.  May
+ * be called from interrupt context.
+ *
+ * @param timer		Timer to start; routine and data must be set
+ * @param delay_us	Delay before the first expiration
+ * @param period_us	Period of a periodic timer, or 0 for a one-shot timer
+ * @return EC_SUCCESS, or EC_ERROR_OVERFLOW if the timer queue is full.
+ */
+int soft_timer_start(struct soft_timer *timer, uint32_t delay_us,
+		     uint32_t period_us);
+
+/**
+ * Stop a software timer.  Does nothing if the timer is not running.  May be
+ * called from interrupt context, and from the timer's own callback.
+ */
+void soft_timer_stop(struct soft_timer *timer);
+
+/* Return non-zero if the timer is running. */
+static inline int soft_timer_is_running(const struct soft_timer *timer)
+{
+	return timer_heap_contains(&timer->node);
+}
+
+#endif  /* __CROS_EC_SOFT_TIMER_H */
@@ -92,7 +92,8 @@ int system_jumped_to_this_image(void);
  * <version> is the data version, so that tag data can evolve as firmware
  * is updated.  <data> points to the data to save.
  *
- * This may ONLY be called from within a HOOK_SYSJUMP handler. */
+ * This may ONLY be called from within a HOOK_SYSJUMP handler.  Returns
+ * EC_ERROR_OVERFLOW if the tags would run into shared memory. */
 int system_add_jump_tag(uint16_t tag, int version, int size, const void *data);
 
 /* Retrieve data stored by a previous image's call to
@@ -13,7 +13,8 @@
 #include "task_id.h"
 
 /* Task event bitmasks */
-#define TASK_EVENT_CUSTOM(x) (x & 0x1fffffff)
+#define TASK_EVENT_CUSTOM(x) (x & 0x0fffffff)
+#define TASK_EVENT_SHARED_MEM (1 << 28)  /* Shared memory released */
 #define TASK_EVENT_WAKE   (1 << 29)  /* task_wake() called on task */
 #define TASK_EVENT_MUTEX  (1 << 30)  /* Mutex unlocking */
 #define TASK_EVENT_TIMER  (1 << 31)  /* Timer expired.  For example,
@@ -27,6 +28,14 @@ void interrupt_disable(void);
 /* Enable CPU interrupt bit. */
 void interrupt_enable(void);
 
+/* Disable CPU interrupt bit, and return its previous state for
+ * interrupt_restore().  For code which may be called with interrupts already
+ * disabled, and must leave them that way. */
+uint32_t interrupt_disable_save(void);
+
+/* Restore the CPU interrupt bit saved by interrupt_disable_save(). */
+void interrupt_restore(uint32_t state);
+
 /* Return true if we are in interrupt context. */
 inline int in_interrupt_context(void);
 
@@ -60,6 +69,22 @@ task_id_t task_get_current(void);
  * does not correspond to a task. */
 task_id_t task_from_addr(uint32_t addr);
 
+/**
+ * Get the stack usage of a task.
+ *
+ * The stack is filled with a known pattern at init, so the high-water mark is
+ * the part of the stack which does not hold that pattern anymore.
+ *
+ * @param tskid		Task to query
+ * @param size		Destination for the stack size in bytes
+ * @param used		Destination for the maximum stack usage in bytes
+ * @return EC_SUCCESS, or EC_ERROR_INVAL if the task does not exist.
+ */
+int task_get_stack_info(task_id_t tskid, int *size, int *used);
+
+/* Return the name of a task, as listed in the TASK_LIST file. */
+const char *task_get_name(task_id_t tskid);
+
 /* Return a pointer to the bitmap of events of the task. */
 uint32_t *task_get_event_bitmap(task_id_t tsk);
 
@@ -130,10 +155,19 @@ void task_clear_pending_irq(int irq);
 struct mutex {
 	uint32_t lock;
 	uint32_t waiters;
+	/* Task owning the mutex; TASK_ID_IDLE (which never takes mutexes)
+	 * while unlocked. */
+	uint32_t owner;
+	/* Statistics: number of contended acquisitions, and longest time a
+	 * task waited for the mutex, in us. */
+	uint32_t contentions;
+	uint32_t max_wait_us;
 };
 
 /* Try to lock the mutex mtx and de-schedule the current task if mtx is already
- * locked by another task.
+ * locked by another task.  While it waits, the current task lends its priority
+ * to the owner of the mutex, so the owner cannot be held off by tasks of
+ * intermediate priority.
  *
  * Must not be used in interrupt context! */
 void mutex_lock(struct mutex *mtx);
@@ -0,0 +1,19 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Telemetry history for Chrome EC */
+
+#ifndef __CROS_EC_TELEMETRY_H
+#define __CROS_EC_TELEMETRY_H
+
+#include "common.h"
+
+/* Add a sample of the current memory-mapped temperature, fan and battery
+ * values to the telemetry history.  Call from the task which last updated the
+ * memory map, at a steady rate; the history covers EC_TELEMETRY_SAMPLES calls.
+ * Must not be called from more than one task. */
+void telemetry_sample(void);
+
+#endif  /* __CROS_EC_TELEMETRY_H */
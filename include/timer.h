@@ -53,6 +53,12 @@ void usleep(unsigned us);
 /* Get the current timestamp from the system timer. */
 timestamp_t get_time(void);
 
+/* Return the number of microseconds until the next timer interrupt, which is
+ * either the next timer deadline or the next overflow of the 32-bit hardware
+ * counter.  Returns 0 if a deadline is already due.  Must be called with
+ * interrupts disabled. */
+uint32_t timer_next_event_us(void);
+
 /* Print the current timer information using the command output channel.  This
  * may be called from interrupt level. */
 void timer_print_info(void);
@@ -0,0 +1,54 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Min-heap of timer deadlines.
+ */
+
+#ifndef __CROS_EC_TIMER_HEAP_H
+#define __CROS_EC_TIMER_HEAP_H
+
+#include "common.h"
+#include "timer.h"
+#include "util.h"
+
+/* Deadline ordered min-heap, used by the task timers and the software timers.
+ *
+ * The root is always the next timer to expire, so the caller only looks at
+ * the head of the heap instead of scanning every timer.  Insertion and
+ * removal are O(log n).  The heap does no locking; callers which share it
+ * with an interrupt routine mask interrupts around it.
+ */
+
+/* One timer in a heap; embedded in the caller's timer structure */
+struct timer_heap_node {
+	timestamp_t deadline;
+	int pos;   /* 1 + position in the heap, 0 if not in it */
+};
+
+struct timer_heap {
+	struct timer_heap_node **nodes;  /* Storage for max nodes */
+	int max;
+	int size;
+};
+
+/* Insert a node which is not in the heap.  The heap must not be full. */
+void timer_heap_insert(struct timer_heap *h, struct timer_heap_node *n);
+
+/* Remove a node which is in the heap. */
+void timer_heap_remove(struct timer_heap *h, struct timer_heap_node *n);
+
+/* Return the node with the earliest deadline, or NULL if the heap is empty. */
+static inline struct timer_heap_node *timer_heap_first(
+	const struct timer_heap *h)
+{
+	return h->size ? h->nodes[0] : NULL;
+}
+
+/* Return non-zero if the node is in a heap. */
+static inline int timer_heap_contains(const struct timer_heap_node *n)
+{
+	return n->pos != 0;
+}
+
+#endif  /* __CROS_EC_TIMER_HEAP_H */
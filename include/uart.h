@@ -48,6 +48,16 @@ int uart_printf(const char *format, ...);
  * See printf.h for valid formatting codes. */
 int uart_vprintf(const char *format, va_list args);
 
+/* Print formatted output to the UART from arguments packed by printf_pack(),
+ * with time printed for %T.
+ *
+ * See printf.h for valid formatting codes. */
+int uart_printf_packed(const char *format, const uint32_t *args,
+		       uint64_t time);
+
+/* Return the number of free bytes in the transmit buffer. */
+int uart_tx_buffer_space(void);
+
 /* Flushes output.  Blocks until UART has transmitted all output. */
 void uart_flush_output(void);
 
@@ -161,6 +171,20 @@ void uart_tx_stop(void);
 /* Returns true if the UART transmit interrupt is disabled */
 int uart_tx_stopped(void);
 
+#ifdef CONFIG_UART_TX_DMA
+/**
+ * Starts sending len bytes from src by DMA.  The data must stay untouched until
+ * uart_tx_dma_ready() returns true.
+ *
+ * When sending by DMA, the transmit interrupt fires once the transfer is done,
+ * instead of whenever there is room for a character.
+ */
+void uart_tx_dma_start(const char *src, int len);
+
+/* Returns true if the last DMA transfer is done. */
+int uart_tx_dma_ready(void);
+#endif
+
 /**
  * Helper for UART processing.
  * Read the input FIFO until empty, then fill the output FIFO until the transmit
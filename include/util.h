@@ -81,6 +81,12 @@ int strtoi(const char *nptr, char **endptr, int base);
 /* Like strncpy(), but guarantees null termination. */
 char *strzcpy(char *dest, const char *src, int len);
 
+/* Return the sum of len bytes of data, for checksums. */
+int sum_bytes(const void *data, int len);
+
+/* Like memcpy(), but returns the sum of the bytes copied. */
+int memcpy_sum(void *dest, const void *src, int len);
+
 int tolower(int c);
 
 /* 64-bit divide-and-modulo.  Does the equivalent of:
@@ -8,7 +8,9 @@
 
 test-list=hello pingpong timer_calib timer_dos timer_jump mutex thermal
 test-list+=power_button kb_deghost kb_debounce scancode typematic charging
-test-list+=flash_overwrite flash_rw_erase
+test-list+=flash_overwrite flash_rw_erase soft_timer queue_bench mem_bench
+test-list+=shared_mem host_command_queue host_packet console_log
+test-list+=uart_mp printf_bench
 #disable: powerdemo
 
 pingpong-y=pingpong.o
@@ -16,6 +18,15 @@ powerdemo-y=powerdemo.o
 timer_calib-y=timer_calib.o
 timer_dos-y=timer_dos.o
 mutex-y=mutex.o
+soft_timer-y=soft_timer.o
+queue_bench-y=queue_bench.o
+mem_bench-y=mem_bench.o
+shared_mem-y=shared_mem.o
+host_command_queue-y=host_command_queue.o
+host_packet-y=host_packet.o
+console_log-y=console_log.o
+uart_mp-y=uart_mp.o
+printf_bench-y=printf_bench.o
 flash_overwrite-y=flash.o
 flash_rw_erase-y=flash.o
 
@@ -0,0 +1,48 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Deferred console output : order, copied arguments and dropped records.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "printf.h"
+#include "task.h"
+#include "timer.h"
+#include "uart.h"
+#include "util.h"
+
+#define LINES 20
+#define BURST 200  /* more records than the ring holds */
+
+int console_log_test_task(void *data)
+{
+	char str[16];
+	timestamp_t t0, t1;
+	int i;
+
+	uart_printf("\n[Deferred console test]\n");
+
+	/* The strings are overwritten before they are printed */
+	for (i = 0; i < LINES; i++) {
+		snprintf(str, sizeof(str), "string %d", i);
+		cprintf(CC_SYSTEM, "[%T line %d: %s]\n", i, str);
+		strzcpy(str, "gone", sizeof(str));
+	}
+	cflush();
+
+	/* The log task can't run while we spin, so the ring fills up */
+	t0 = get_time();
+	for (i = 0; i < BURST; i++)
+		cprintf(CC_SYSTEM, "[%T burst %d 0x%08x]\n", i, i * 0x1111);
+	t1 = get_time();
+	uart_printf("Burst: %d us per call\n",
+		    (int)(t1.val - t0.val) / BURST);
+	cflush();
+
+	uart_printf("Test done.\n");
+	task_wait_event(-1);
+
+	return EC_SUCCESS;
+}
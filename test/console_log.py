@@ -0,0 +1,31 @@
+# Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Deferred console output test
+#
+
+def test(helper):
+      helper.wait_output("[Deferred console test]")
+
+      # in order, with the strings as they were at the time of the call
+      for i in range(20):
+          helper.wait_output("line %d: string %d]" % (i, i))
+
+      helper.wait_output("burst 0 0x00000000]")
+      dropped = int(helper.wait_output(
+              "\[(?P<n>[0-9]+) console messages dropped\]",
+              use_re=True)["n"])
+      cost = helper.wait_output("Burst: (?P<us>[0-9]+) us per call",
+                                use_re=True)["us"]
+      helper.trace("%d records dropped, %s us per call\n" % (dropped, cost))
+      helper.wait_output("Test done.")
+
+      # the drops are counted
+      helper.ec_command("deferlog")
+      total = int(helper.wait_output("Dropped: +(?P<n>[0-9]+)",
+                                     use_re=True)["n"])
+      if total != dropped:
+          helper.fail("dropped %d records but counted %d" % (dropped, total))
+
+      return True # PASS !
@@ -0,0 +1,219 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Host command queue stress test: two transports flooding commands, and a
+ * slow command which must not hold up the others.
+ */
+
+#include "atomic.h"
+#include "common.h"
+#include "host_command.h"
+#include "task.h"
+#include "timer.h"
+#include "uart.h"
+#include "util.h"
+
+#define ROUNDS 100
+
+/* Slow test command; busy-waits like a flash erase */
+#define TEST_CMD_SLOW 0xe0
+#define SLOW_CMD_US 200000
+#define SLOW_CMD_MAGIC 0x510e510e
+
+/* Echo command like hello, but queued for the task instead of run at once */
+#define TEST_CMD_ECHO 0xe1
+
+#define FLOODERS ((1 << TASK_ID_HCA) | (1 << TASK_ID_HCB))
+
+/* Simulated transport; args must be first */
+struct test_transport {
+	struct host_cmd_handler_args args;
+	uint8_t buf[EC_HOST_PARAM_SIZE];
+	task_id_t task;
+	volatile int done;
+};
+
+static struct test_transport xport[2];
+static int errors;
+static uint32_t done_mask;
+
+static int test_command_slow(struct host_cmd_handler_args *args)
+{
+	uint32_t *r = args->response;
+
+	udelay(SLOW_CMD_US);
+
+	*r = SLOW_CMD_MAGIC;
+	args->response_size = sizeof(*r);
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND_SLOW(TEST_CMD_SLOW,
+			  test_command_slow,
+			  EC_VER_MASK(0));
+
+static int test_command_echo(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_hello *p = args->params;
+	struct ec_response_hello *r = args->response;
+
+	r->out_data = p->in_data + 0x01020304;
+	args->response_size = sizeof(*r);
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(TEST_CMD_ECHO,
+		     test_command_echo,
+		     EC_VER_MASK(0));
+
+static void test_send_response(struct host_cmd_handler_args *args)
+{
+	struct test_transport *t = (struct test_transport *)args;
+
+	t->done = 1;
+	task_wake(t->task);
+}
+
+/* Send a command through a transport and wait for its response.  Returns the
+ * result; the response is left in t->buf. */
+static int send_command(struct test_transport *t, int command,
+			const void *params, int params_size)
+{
+	struct host_cmd_handler_args *args = &t->args;
+
+	memcpy(t->buf, params, params_size);
+	args->send_response = test_send_response;
+	args->command = command;
+	args->version = 0;
+	args->params = t->buf;
+	args->params_size = params_size;
+	args->response = t->buf;
+	args->response_max = sizeof(t->buf);
+	args->response_size = 0;
+	args->result = EC_RES_SUCCESS;
+
+	t->task = task_get_current();
+	t->done = 0;
+	host_command_received(args);
+	while (!t->done)
+		task_wait_event(-1);
+
+	return args->result;
+}
+
+/* Send an echo command and check its response.  Returns non-zero if error. */
+static int check_hello(struct test_transport *t, uint32_t data)
+{
+	struct ec_params_hello p;
+	const struct ec_response_hello *r =
+		(const struct ec_response_hello *)t->buf;
+
+	p.in_data = data;
+	if (send_command(t, TEST_CMD_ECHO, &p, sizeof(p)) != EC_RES_SUCCESS ||
+	    t->args.response_size != sizeof(*r) ||
+	    r->out_data != data + 0x01020304)
+		return 1;
+
+	return 0;
+}
+
+int hc_flood_task(void *data)
+{
+	int n = (int)data;
+	task_id_t me = task_get_current();
+	int i;
+
+	xport[n].args.transport = n ? HOST_TRANSPORT_SPI : HOST_TRANSPORT_I2C;
+
+	/* wait to be activated */
+	task_wait_event(0);
+
+	for (i = 0; i < ROUNDS; i++) {
+		if (check_hello(xport + n, (me << 24) | i)) {
+			uart_printf("Transport %d: bad response %d\n", n, i);
+			errors++;
+		}
+	}
+
+	atomic_or(&done_mask, 1 << me);
+	task_wake(TASK_ID_HCMAIN);
+	task_wait_event(-1);
+
+	return EC_SUCCESS;
+}
+
+int hc_main_task(void *data)
+{
+	struct ec_response_get_comms_status *status =
+		(struct ec_response_get_comms_status *)xport[1].buf;
+	struct ec_params_hello hp;
+	timestamp_t t0;
+	int us_queued, us_direct;
+	int rv, i, polls = 0;
+
+	uart_printf("\n[Host command queue test]\n");
+
+	/* --- Both transports flooding --- */
+	task_wake(TASK_ID_HCA);
+	task_wake(TASK_ID_HCB);
+	while ((done_mask & FLOODERS) != FLOODERS)
+		task_wait_event(-1);
+	uart_flush_output();
+	uart_printf("Flood done\n");
+
+	/* --- Slow command on one transport --- */
+	rv = send_command(xport + 0, TEST_CMD_SLOW, NULL, 0);
+	uart_printf("Slow start: %d\n", rv);
+	if (rv != EC_RES_IN_PROGRESS)
+		errors++;
+
+	/* A second one is refused until the first is done */
+	rv = send_command(xport + 0, TEST_CMD_SLOW, NULL, 0);
+	uart_printf("Slow again: %d\n", rv);
+	if (rv != EC_RES_BUSY)
+		errors++;
+
+	/* Fast commands keep going on the other transport */
+	t0 = get_time();
+	if (check_hello(xport + 1, 0x12345678))
+		errors++;
+	uart_printf("Fast latency: %d us\n", (int)(get_time().val - t0.val));
+
+	/* Poll for completion */
+	do {
+		usleep(10000);
+		polls++;
+		if (send_command(xport + 1, EC_CMD_GET_COMMS_STATUS, NULL, 0)
+		    != EC_RES_SUCCESS)
+			errors++;
+	} while ((status->flags & EC_COMMS_STATUS_PROCESSING) && polls < 100);
+	uart_printf("Polls: %d\n", polls);
+
+	rv = send_command(xport + 1, EC_CMD_RESEND_RESPONSE, NULL, 0);
+	uart_printf("Resend: %d 0x%08x\n", rv, *(uint32_t *)xport[1].buf);
+	if (rv != EC_RES_SUCCESS || xport[1].args.response_size != 4 ||
+	    *(uint32_t *)xport[1].buf != SLOW_CMD_MAGIC)
+		errors++;
+
+	/* --- Trivial commands run without waking the task --- */
+	hp.in_data = 0;
+	t0 = get_time();
+	for (i = 0; i < ROUNDS; i++)
+		send_command(xport + 0, TEST_CMD_ECHO, &hp, sizeof(hp));
+	us_queued = (get_time().val - t0.val) / ROUNDS;
+	t0 = get_time();
+	for (i = 0; i < ROUNDS; i++)
+		send_command(xport + 0, EC_CMD_HELLO, &hp, sizeof(hp));
+	us_direct = (get_time().val - t0.val) / ROUNDS;
+	uart_printf("Round trip: %d us queued, %d us direct\n", us_queued,
+		    us_direct);
+
+	uart_flush_output();
+	uart_printf("Errors: %d\n", errors);
+	uart_printf("Test done.\n");
+
+	task_wait_event(-1);
+
+	return EC_SUCCESS;
+}
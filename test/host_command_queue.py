@@ -0,0 +1,33 @@
+# Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Host command queue stress test
+#
+
+def test(helper):
+      helper.wait_output("[Host command queue test]")
+      helper.wait_output("Flood done")
+      helper.wait_output("Slow start: 8")
+      helper.wait_output("Slow again: 10")
+      latency = int(helper.wait_output("Fast latency: (?P<us>[0-9]+) us",
+                                       use_re=True)["us"])
+      helper.trace("Fast command latency during slow command: %d us\n" %
+                   latency)
+      # the slow command busy-waits for 200ms
+      if latency > 20000:
+          helper.fail("fast command waited for the slow one")
+      helper.wait_output("Resend: 0 0x510e510e")
+      rt = helper.wait_output("Round trip: (?P<q>[0-9]+) us queued, "
+                              "(?P<d>[0-9]+) us direct", use_re=True)
+      helper.trace("Round trip: %s us queued, %s us direct\n" %
+                   (rt["q"], rt["d"]))
+      if int(rt["d"]) > int(rt["q"]):
+          helper.fail("direct commands slower than queued ones")
+      errors = int(helper.wait_output("Errors: (?P<n>[0-9]+)",
+                                      use_re=True)["n"])
+      helper.wait_output("Test done.")
+      if errors:
+          helper.fail("%d errors" % errors)
+
+      return True # PASS !
@@ -0,0 +1,249 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Host command protocol version 3: chunked params and responses, and flash
+ * read throughput compared with the old protocol.
+ */
+
+#include "common.h"
+#include "host_command.h"
+#include "task.h"
+#include "timer.h"
+#include "uart.h"
+#include "util.h"
+
+#define READ_SIZE 0x8000
+#define READ_V3_CHUNK 0x4000
+
+/* Simulated transport; the packet must be first */
+struct test_transport {
+	struct host_packet pkt;
+	uint8_t req[EC_LPC_HOST_PACKET_SIZE];
+	uint8_t resp[EC_LPC_HOST_PACKET_SIZE];
+	task_id_t task;
+	volatile int done;
+};
+
+static struct test_transport xport;
+static struct host_cmd_handler_args old_args;
+static uint8_t old_buf[EC_OLD_PARAM_SIZE];
+static volatile int old_done;
+static int errors;
+
+static void test_send_packet(struct host_packet *pkt)
+{
+	xport.done = 1;
+	task_wake(xport.task);
+}
+
+static uint8_t checksum(const uint8_t *data, int size)
+{
+	uint8_t csum = 0;
+
+	while (size--)
+		csum += *data++;
+	return csum;
+}
+
+/* Add data to a running sum, to compare reads without keeping the data */
+static void add_sum(uint32_t *sum, const uint8_t *data, int size)
+{
+	while (size--)
+		*sum = (*sum << 1 | *sum >> 31) + *data++;
+}
+
+/*
+ * Send one request packet and wait for the reply.  Returns the result, or -1
+ * if the reply packet is bad.
+ */
+static int xfer_packet(int command, int flags, int offset, int total_len,
+		       const void *data, int data_len)
+{
+	struct ec_host_request *rq = (struct ec_host_request *)xport.req;
+	const struct ec_host_response *rs =
+		(const struct ec_host_response *)xport.resp;
+
+	rq->struct_version = EC_HOST_REQUEST_VERSION;
+	rq->checksum = 0;
+	rq->command = command;
+	rq->command_version = 0;
+	rq->flags = flags;
+	rq->reserved = 0;
+	rq->data_len = data_len;
+	rq->offset = offset;
+	rq->total_len = total_len;
+	rq->response_max = sizeof(xport.resp) - sizeof(*rs);
+	rq->reserved2 = 0;
+	memcpy(rq + 1, data, data_len);
+	rq->checksum = -checksum(xport.req, sizeof(*rq) + data_len);
+
+	xport.pkt.send_response = test_send_packet;
+	xport.pkt.request = xport.req;
+	xport.pkt.request_size = sizeof(*rq) + data_len;
+	xport.pkt.response = xport.resp;
+	xport.pkt.response_max = sizeof(xport.resp);
+	xport.pkt.response_size = 0;
+	xport.pkt.transport = HOST_TRANSPORT_UNKNOWN;
+
+	xport.task = task_get_current();
+	xport.done = 0;
+	host_packet_receive(&xport.pkt);
+	while (!xport.done)
+		task_wait_event(-1);
+
+	if (rs->struct_version != EC_HOST_RESPONSE_VERSION ||
+	    xport.pkt.response_size < sizeof(*rs) + rs->data_len ||
+	    checksum(xport.resp, sizeof(*rs) + rs->data_len))
+		return -1;
+
+	return rs->result;
+}
+
+/*
+ * Run a command with protocol version 3, fetching as many reply packets as
+ * it takes.  The response is added to sum.  Returns the result, or -1 if a
+ * reply packet is bad.
+ */
+static int command_v3(int command, const void *params, int params_size,
+		      int out_size, uint32_t *sum)
+{
+	const struct ec_host_response *rs =
+		(const struct ec_host_response *)xport.resp;
+	int got = 0;
+	int rv;
+
+	rv = xfer_packet(command, 0, 0, params_size, params, params_size);
+	while (rv == EC_RES_SUCCESS) {
+		if (rs->offset != got || rs->total_len > out_size)
+			return -1;
+		add_sum(sum, (const uint8_t *)(rs + 1), rs->data_len);
+		got += rs->data_len;
+		if (got >= rs->total_len)
+			break;
+		rv = xfer_packet(command, EC_HOST_REQUEST_FLAG_FETCH, got,
+				 0, NULL, 0);
+	}
+
+	return rv;
+}
+
+static void old_send_response(struct host_cmd_handler_args *args)
+{
+	/* Copy the response to the buffer, as the LPC transport does */
+	if (args->result == EC_RES_SUCCESS && args->response != old_buf)
+		memcpy(old_buf, args->response, args->response_size);
+
+	old_done = 1;
+	task_wake(xport.task);
+}
+
+/* Run a command with the old protocol.  Returns the result. */
+static int command_old(int command, const void *params, int params_size)
+{
+	struct host_cmd_handler_args *args = &old_args;
+
+	memcpy(old_buf, params, params_size);
+	args->send_response = old_send_response;
+	args->command = command;
+	args->version = 0;
+	args->params = old_buf;
+	args->params_size = params_size;
+	args->response = old_buf;
+	args->response_max = sizeof(old_buf);
+	args->response_size = 0;
+	args->result = EC_RES_SUCCESS;
+
+	xport.task = task_get_current();
+	old_done = 0;
+	host_command_received(args);
+	while (!old_done)
+		task_wait_event(-1);
+
+	return args->result;
+}
+
+/* Print throughput of reading READ_SIZE bytes in us microseconds */
+static void print_rate(const char *name, int us)
+{
+	int kbps = us ? (int)(READ_SIZE * 1000000ULL / 1024 / us) : 0;
+
+	uart_printf("%s: %d bytes in %d us, %d KB/s\n", name, READ_SIZE, us,
+		    kbps);
+}
+
+int host_packet_task(void *data)
+{
+	struct ec_params_flash_read p;
+	uint32_t sum_v3 = 0, sum_old = 0;
+	timestamp_t t0;
+	int us_v3, us_old;
+	int i, rv;
+
+	uart_printf("\n[Host packet test]\n");
+
+	/* --- Params split over two packets --- */
+	p.offset = 0;
+	p.size = 16;
+	rv = xfer_packet(EC_CMD_FLASH_READ, 0, 0, sizeof(p), &p, 4);
+	uart_printf("Part 1: %d\n", rv);
+	if (rv != EC_RES_SUCCESS)
+		errors++;
+	rv = xfer_packet(EC_CMD_FLASH_READ, 0, 4, sizeof(p),
+			 (uint8_t *)&p + 4, sizeof(p) - 4);
+	uart_printf("Part 2: %d\n", rv);
+	if (rv != EC_RES_SUCCESS ||
+	    ((struct ec_host_response *)xport.resp)->total_len != 16)
+		errors++;
+
+	/* A fetch out of order is refused */
+	rv = xfer_packet(EC_CMD_FLASH_READ, EC_HOST_REQUEST_FLAG_FETCH, 8, 0,
+			 NULL, 0);
+	uart_printf("Bad fetch: %d\n", rv);
+	if (rv != EC_RES_INVALID_PARAM)
+		errors++;
+
+	/* So is more params for a command which has already run */
+	rv = xfer_packet(EC_CMD_FLASH_READ, 0, sizeof(p), sizeof(p), NULL, 0);
+	uart_printf("Stale part: %d\n", rv);
+	if (rv != EC_RES_INVALID_PARAM)
+		errors++;
+
+	/* --- Flash read with protocol version 3 --- */
+	t0 = get_time();
+	for (i = 0; i < READ_SIZE; i += READ_V3_CHUNK) {
+		p.offset = i;
+		p.size = READ_V3_CHUNK;
+		if (command_v3(EC_CMD_FLASH_READ, &p, sizeof(p),
+			       READ_V3_CHUNK, &sum_v3) != EC_RES_SUCCESS)
+			errors++;
+	}
+	us_v3 = get_time().val - t0.val;
+
+	/* --- Same with the old protocol --- */
+	t0 = get_time();
+	for (i = 0; i < READ_SIZE; i += p.size) {
+		p.offset = i;
+		p.size = MIN(READ_SIZE - i, sizeof(old_buf));
+		if (command_old(EC_CMD_FLASH_READ, &p, sizeof(p)) !=
+		    EC_RES_SUCCESS)
+			errors++;
+		add_sum(&sum_old, old_buf, p.size);
+	}
+	us_old = get_time().val - t0.val;
+
+	if (sum_v3 != sum_old) {
+		uart_printf("Data mismatch\n");
+		errors++;
+	}
+
+	uart_flush_output();
+	print_rate("Protocol v3", us_v3);
+	print_rate("Protocol v2", us_old);
+	uart_printf("Errors: %d\n", errors);
+	uart_printf("Test done.\n");
+
+	task_wait_event(-1);
+
+	return EC_SUCCESS;
+}
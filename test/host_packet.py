@@ -0,0 +1,27 @@
+# Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Host command protocol version 3 chunking and flash read throughput
+#
+
+def test(helper):
+      helper.wait_output("[Host packet test]")
+      helper.wait_output("Part 1: 0")
+      helper.wait_output("Part 2: 0")
+      helper.wait_output("Bad fetch: 3")
+      helper.wait_output("Stale part: 3")
+      v3 = int(helper.wait_output("Protocol v3: [0-9]+ bytes in [0-9]+ us, "
+                                  "(?P<kbps>[0-9]+) KB/s", use_re=True)["kbps"])
+      v2 = int(helper.wait_output("Protocol v2: [0-9]+ bytes in [0-9]+ us, "
+                                  "(?P<kbps>[0-9]+) KB/s", use_re=True)["kbps"])
+      helper.trace("Flash read: v3 %d KB/s, v2 %d KB/s\n" % (v3, v2))
+      errors = int(helper.wait_output("Errors: (?P<n>[0-9]+)",
+                                      use_re=True)["n"])
+      helper.wait_output("Test done.")
+      if errors:
+          helper.fail("%d errors" % errors)
+      if v3 <= v2:
+          helper.fail("protocol v3 isn't faster")
+
+      return True # PASS !
@@ -0,0 +1,226 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * mem* functions and byte sums : randomized correctness check and throughput
+ * benchmark.
+ */
+
+#include "clock.h"
+#include "common.h"
+#include "task.h"
+#include "timer.h"
+#include "uart.h"
+#include "util.h"
+
+#define MAX_SIZE 1024
+#define BENCH_BYTES (64 * 1024)  /* bytes processed per measurement */
+#define CHECK_SIZE 256           /* area used by the correctness check */
+#define CHECK_CASES 2000
+#define NUM_OPS 6
+
+static uint8_t buf_a[MAX_SIZE + 8] __attribute__((aligned(4)));
+static uint8_t buf_b[MAX_SIZE + 8] __attribute__((aligned(4)));
+static uint8_t ref[CHECK_SIZE];
+/* Keeps the compiler from dropping memcmp() calls whose result is unused */
+static volatile int cmp_sink;
+
+/* Linear congruential pseudo random number generator */
+static uint32_t seed = 0x1badcafe;
+static uint32_t prng(void)
+{
+	seed = 22695477 * seed + 1;
+	return seed >> 8;
+}
+
+/* Byte per byte reference implementations */
+static void ref_move(uint8_t *d, const uint8_t *s, int len)
+{
+	static uint8_t tmp[CHECK_SIZE];
+	int i;
+
+	for (i = 0; i < len; i++)
+		tmp[i] = s[i];
+	for (i = 0; i < len; i++)
+		d[i] = tmp[i];
+}
+
+static int ref_sum(const uint8_t *p, int len)
+{
+	int sum = 0;
+
+	while (len--)
+		sum += *(p++);
+	return sum;
+}
+
+static int ref_cmp(const uint8_t *a, const uint8_t *b, int len)
+{
+	const char *sa = (const char *)a, *sb = (const char *)b;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		if (sa[i] != sb[i])
+			return sa[i] - sb[i];
+	}
+	return 0;
+}
+
+static void fill_random(uint8_t *p, int len)
+{
+	while (len--)
+		*(p++) = prng();
+}
+
+/* Run one randomized case; returns non-zero on mismatch. */
+static int check_one(int op)
+{
+	int len = prng() % (CHECK_SIZE / 2);
+	int src = prng() % (CHECK_SIZE - len);
+	int dst = prng() % (CHECK_SIZE - len);
+	int c = prng() & 0xff;
+	int i;
+
+	fill_random(buf_a, CHECK_SIZE);
+	fill_random(buf_b, CHECK_SIZE);
+	for (i = 0; i < CHECK_SIZE; i++)
+		ref[i] = buf_a[i];
+
+	switch (op) {
+	case 0: /* memcpy between two buffers */
+		ref_move(ref + dst, buf_b + src, len);
+		memcpy(buf_a + dst, buf_b + src, len);
+		break;
+	case 1: /* memmove within one buffer, any overlap */
+		ref_move(ref + dst, ref + src, len);
+		memmove(buf_a + dst, buf_a + src, len);
+		break;
+	case 2: /* memset */
+		for (i = 0; i < len; i++)
+			ref[dst + i] = c;
+		memset(buf_a + dst, c, len);
+		break;
+	case 4: /* memcpy_sum between two buffers */
+		ref_move(ref + dst, buf_b + src, len);
+		if (memcpy_sum(buf_a + dst, buf_b + src, len) !=
+		    ref_sum(buf_b + src, len))
+			goto fail;
+		break;
+	case 5: /* sum_bytes */
+		if (sum_bytes(buf_a + src, len) != ref_sum(buf_a + src, len))
+			goto fail;
+		return 0;
+	default: /* memcmp, equal or with one byte flipped */
+		ref_move(buf_b + dst, buf_a + src, len);
+		if (len && (c & 1))
+			buf_b[dst + c % len] ^= 1 << (c % 8);
+		if (ref_cmp(buf_a + src, buf_b + dst, len) !=
+		    memcmp(buf_a + src, buf_b + dst, len))
+			goto fail;
+		return 0;
+	}
+
+	for (i = 0; i < CHECK_SIZE; i++) {
+		if (buf_a[i] != ref[i])
+			goto fail;
+	}
+	return 0;
+
+fail:
+	uart_printf("FAIL: op %d len %d src %d dst %d\n", op, len, src, dst);
+	return 1;
+}
+
+static void bench(const char *name, int op, int size, int src_off,
+		  int dst_off)
+{
+	uint8_t *s = buf_a + src_off;
+	uint8_t *d = buf_b + dst_off;
+	int iters = BENCH_BYTES / size;
+	timestamp_t t0;
+	uint32_t us, bpc_x100;
+	int i;
+
+	/* memmove : overlapping copy towards higher addresses */
+	if (op == 1)
+		d = buf_a + 4 + dst_off;
+	memset(buf_b, 0, sizeof(buf_b));
+	/* memcmp : equal buffers, so the whole size is compared */
+	if (op == 3)
+		memset(buf_a, 0, sizeof(buf_a));
+	/* memcpy_sum : straight copy between two buffers */
+	if (op == 4)
+		d = buf_b + dst_off;
+
+	t0 = get_time();
+	for (i = 0; i < iters; i++) {
+		switch (op) {
+		case 0:
+			memcpy(d, s, size);
+			break;
+		case 1:
+			memmove(d, s, size);
+			break;
+		case 2:
+			memset(d, i, size);
+			break;
+		case 4:
+			cmp_sink = memcpy_sum(d, s, size);
+			break;
+		case 5:
+			cmp_sink = sum_bytes(s, size);
+			break;
+		default:
+			cmp_sink = memcmp(d, s, size);
+			break;
+		}
+	}
+	us = time_since32(t0);
+
+	bpc_x100 = BENCH_BYTES * 100 /
+		(us * (clock_get_freq() / 1000000) + 1);
+	uart_printf("%-8s size %4d src+%d dst+%d: %d.%02d bytes/cycle\n",
+		    name, size, src_off, dst_off, bpc_x100 / 100,
+		    bpc_x100 % 100);
+	uart_flush_output();
+}
+
+int mem_bench_task(void *data)
+{
+	static const char * const names[] = {
+		"memcpy", "memmove", "memset", "memcmp", "memcpy_sum",
+		"sum_bytes"
+	};
+	/* source / destination misalignment pairs */
+	static const int offsets[][2] = { {0, 0}, {1, 1}, {1, 0}, {3, 2} };
+	int op, size, i;
+
+	uart_printf("\n=== mem* functions ===\n");
+
+	for (i = 0; i < CHECK_CASES; i++) {
+		if (check_one(i % NUM_OPS))
+			break;
+	}
+	/* Largest sums, to check the word-wise sums don't overflow */
+	memset(buf_a, 0xff, sizeof(buf_a));
+	if (sum_bytes(buf_a, sizeof(buf_a)) != 0xff * sizeof(buf_a) ||
+	    memcpy_sum(buf_b, buf_a, sizeof(buf_a)) != 0xff * sizeof(buf_a)) {
+		uart_printf("FAIL: sum of 0xff bytes\n");
+		i = 0;
+	}
+	if (i == CHECK_CASES)
+		uart_printf("Correctness: %d cases OK\n", CHECK_CASES);
+	uart_flush_output();
+
+	for (op = 0; op < NUM_OPS; op++)
+		for (size = 16; size <= MAX_SIZE; size *= 4)
+			for (i = 0; i < ARRAY_SIZE(offsets); i++)
+				bench(names[op], op, size, offsets[i][0],
+				      offsets[i][1]);
+
+	uart_printf("Done.\n");
+	/* sleep forever */
+	task_wait_event(-1);
+
+	return EC_SUCCESS;
+}
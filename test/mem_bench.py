@@ -0,0 +1,27 @@
+# Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# mem* functions and byte sums correctness and throughput
+#
+
+FUNCS = ["memcpy", "memmove", "memset", "memcmp", "memcpy_sum", "sum_bytes"]
+OFFSETS = [(0, 0), (1, 1), (1, 0), (3, 2)]
+SIZES = [16, 64, 256, 1024]
+
+def test(helper):
+      helper.wait_output("=== mem* functions ===")
+      helper.wait_output("Correctness: (?P<n>[0-9]+) cases OK", use_re=True)
+
+      for func in FUNCS:
+          for size in SIZES:
+              for (src, dst) in OFFSETS:
+                  bpc = helper.wait_output(
+                        "%s +size +%d src\+%d dst\+%d: "
+                        "(?P<bpc>[0-9]+\.[0-9]+) bytes/cycle" %
+                        (func, size, src, dst), use_re=True)["bpc"]
+                  helper.trace("%-8s %4d bytes src+%d dst+%d: %s bytes/cycle\n"
+                               % (func, size, src, dst, bpc))
+      helper.wait_output("Done.")
+
+      return True # PASS !
@@ -12,6 +12,12 @@
 #include "timer.h"
 
 static struct mutex mtx;
+static struct mutex pi_mtx;
+
+/* How long the low priority task holds pi_mtx */
+#define PI_HOLD_US 3000
+/* How long the middle priority task hogs the CPU */
+#define PI_HOG_US 20000
 
 /* Linear congruential pseudo random number generator*/
 static uint32_t prng(uint32_t x)
@@ -63,11 +69,37 @@ int mutex_second_task(void *unused)
 	return EC_SUCCESS;
 }
 
+int mutex_low_task(void *unused)
+{
+	while (1) {
+		task_wait_event(0);
+		mutex_lock(&pi_mtx);
+		uart_printf("MTXL: holding lock\n");
+		/* keep the CPU busy while owning the mutex */
+		udelay(PI_HOLD_US);
+		mutex_unlock(&pi_mtx);
+	}
+
+	return EC_SUCCESS;
+}
+
+int mutex_middle_task(void *unused)
+{
+	while (1) {
+		task_wait_event(0);
+		/* never yield : only a higher priority task can run */
+		udelay(PI_HOG_US);
+	}
+
+	return EC_SUCCESS;
+}
+
 int mutex_main_task(void *unused)
 {
 	task_id_t id = task_get_current();
 	uint32_t rdelay = (uint32_t)0x0bad1dea;
 	uint32_t rtask = (uint32_t)0x1a4e1dea;
+	timestamp_t t0;
 	int i;
 
 	uart_printf("\n[Mutex main task %d]\n", id);
@@ -92,6 +124,20 @@ int mutex_main_task(void *unused)
 	uart_printf("MTX1: get lock\n");
 	mutex_unlock(&mtx);
 
+	/* --- Priority inversion through a middle priority task --- */
+	uart_printf("Priority inheritance :\n");
+	/* let the low priority task take the mutex */
+	task_wake(TASK_ID_MTXL);
+	task_wait_event(1000);
+	/* then start the CPU hog before blocking on the mutex */
+	task_wake(TASK_ID_MTXM);
+	t0 = get_time();
+	mutex_lock(&pi_mtx);
+	uart_printf("Priority inversion: wait %d us\n", time_since32(t0));
+	mutex_unlock(&pi_mtx);
+	uart_printf("Contentions: %d, max wait %d us\n",
+		    pi_mtx.contentions, pi_mtx.max_wait_us);
+
 	/* --- mass lock-unlocking from several tasks --- */
 	uart_printf("Massive locking/unlocking :\n");
 	for (i = 0; i < 500; i++) {
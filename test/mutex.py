@@ -5,6 +5,11 @@
 # Mutexes test
 #
 
+# Upper bound for the time the highest priority task waits for a mutex held by
+# the lowest priority task while a middle priority task hogs the CPU.  Without
+# priority inheritance, it includes the whole 20ms hog.
+PI_MAX_WAIT_US = 10000
+
 def test(helper):
       helper.wait_output("[Mutex main task")
 
@@ -17,6 +22,15 @@ def test(helper):
       helper.wait_output("MTX1: blocking...")
       helper.wait_output("MTX1: get lock")
 
+      # priority inversion
+      helper.wait_output("Priority inheritance :")
+      helper.wait_output("MTXL: holding lock")
+      wait = int(helper.wait_output("Priority inversion: wait (?P<t>[0-9]+) us",
+                                    use_re=True)["t"])
+      helper.trace("High priority task waited %d us\n" % wait)
+      if wait > PI_MAX_WAIT_US:
+          helper.fail("Priority inversion not bounded: %d us" % wait)
+
       # multiple contention
       helper.wait_output("Massive locking/unlocking :")
       #TODO check sequence
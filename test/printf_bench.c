@@ -0,0 +1,124 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * printf micro-benchmark : cycles to format typical console lines.
+ */
+
+#include "clock.h"
+#include "common.h"
+#include "printf.h"
+#include "task.h"
+#include "timer.h"
+#include "uart.h"
+#include "util.h"
+
+#define CALLS 1000  /* calls per benchmark */
+
+static char buf[128];
+
+/* Reference : decimal conversion with a 64-bit division per digit, as printf
+ * used to do for every integer. */
+static void run_legacy(void)
+{
+	uint64_t v = 3141592653U;
+	char *s = buf + sizeof(buf) - 1;
+
+	*s = '\0';
+	do {
+		*(--s) = '0' + uint64divmod(&v, 10);
+	} while (v);
+}
+
+static void run_dec(void)
+{
+	snprintf(buf, sizeof(buf), "%u", 3141592653U);
+}
+
+static void run_hex(void)
+{
+	snprintf(buf, sizeof(buf), "[hash start 0x%08x 0x%08x]\n",
+		 0x20000, 0x1e000);
+}
+
+static void run_power(void)
+{
+	snprintf(buf, sizeof(buf), "[%T x86 power state %d = %s, in 0x%04x]\n",
+		 3, "S0", 0x00ff);
+}
+
+static void run_table(void)
+{
+	snprintf(buf, sizeof(buf), "%6d  %11d  %3d %3d %3d %3d  %5d %5d",
+		 42, 1234567, 300, 310, 320, 330, 4500, 0);
+}
+
+static void run_64bit(void)
+{
+	snprintf(buf, sizeof(buf), "Vboot result=%d, elapsed time=%ld us",
+		 0, 123456789012ULL);
+}
+
+/* Check the output of the runs which don't print the time */
+static int check(void)
+{
+	static const struct {
+		void (*run)(void);
+		const char *expect;
+	} checks[] = {
+		{run_dec, "3141592653"},
+		{run_hex, "[hash start 0x00020000 0x0001e000]\n"},
+		{run_table,
+		 "    42      1234567  300 310 320 330   4500     0"},
+		{run_64bit, "Vboot result=0, elapsed time=123456789012 us"},
+	};
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(checks); i++) {
+		checks[i].run();
+		if (memcmp(buf, checks[i].expect,
+			   strlen(checks[i].expect) + 1)) {
+			uart_printf("Output mismatch: \"%s\"\n", buf);
+			return EC_ERROR_UNKNOWN;
+		}
+	}
+	return EC_SUCCESS;
+}
+
+static void bench(const char *name, void (*run)(void))
+{
+	timestamp_t t0;
+	uint32_t us;
+	int i;
+
+	t0 = get_time();
+	for (i = 0; i < CALLS; i++)
+		run();
+	us = time_since32(t0);
+
+	uart_printf("%s: %d cycles/call\n", name,
+		    us * (clock_get_freq() / 1000000) / CALLS);
+	uart_flush_output();
+}
+
+int printf_bench_task(void *data)
+{
+	uart_printf("\n=== printf benchmark ===\n");
+	uart_flush_output();
+
+	if (check() == EC_SUCCESS)
+		uart_printf("Output OK\n");
+
+	bench("legacy", run_legacy);
+	bench("dec", run_dec);
+	bench("hex", run_hex);
+	bench("power", run_power);
+	bench("table", run_table);
+	bench("64bit", run_64bit);
+
+	uart_printf("Done.\n");
+	/* sleep forever */
+	task_wait_event(-1);
+
+	return EC_SUCCESS;
+}
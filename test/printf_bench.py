@@ -0,0 +1,29 @@
+# Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# printf micro-benchmark
+#
+
+def cost(helper, name):
+      res = helper.wait_output("%s: (?P<c>[0-9]+) cycles/call" % name,
+                               use_re=True)["c"]
+      helper.trace("%s: %s cycles/call\n" % (name, res))
+      return int(res)
+
+def test(helper):
+      helper.wait_output("=== printf benchmark ===")
+      helper.wait_output("Output OK")
+      legacy = cost(helper, "legacy")
+      dec = cost(helper, "dec")
+      for name in ["hex", "power", "table", "64bit"]:
+          cost(helper, name)
+      helper.wait_output("Done.")
+
+      # a whole printf of a 10 digit number must beat converting it alone
+      # with 64-bit divisions
+      if dec >= legacy:
+          helper.fail("printf slower than legacy conversion (%d vs %d)" %
+                      (dec, legacy))
+
+      return True # PASS !
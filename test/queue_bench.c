@@ -0,0 +1,141 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Queue micro-benchmark : cost per byte moved through the queue.
+ */
+
+#include "clock.h"
+#include "common.h"
+#include "queue.h"
+#include "task.h"
+#include "timer.h"
+#include "uart.h"
+#include "util.h"
+
+#define BUF_SIZE 128            /* queue size in bytes */
+#define CHUNK    16             /* bytes added then removed per iteration */
+#define TOTAL    (64 * 1024)    /* bytes moved per benchmark */
+
+static uint8_t buf[BUF_SIZE];
+static uint8_t src[CHUNK];
+static uint8_t dst[CHUNK];
+
+static struct queue q = {
+	.buf_units  = BUF_SIZE,
+	.unit_bytes = sizeof(uint8_t),
+	.buf        = buf,
+};
+
+/* Reference : byte per byte copy with a modulo per byte, as the queue used to
+ * do.  Not static, so the compiler cannot turn the modulo into a mask. */
+struct legacy_queue {
+	int head, tail;
+	int buf_bytes;
+	uint8_t *buf;
+} legacy = {
+	.buf_bytes = BUF_SIZE,
+	.buf       = buf,
+};
+
+static void legacy_add(struct legacy_queue *l, const uint8_t *s, int count)
+{
+	for (; count; count--) {
+		l->buf[l->tail++] = *(s++);
+		l->tail %= l->buf_bytes;
+	}
+}
+
+static void legacy_remove(struct legacy_queue *l, uint8_t *d, int count)
+{
+	for (; count; count--) {
+		*(d++) = l->buf[l->head++];
+		l->head %= l->buf_bytes;
+	}
+}
+
+static void run_legacy(void)
+{
+	legacy_add(&legacy, src, CHUNK);
+	legacy_remove(&legacy, dst, CHUNK);
+}
+
+static void run_bulk(void)
+{
+	queue_add_units(&q, src, CHUNK);
+	queue_remove_units(&q, dst, CHUNK);
+}
+
+static void run_unit(void)
+{
+	int i;
+
+	for (i = 0; i < CHUNK; i++)
+		queue_add_units(&q, src + i, 1);
+	for (i = 0; i < CHUNK; i++)
+		queue_remove_unit(&q, dst + i);
+}
+
+static void run_zero_copy(void)
+{
+	uint8_t *p;
+	int done, span, i;
+
+	for (done = 0; done < CHUNK; done += span) {
+		span = MIN(queue_reserve(&q, (void **)&p), CHUNK - done);
+		for (i = 0; i < span; i++)
+			p[i] = src[done + i];
+		queue_commit_add(&q, span);
+	}
+	for (done = 0; done < CHUNK; done += span) {
+		span = MIN(queue_peek(&q, (void **)&p), CHUNK - done);
+		for (i = 0; i < span; i++)
+			dst[done + i] = p[i];
+		queue_commit_remove(&q, span);
+	}
+}
+
+static void bench(const char *name, void (*run)(void))
+{
+	timestamp_t t0;
+	uint32_t us, cycles_x100;
+	int i;
+
+	memset(dst, 0, sizeof(dst));
+	t0 = get_time();
+	for (i = 0; i < TOTAL / CHUNK; i++)
+		run();
+	us = time_since32(t0);
+
+	if (memcmp(src, dst, CHUNK)) {
+		uart_printf("%s: data mismatch\n", name);
+		return;
+	}
+
+	cycles_x100 = us * (clock_get_freq() / 1000000) / (TOTAL / 100);
+	uart_printf("%s: %d.%02d cycles/byte\n", name,
+		    cycles_x100 / 100, cycles_x100 % 100);
+	uart_flush_output();
+}
+
+int queue_bench_task(void *data)
+{
+	int i;
+
+	for (i = 0; i < CHUNK; i++)
+		src[i] = i * 7 + 1;
+
+	uart_printf("\n=== Queue benchmark ===\n");
+	uart_flush_output();
+
+	bench("legacy", run_legacy);
+	bench("bulk", run_bulk);
+	bench("unit", run_unit);
+	bench("zerocopy", run_zero_copy);
+
+	uart_printf("Done.\n");
+	/* sleep forever */
+	task_wait_event(-1);
+
+	return EC_SUCCESS;
+}
@@ -0,0 +1,27 @@
+# Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Queue micro-benchmark
+#
+
+def cost(helper, name):
+      res = helper.wait_output("%s: (?P<c>[0-9]+\.[0-9]+) cycles/byte" % name,
+                               use_re=True)["c"]
+      helper.trace("%s: %s cycles/byte\n" % (name, res))
+      return float(res)
+
+def test(helper):
+      helper.wait_output("=== Queue benchmark ===")
+      legacy = cost(helper, "legacy")
+      bulk = cost(helper, "bulk")
+      cost(helper, "unit")
+      zerocopy = cost(helper, "zerocopy")
+      helper.wait_output("Done.")
+
+      # bulk copies must beat the byte per byte modulo loop
+      if bulk >= legacy or zerocopy >= legacy:
+          helper.fail("queue slower than legacy (%.2f / %.2f vs %.2f)" %
+                      (bulk, zerocopy, legacy))
+
+      return True # PASS !
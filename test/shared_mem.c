@@ -0,0 +1,123 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tasks contending for shared memory.
+ */
+
+#include "atomic.h"
+#include "common.h"
+#include "shared_mem.h"
+#include "task.h"
+#include "timer.h"
+#include "uart.h"
+#include "util.h"
+
+#define ROUNDS 50
+
+#define WORKERS ((1 << TASK_ID_SHM1) | (1 << TASK_ID_SHM2) | \
+		 (1 << TASK_ID_SHM3))
+
+static int errors;
+static uint32_t done_mask;
+
+/* Linear congruential pseudo random number generator */
+static uint32_t prng(uint32_t x)
+{
+	return 22695477 * x + 1;
+}
+
+int shm_worker_task(void *data)
+{
+	uint32_t seed = (uint32_t)data;
+	task_id_t me = task_get_current();
+	char *p;
+	int i, j, size;
+
+	/* wait to be activated */
+	task_wait_event(0);
+
+	for (i = 0; i < ROUNDS; i++) {
+		seed = prng(seed);
+		size = 64 + (seed >> 8) % (shared_mem_size() / 4);
+		if (shared_mem_acquire(size, 1, &p) != EC_SUCCESS) {
+			uart_printf("SHM%d: acquire failed\n", me);
+			errors++;
+			continue;
+		}
+
+		/* nobody else may write into our area while we hold it */
+		memset(p, me, size);
+		usleep(100 + (seed >> 4) % 1000);
+		for (j = 0; j < size; j++) {
+			if (p[j] != me) {
+				uart_printf("SHM%d: corrupted\n", me);
+				errors++;
+				break;
+			}
+		}
+		shared_mem_release(p);
+	}
+
+	atomic_or(&done_mask, 1 << me);
+	task_wake(TASK_ID_SHMMAIN);
+	task_wait_event(-1);
+
+	return EC_SUCCESS;
+}
+
+int shm_main_task(void *data)
+{
+	char *a, *b, *all;
+	int size = shared_mem_size();
+
+	uart_printf("\n[Shared memory test]\n");
+
+	/* --- Several areas at the same time --- */
+	if (shared_mem_acquire(size / 4, 0, &a) != EC_SUCCESS ||
+	    shared_mem_acquire(size / 4, 0, &b) != EC_SUCCESS ||
+	    (a < b ? a + size / 4 > b : b + size / 4 > a)) {
+		uart_printf("Simultaneous: FAIL\n");
+		errors++;
+	} else {
+		uart_printf("Simultaneous: OK\n");
+		/* no room for the whole buffer now */
+		if (shared_mem_acquire(size, 0, &all) != EC_ERROR_BUSY)
+			errors++;
+		shared_mem_release(a);
+		shared_mem_release(b);
+	}
+
+	/* --- Blocking acquire : workers wait for the whole buffer --- */
+	if (shared_mem_acquire(size, 0, &all) != EC_SUCCESS) {
+		uart_printf("Full buffer: FAIL\n");
+		errors++;
+		all = NULL;
+	}
+	task_wake(TASK_ID_SHM1);
+	task_wake(TASK_ID_SHM2);
+	task_wake(TASK_ID_SHM3);
+	usleep(10000);
+	uart_printf("Releasing to the blocked workers\n");
+	if (all)
+		shared_mem_release(all);
+
+	/* --- Contention between the workers --- */
+	while ((done_mask & WORKERS) != WORKERS)
+		task_wait_event(-1);
+
+	/* everything must have merged back into a single block */
+	if (shared_mem_acquire(size, 0, &all) == EC_SUCCESS) {
+		uart_printf("Merged: OK\n");
+		shared_mem_release(all);
+	} else {
+		uart_printf("Merged: FAIL\n");
+		errors++;
+	}
+
+	uart_printf("Errors: %d\n", errors);
+	uart_printf("Test done.\n");
+	task_wait_event(-1);
+
+	return EC_SUCCESS;
+}
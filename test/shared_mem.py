@@ -0,0 +1,27 @@
+# Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Shared memory contention test
+#
+
+def test(helper):
+      helper.wait_output("[Shared memory test]")
+      helper.wait_output("Simultaneous: OK")
+      helper.wait_output("Releasing to the blocked workers")
+      helper.wait_output("Merged: OK")
+      errors = int(helper.wait_output("Errors: (?P<n>[0-9]+)",
+                                      use_re=True)["n"])
+      helper.wait_output("Test done.")
+      if errors:
+          helper.fail("%d errors" % errors)
+
+      # the workers blocked on the full buffer at least once
+      helper.ec_command("shmem")
+      waits = int(helper.wait_output("Waits: +(?P<n>[0-9]+)",
+                                     use_re=True)["n"])
+      helper.trace("%d waits for shared memory\n" % waits)
+      if waits < 3:
+          helper.fail("workers did not block (%d waits)" % waits)
+
+      return True # PASS !
@@ -0,0 +1,108 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tasks for software timers test.
+ */
+
+#include "common.h"
+#include "hooks.h"
+#include "soft_timer.h"
+#include "task.h"
+#include "timer.h"
+#include "uart.h"
+
+/* Number of concurrent one-shot timers */
+#define TIMER_COUNT 200
+
+/* Linear congruential pseudo random number generator */
+static uint32_t prng(uint32_t x)
+{
+	return 22695477 * x + 1;
+}
+
+/* delay between 1ms and 256ms */
+#define DELAY_US(num) (((num % 256) + 1) * 1000)
+
+static struct soft_timer timers[TIMER_COUNT];
+static struct soft_timer periodic;
+
+static timestamp_t last_deadline;
+static int expired;
+static int order_errors;
+static uint32_t max_jitter;
+static int ticks;
+static int deferred_calls;
+
+
+static void one_shot(void *data)
+{
+	struct soft_timer *t = data;
+	uint32_t jitter = get_time().val - t->node.deadline.val;
+
+	/* Callbacks must come in deadline order */
+	if (t->node.deadline.val < last_deadline.val)
+		order_errors++;
+	last_deadline = t->node.deadline;
+
+	if (jitter > max_jitter)
+		max_jitter = jitter;
+	expired++;
+}
+
+
+static void tick(void *data)
+{
+	ticks++;
+}
+
+
+static void deferred(void)
+{
+	deferred_calls++;
+}
+DECLARE_DEFERRED(deferred);
+
+
+int soft_timer_test_task(void *unused)
+{
+	uint32_t num = 0x0bad1dea;
+	int i;
+
+	uart_printf("\n[Soft timer test task]\n");
+
+	/* --- Many concurrent one-shot timers --- */
+	for (i = 0; i < TIMER_COUNT; i++) {
+		timers[i].routine = one_shot;
+		timers[i].data = timers + i;
+		if (soft_timer_start(timers + i, DELAY_US(num), 0))
+			uart_printf("Cannot start timer %d\n", i);
+		num = prng(num);
+	}
+
+	/* Stop a few of them before they expire */
+	for (i = 0; i < TIMER_COUNT; i += 20)
+		soft_timer_stop(timers + i);
+
+	/* --- Periodic timer --- */
+	periodic.routine = tick;
+	soft_timer_start(&periodic, 10000, 10000);
+
+	/* --- Deferred call, rescheduled before it runs --- */
+	hook_call_deferred(deferred, 50000);
+	hook_call_deferred(deferred, 100000);
+
+	usleep(500000);
+	soft_timer_stop(&periodic);
+
+	uart_printf("One-shot: %d/%d expired, %d order errors\n",
+		    expired, TIMER_COUNT - TIMER_COUNT / 20, order_errors);
+	uart_printf("Max jitter: %d us\n", max_jitter);
+	uart_printf("Periodic: %d ticks\n", ticks);
+	uart_printf("Deferred: %d calls\n", deferred_calls);
+	uart_printf("Test done.\n");
+
+	task_wait_event(-1);
+
+	return EC_SUCCESS;
+}
@@ -0,0 +1,33 @@
+# Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Software timers test
+#
+
+def test(helper):
+      helper.wait_output("[Soft timer test task]")
+
+      res = helper.wait_output("One-shot: (?P<n>[0-9]+)/(?P<total>[0-9]+) " +
+                               "expired, (?P<err>[0-9]+) order errors",
+                               use_re=True)
+      if res["n"] != res["total"]:
+          helper.fail("Only %s/%s timers expired" % (res["n"], res["total"]))
+      if int(res["err"]):
+          helper.fail("%s timers expired out of order" % res["err"])
+
+      jitter = int(helper.wait_output("Max jitter: (?P<us>[0-9]+) us",
+                                      use_re=True)["us"])
+      helper.trace("Max jitter %d us\n" % jitter)
+      if jitter > 5000:
+          helper.fail("Too much jitter (%d us)" % jitter)
+
+      ticks = int(helper.wait_output("Periodic: (?P<n>[0-9]+) ticks",
+                                     use_re=True)["n"])
+      if abs(ticks - 50) > 2:
+          helper.fail("Periodic timer ran %d times" % ticks)
+
+      helper.wait_output("Deferred: 1 calls")
+      helper.wait_output("Test done.")
+
+      return True # PASS !
@@ -38,4 +38,13 @@ def test(helper):
 
       helper.trace("Got %d timer IRQ\n" % len(seq))
 
+      # Report the cost of the timer interrupt routine
+      helper.ec_command("timerinfo")
+      expired = helper.wait_output("Timers expired: *(?P<n>[0-9]+)",
+                                   use_re=True)["n"]
+      cost = helper.wait_output("Per expiry: *(?P<cycles>[0-9]+) cycles",
+                                use_re=True)["cycles"]
+      helper.trace("%s timers expired, %s cycles in IRQ per expiry\n" %
+                   (expired, cost))
+
       return True # PASS !
@@ -0,0 +1,105 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Several tasks printing at once : lines must come out whole, and heavy
+ * logging must not hold off the timer interrupt.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "task.h"
+#include "timer.h"
+#include "uart.h"
+#include "util.h"
+
+#define PERIOD_US 500   /* latency sampling period */
+#define SAMPLES   400   /* samples per mode */
+
+enum mode {
+	MODE_STOP,      /* producers idle */
+	MODE_LOCKED,    /* producers print with interrupts masked */
+	MODE_RESERVE,   /* producers print with the reserve/commit buffer */
+};
+
+static const char * const mode_names[] = {"idle", "locked", "reserve"};
+
+static volatile enum mode mode;
+static volatile int lines[3];
+
+/* Linear congruential pseudo random number generator */
+static uint32_t prng(uint32_t x)
+{
+	return 22695477 * x + 1;
+}
+
+int uart_mp_producer_task(void *data)
+{
+	int id = (int)data;
+	uint32_t seed = id;
+
+	while (1) {
+		enum mode m = mode;
+
+		if (m == MODE_STOP) {
+			task_wait_event(-1);
+			continue;
+		}
+
+		if (m == MODE_LOCKED)
+			interrupt_disable();
+		uart_printf("<P%d %05d abcdefghijklmnopqrstuvwxyz>\n",
+			    id, lines[id]++);
+		if (m == MODE_LOCKED)
+			interrupt_enable();
+
+		seed = prng(seed);
+		usleep(100 + (seed >> 8) % 500);
+	}
+
+	return EC_SUCCESS;
+}
+
+/* Wake up every PERIOD_US and time how late we are */
+static void measure(enum mode m)
+{
+	timestamp_t t0, t1;
+	uint32_t late, max = 0, total = 0;
+	int i;
+
+	mode = m;
+	task_wake(TASK_ID_PRINT0);
+	task_wake(TASK_ID_PRINT1);
+	task_wake(TASK_ID_PRINT2);
+
+	for (i = 0; i < SAMPLES; i++) {
+		t0 = get_time();
+		usleep(PERIOD_US);
+		t1 = get_time();
+		late = t1.val - t0.val - PERIOD_US;
+		total += late;
+		max = MAX(max, late);
+	}
+
+	mode = MODE_STOP;
+	/* Let the producers finish their lines */
+	usleep(10000);
+	cflush();
+	uart_printf("Latency %s: max %d us, avg %d us\n", mode_names[m],
+		    max, total / SAMPLES);
+}
+
+int uart_mp_main_task(void *data)
+{
+	uart_printf("\n[UART multiple producer test]\n");
+
+	measure(MODE_STOP);
+	measure(MODE_LOCKED);
+	measure(MODE_RESERVE);
+
+	uart_printf("Lines: %d\n", lines[0] + lines[1] + lines[2]);
+	uart_printf("Test done.\n");
+	task_wait_event(-1);
+
+	return EC_SUCCESS;
+}
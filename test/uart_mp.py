@@ -0,0 +1,39 @@
+# Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# UART multiple producer test
+#
+
+import re
+
+LINE = re.compile("^\s*<P[0-9] [0-9]{5} abcdefghijklmnopqrstuvwxyz>\s*$")
+
+def test(helper):
+      helper.wait_output("[UART multiple producer test]")
+
+      # every producer line must come out whole
+      good = 0
+      mixed = 0
+      latency = {}
+      while True:
+          ln = helper.wait_output("(?P<l>.*)", use_re=True)["l"]
+          res = re.search("Latency (?P<m>[a-z]+): max (?P<max>[0-9]+) us",
+                          ln)
+          if res:
+              latency[res.group("m")] = int(res.group("max"))
+          if "<P" in ln:
+              if LINE.search(ln):
+                  good += 1
+              else:
+                  mixed += 1
+                  helper.trace("Mixed up line: %s\n" % ln)
+          if "Test done." in ln:
+              break
+
+      helper.trace("%d whole lines, %d mixed up\n" % (good, mixed))
+      helper.trace("Worst timer latency (us): %s\n" % latency)
+      if mixed:
+          helper.fail("%d lines mixed up" % mixed)
+
+      return True # PASS !
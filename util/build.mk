@@ -7,9 +7,16 @@
 #
 
 host-util-bin=ectool lbplay burn_my_ec
+# HOST_COMM=file builds the host tools with a fake transport which answers
+# from a recorded trace, for trying them out without an EC.
+ifeq ($(HOST_COMM),file)
+host-util-common=comm-file
+else
 ifeq ($(CONFIG_LPC),y)
 host-util-common=comm-lpc
 else
 host-util-common=comm-i2c
 endif
+endif
+host-util-common+=comm-packet comm-trace
 build-util-bin=ec_uartd stm32mon
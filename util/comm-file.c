@@ -0,0 +1,243 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/*
+ * Fake transport which answers commands from a recorded trace instead of an
+ * EC, so ectool and the replay engine can be tried out on any Linux box.  The
+ * trace is named by EC_FAKE_TRACE.  A command gets the response recorded for
+ * the same command, version and params, taking matching records in turn;
+ * commands which were never recorded are unsupported.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "comm-host.h"
+#include "comm-trace.h"
+
+static struct trace_entry *entries;
+static int entry_count;
+/* Index of the record last used for a command, to take matches in turn */
+static int last_used = -1;
+
+/* Protocol version 3 command being received or sent */
+static uint8_t packet_params[0x10000];
+static int packet_received;
+static const struct trace_entry *packet_entry;
+
+int comm_init(void)
+{
+	const char *path = getenv("EC_FAKE_TRACE");
+	int alloc = 0;
+	FILE *f;
+	int rv;
+
+	if (!path) {
+		fprintf(stderr, "Set EC_FAKE_TRACE to a recorded trace\n");
+		return -1;
+	}
+	f = fopen(path, "rb");
+	if (!f) {
+		perror("Error opening trace");
+		return -1;
+	}
+
+	while (1) {
+		if (entry_count == alloc) {
+			alloc = alloc ? alloc * 2 : 64;
+			entries = realloc(entries, alloc * sizeof(*entries));
+			if (!entries) {
+				rv = -1;
+				break;
+			}
+		}
+		rv = trace_read(f, entries + entry_count);
+		if (rv <= 0)
+			break;
+		entry_count++;
+	}
+	fclose(f);
+	return rv;
+}
+
+/*
+ * Find the recorded response to a command, starting after the record used
+ * last time so repeated commands step through their recorded responses.
+ * Returns NULL if the command was never recorded.
+ */
+static const struct trace_entry *find_entry(int command, int version,
+					    const void *indata, int insize)
+{
+	int i, n;
+
+	for (n = 1; n <= entry_count; n++) {
+		const struct trace_entry *e;
+
+		i = (last_used + n) % entry_count;
+		e = entries + i;
+		if (e->r.command == command &&
+		    e->r.command_version == version &&
+		    e->r.params_size == insize &&
+		    !memcmp(e->params, indata, insize)) {
+			last_used = i;
+			return e;
+		}
+	}
+	return NULL;
+}
+
+int ec_command_dev(int command, int version, const void *indata, int insize,
+		   void *outdata, int outsize)
+{
+	const struct trace_entry *e =
+		find_entry(command, version, indata, insize);
+
+	if (!e)
+		return -EC_RES_INVALID_COMMAND;
+	if (e->r.result < 0)
+		return e->r.result;
+	if (e->r.response_size > outsize) {
+		fprintf(stderr, "EC returned too much data\n");
+		return -EC_RES_INVALID_RESPONSE;
+	}
+	memcpy(outdata, e->response, e->r.response_size);
+	return e->r.response_size;
+}
+
+int ec_xfer_packet(const void *out, int out_size, void *in, int in_size)
+{
+	const struct ec_host_request *rq = out;
+	struct ec_host_response *rs = in;
+	int result = EC_RES_SUCCESS;
+	int sent = 0, len = 0;
+	uint8_t csum = 0;
+	int i;
+
+	if (out_size < sizeof(*rq) || in_size < sizeof(*rs) ||
+	    rq->offset + rq->data_len > sizeof(packet_params))
+		return -EC_RES_ERROR;
+
+	if (rq->flags & EC_HOST_REQUEST_FLAG_FETCH) {
+		if (!packet_entry)
+			result = EC_RES_INVALID_PARAM;
+		sent = rq->offset;
+	} else {
+		/* Params; the first packet starts a new command */
+		if (rq->offset == 0) {
+			packet_received = 0;
+			packet_entry = NULL;
+		}
+		memcpy(packet_params + rq->offset, rq + 1, rq->data_len);
+		packet_received += rq->data_len;
+
+		if (packet_received >= rq->total_len) {
+			packet_entry = find_entry(rq->command,
+						  rq->command_version,
+						  packet_params,
+						  rq->total_len);
+			if (!packet_entry)
+				result = EC_RES_INVALID_COMMAND;
+			else if (packet_entry->r.result < 0)
+				result = -packet_entry->r.result;
+			if (result)
+				packet_entry = NULL;
+		}
+	}
+
+	memset(rs, 0, sizeof(*rs));
+	rs->struct_version = EC_HOST_RESPONSE_VERSION;
+	rs->result = result;
+	if (packet_entry) {
+		len = MIN(packet_entry->r.response_size - sent,
+			  MIN(rq->response_max, in_size - sizeof(*rs)));
+		memcpy(rs + 1, packet_entry->response + sent, len);
+		rs->total_len = packet_entry->r.response_size;
+	}
+	rs->data_len = len;
+	rs->offset = sent;
+
+	for (i = 0; i < sizeof(*rs) + len; i++)
+		csum += ((uint8_t *)rs)[i];
+	rs->checksum = -csum;
+	return 0;
+}
+
+uint8_t read_mapped_mem8(uint8_t offset)
+{
+	struct ec_params_read_memmap p;
+	uint8_t val;
+
+	p.offset = offset;
+	p.size = sizeof(val);
+
+	if (ec_command(EC_CMD_READ_MEMMAP, 0, &p, sizeof(p),
+		       &val, sizeof(val)) < 0)
+		return 0xff;
+
+	return val;
+}
+
+uint16_t read_mapped_mem16(uint8_t offset)
+{
+	struct ec_params_read_memmap p;
+	uint16_t val;
+
+	p.offset = offset;
+	p.size = sizeof(val);
+
+	if (ec_command(EC_CMD_READ_MEMMAP, 0, &p, sizeof(p),
+		       &val, sizeof(val)) < 0)
+		return 0xffff;
+
+	return val;
+}
+
+uint32_t read_mapped_mem32(uint8_t offset)
+{
+	struct ec_params_read_memmap p;
+	uint32_t val;
+
+	p.offset = offset;
+	p.size = sizeof(val);
+
+	if (ec_command(EC_CMD_READ_MEMMAP, 0, &p, sizeof(p),
+		       &val, sizeof(val)) < 0)
+		return 0xffffffff;
+
+	return val;
+}
+
+int read_mapped_string(uint8_t offset, char *buf)
+{
+	struct ec_params_read_memmap p;
+	int c;
+
+	p.offset = offset;
+	p.size = EC_MEMMAP_TEXT_MAX;
+
+	if (ec_command(EC_CMD_READ_MEMMAP, 0, &p, sizeof(p),
+		       buf, EC_MEMMAP_TEXT_MAX) < 0) {
+		*buf = 0;
+		return -1;
+	}
+
+	for (c = 0; c < EC_MEMMAP_TEXT_MAX; c++) {
+		if (buf[c] == 0)
+			return c;
+	}
+
+	buf[EC_MEMMAP_TEXT_MAX - 1] = 0;
+	return EC_MEMMAP_TEXT_MAX - 1;
+}
+
+int read_telemetry(struct ec_telemetry *t)
+{
+	int rv = ec_command(EC_CMD_TELEMETRY, 0, NULL, 0, t, sizeof(*t));
+
+	return rv < 0 ? rv : 0;
+}
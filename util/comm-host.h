@@ -17,11 +17,41 @@ int comm_init(void);
 /*
  * Send a command to the EC.  Returns the length of output data returned (0 if
  * none), or a negative number if error; errors are -EC_RES_* constants from
- * ec_commands.h.
+ * ec_commands.h.  Recorded if trace_record_start() was called.
  */
 int ec_command(int command, int version, const void *indata, int insize,
 	       void *outdata, int outsize);
 
+/*
+ * Send a command to the EC using protocol version 3, which allows params and
+ * response of up to 64KB; they are split into as many packets as needed.
+ * Returns the same as ec_command(), or -EC_RES_INVALID_VERSION if the EC
+ * doesn't support protocol version 3.  Recorded like ec_command().
+ */
+int ec_command_v3(int command, int version, const void *indata, int insize,
+		  void *outdata, int outsize);
+
+/*
+ * Send a command to the EC, without recording it.  Implemented by each
+ * transport; ec_command() wraps it.
+ */
+int ec_command_dev(int command, int version, const void *indata, int insize,
+		   void *outdata, int outsize);
+
+/*
+ * Send a command to the EC using protocol version 3, without recording it.
+ * ec_command_v3() wraps it.
+ */
+int ec_command_packet(int command, int version, const void *indata,
+		      int insize, void *outdata, int outsize);
+
+/*
+ * Send a protocol version 3 request packet, and read in_size bytes of reply
+ * packet (less, if the transport can tell the reply is shorter).  Implemented
+ * by each transport.  Returns 0 if success, or a negative number if error.
+ */
+int ec_xfer_packet(const void *out, int out_size, void *in, int in_size);
+
 /*
  * Return the content of the EC information area mapped as "memory".
  * The offsets are defined by the EC_MEMMAP_ constants.
@@ -36,4 +66,12 @@ uint32_t read_mapped_mem32(uint8_t offset);
  */
 int read_mapped_string(uint8_t offset, char *buf);
 
+/*
+ * Read the telemetry history into t, directly from the mapped window if the
+ * EC has one and otherwise with EC_CMD_TELEMETRY.  The copy is made while
+ * t->seq did not change, so samples n with t->seq - t->sample_count < n <
+ * t->seq are valid.  Returns 0 if success, or a negative number if error.
+ */
+int read_telemetry(struct ec_telemetry *t);
+
 #endif /* COMM_HOST_H */
@@ -75,8 +75,8 @@ int comm_init(void)
 
 /* Sends a command to the EC.  Returns the command status code, or
  * -1 if other error. */
-int ec_command(int command, int version, const void *indata, int insize,
-	       void *outdata, int outsize)
+int ec_command_dev(int command, int version, const void *indata, int insize,
+		   void *outdata, int outsize)
 {
 	struct i2c_rdwr_ioctl_data data;
 	int ret = -1;
@@ -191,6 +191,63 @@ done:
 	return ret;
 }
 
+int ec_xfer_packet(const void *out, int out_size, void *in, int in_size)
+{
+	static int packet_supported = -1;
+	struct ec_response_proto_version r;
+	struct i2c_rdwr_ioctl_data data;
+	struct i2c_msg i2c_msg[2];
+	uint8_t req_buf[EC_HOST_PACKET_MAX + 1];
+	int ret;
+
+	/* Older ECs don't know protocol version 3; ask once */
+	if (packet_supported < 0) {
+		packet_supported =
+			ec_command(EC_CMD_PROTO_VERSION, 0, NULL, 0,
+				   &r, sizeof(r)) >= 0 && r.version >= 3;
+	}
+	if (!packet_supported)
+		return -EC_RES_INVALID_VERSION;
+
+	if (out_size > EC_HOST_PACKET_MAX || in_size > EC_HOST_PACKET_MAX) {
+		fprintf(stderr, "Packet size too big\n");
+		return -EC_RES_ERROR;
+	}
+
+	if (i2c_fd < 0)
+		return -EC_RES_ERROR;
+
+	if (ioctl(i2c_fd, I2C_SLAVE, EC_I2C_ADDR) < 0) {
+		fprintf(stderr, "Cannot set I2C slave address\n");
+		return -EC_RES_ERROR;
+	}
+
+	/* Command byte, then the request packet */
+	req_buf[0] = EC_COMMAND_PROTOCOL_3;
+	memcpy(req_buf + 1, out, out_size);
+
+	/* The EC pads the reply to the size we read */
+	i2c_msg[0].addr = EC_I2C_ADDR;
+	i2c_msg[0].flags = 0;
+	i2c_msg[0].len = out_size + 1;
+	i2c_msg[0].buf = (char *)req_buf;
+	i2c_msg[1].addr = EC_I2C_ADDR;
+	i2c_msg[1].flags = I2C_M_RD;
+	i2c_msg[1].len = in_size;
+	i2c_msg[1].buf = in;
+	data.msgs = i2c_msg;
+	data.nmsgs = 2;
+
+	ret = ioctl(i2c_fd, I2C_RDWR, &data);
+	if (ret < 0) {
+		fprintf(stderr, "i2c transfer failed: %d (err: %d)\n",
+			ret, errno);
+		return -EC_RES_ERROR;
+	}
+
+	return 0;
+}
+
 uint8_t read_mapped_mem8(uint8_t offset)
 {
 	struct ec_params_read_memmap p;
@@ -258,3 +315,10 @@ int read_mapped_string(uint8_t offset, char *buf)
 	buf[EC_MEMMAP_TEXT_MAX - 1] = 0;
 	return EC_MEMMAP_TEXT_MAX - 1;
 }
+
+int read_telemetry(struct ec_telemetry *t)
+{
+	int rv = ec_command(EC_CMD_TELEMETRY, 0, NULL, 0, t, sizeof(*t));
+
+	return rv < 0 ? rv : 0;
+}
@@ -3,6 +3,7 @@
  * found in the LICENSE file.
  */
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <sys/io.h>
@@ -14,7 +15,11 @@
 #define INITIAL_UDELAY 5     /* 5 us */
 #define MAXIMUM_UDELAY 10000 /* 10 ms */
 
+/* Tries at reading the telemetry window between two EC samples */
+#define TELEMETRY_READ_TRIES 4
+
 static int lpc_cmd_args_supported;
+static int lpc_packet_supported;
 
 int comm_init(void)
 {
@@ -64,6 +69,12 @@ int comm_init(void)
 	     EC_HOST_CMD_FLAG_LPC_ARGS_SUPPORTED))
 		lpc_cmd_args_supported = 1;
 
+	/* Same for protocol version 3 */
+	if (lpc_cmd_args_supported &&
+	    (inb(EC_LPC_ADDR_MEMMAP + EC_MEMMAP_HOST_CMD_FLAGS) &
+	     EC_HOST_CMD_FLAG_VERSION_3))
+		lpc_packet_supported = 1;
+
 	return 0;
 }
 
@@ -132,7 +143,10 @@ static int ec_command_old(int command, const void *indata, int insize,
 	/* Check result */
 	i = inb(EC_LPC_ADDR_HOST_DATA);
 	if (i) {
-		fprintf(stderr, "EC returned error result code %d\n", i);
+		/* In-progress isn't an error; the caller polls for it */
+		if (i != EC_RES_IN_PROGRESS)
+			fprintf(stderr,
+				"EC returned error result code %d\n", i);
 		return -i;
 	}
 
@@ -148,8 +162,8 @@ static int ec_command_old(int command, const void *indata, int insize,
 	return outsize;
 }
 
-int ec_command(int command, int version, const void *indata, int insize,
-	       void *outdata, int outsize) {
+int ec_command_dev(int command, int version, const void *indata, int insize,
+		   void *outdata, int outsize) {
 
 	struct ec_lpc_host_args args;
 	const uint8_t *d;
@@ -191,7 +205,10 @@ int ec_command(int command, int version, const void *indata, int insize,
 	/* Check result */
 	i = inb(EC_LPC_ADDR_HOST_DATA);
 	if (i) {
-		fprintf(stderr, "EC returned error result code %d\n", i);
+		/* In-progress isn't an error; the caller polls for it */
+		if (i != EC_RES_IN_PROGRESS)
+			fprintf(stderr,
+				"EC returned error result code %d\n", i);
 		return -i;
 	}
 
@@ -235,6 +252,48 @@ int ec_command(int command, int version, const void *indata, int insize,
 }
 
 
+int ec_xfer_packet(const void *out, int out_size, void *in, int in_size)
+{
+	const struct ec_host_response *rs = in;
+	const uint8_t *d;
+	uint8_t *dout;
+	int i;
+
+	if (!lpc_packet_supported)
+		return -EC_RES_INVALID_VERSION;
+
+	if (out_size > EC_LPC_HOST_PACKET_SIZE ||
+	    in_size > EC_LPC_HOST_PACKET_SIZE || in_size < sizeof(*rs)) {
+		fprintf(stderr, "Packet size too big\n");
+		return -EC_RES_ERROR;
+	}
+
+	if (wait_for_ec(EC_LPC_ADDR_HOST_CMD, 1000000)) {
+		fprintf(stderr, "Timeout waiting for EC ready\n");
+		return -EC_RES_ERROR;
+	}
+
+	/* Write the request packet */
+	for (i = 0, d = out; i < out_size; i++, d++)
+		outb(*d, EC_LPC_ADDR_HOST_PACKET + i);
+
+	outb(EC_COMMAND_PROTOCOL_3, EC_LPC_ADDR_HOST_CMD);
+
+	if (wait_for_ec(EC_LPC_ADDR_HOST_CMD, 1000000)) {
+		fprintf(stderr, "Timeout waiting for EC response\n");
+		return -EC_RES_ERROR;
+	}
+
+	/* Read the reply header, then only as much data as it says */
+	for (i = 0, dout = in; i < sizeof(*rs); i++, dout++)
+		*dout = inb(EC_LPC_ADDR_HOST_PACKET + i);
+	in_size = MIN(in_size, sizeof(*rs) + rs->data_len);
+	for (; i < in_size; i++, dout++)
+		*dout = inb(EC_LPC_ADDR_HOST_PACKET + i);
+
+	return 0;
+}
+
 uint8_t read_mapped_mem8(uint8_t offset)
 {
 	return inb(EC_LPC_ADDR_MEMMAP + offset);
@@ -263,3 +322,47 @@ int read_mapped_string(uint8_t offset, char *buf)
 	buf[EC_MEMMAP_TEXT_MAX - 1] = 0;
 	return EC_MEMMAP_TEXT_MAX - 1;
 }
+
+/*
+ * Read the telemetry sequence number.  It takes several LPC cycles, so the
+ * EC may change it part way; read it until two reads match.
+ */
+static uint32_t read_telemetry_seq(void)
+{
+	int addr = EC_LPC_ADDR_TELEMETRY + offsetof(struct ec_telemetry, seq);
+	uint32_t seq, prev = inl(addr);
+
+	while ((seq = inl(addr)) != prev)
+		prev = seq;
+	return seq;
+}
+
+int read_telemetry(struct ec_telemetry *t)
+{
+	uint8_t *d = (uint8_t *)t;
+	int tries, i;
+
+	if (!(inb(EC_LPC_ADDR_MEMMAP + EC_MEMMAP_HOST_CMD_FLAGS) &
+	      EC_HOST_CMD_FLAG_TELEMETRY)) {
+		int rv = ec_command(EC_CMD_TELEMETRY, 0, NULL, 0,
+				    t, sizeof(*t));
+		return rv < 0 ? rv : 0;
+	}
+
+	/*
+	 * The EC writes a sample before it bumps seq, so if seq is the same
+	 * before and after the copy, only the slot for the next sample can be
+	 * torn, and that one is not valid yet.
+	 */
+	for (tries = 0; tries < TELEMETRY_READ_TRIES; tries++) {
+		uint32_t seq = read_telemetry_seq();
+
+		for (i = 0; i < sizeof(*t); i++)
+			d[i] = inb(EC_LPC_ADDR_TELEMETRY + i);
+		if (read_telemetry_seq() == seq) {
+			t->seq = seq;
+			return 0;
+		}
+	}
+	return -EC_RES_BUSY;
+}
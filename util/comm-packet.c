@@ -0,0 +1,127 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Host command protocol version 3, common to all transports */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "comm-host.h"
+
+/* Largest data in a request / response packet */
+#define REQUEST_DATA_MAX (EC_HOST_PACKET_MAX - sizeof(struct ec_host_request))
+#define RESPONSE_DATA_MAX (EC_HOST_PACKET_MAX - \
+			   sizeof(struct ec_host_response))
+
+/*
+ * Send a request packet with the given data and read the reply.  Returns 0 if
+ * success, or a negative number if error.
+ */
+static int xfer_request(struct ec_host_request *rq, const void *data,
+			struct ec_host_response *rs)
+{
+	const uint8_t *d;
+	uint8_t csum = 0;
+	int i, rv;
+
+	rq->struct_version = EC_HOST_REQUEST_VERSION;
+	rq->checksum = 0;
+	rq->reserved = 0;
+	rq->response_max = RESPONSE_DATA_MAX;
+	rq->reserved2 = 0;
+	if (rq->data_len)
+		memcpy(rq + 1, data, rq->data_len);
+
+	for (i = 0, d = (const uint8_t *)rq; i < sizeof(*rq) + rq->data_len;
+	     i++, d++)
+		csum += *d;
+	rq->checksum = -csum;
+
+	rv = ec_xfer_packet(rq, sizeof(*rq) + rq->data_len,
+			    rs, sizeof(*rs) + RESPONSE_DATA_MAX);
+	if (rv < 0)
+		return rv;
+
+	/* Check the reply */
+	if (rs->struct_version != EC_HOST_RESPONSE_VERSION ||
+	    rs->data_len > RESPONSE_DATA_MAX) {
+		fprintf(stderr, "EC returned bad packet header\n");
+		return -EC_RES_INVALID_RESPONSE;
+	}
+	for (i = 0, csum = 0, d = (const uint8_t *)rs;
+	     i < sizeof(*rs) + rs->data_len; i++, d++)
+		csum += *d;
+	if (csum) {
+		fprintf(stderr, "EC response has invalid checksum\n");
+		return -EC_RES_INVALID_CHECKSUM;
+	}
+	if (rs->result) {
+		/* In-progress isn't an error; the caller polls for it */
+		if (rs->result != EC_RES_IN_PROGRESS)
+			fprintf(stderr, "EC returned error result code %d\n",
+				rs->result);
+		return -rs->result;
+	}
+
+	return 0;
+}
+
+int ec_command_packet(int command, int version, const void *indata,
+		      int insize, void *outdata, int outsize)
+{
+	uint8_t req_buf[EC_HOST_PACKET_MAX], resp_buf[EC_HOST_PACKET_MAX];
+	struct ec_host_request *rq = (struct ec_host_request *)req_buf;
+	struct ec_host_response *rs = (struct ec_host_response *)resp_buf;
+	int sent = 0, got = 0;
+	int rv;
+
+	if (insize > 0xffff) {
+		fprintf(stderr, "Data size too big\n");
+		return -EC_RES_ERROR;
+	}
+
+	rq->command = command;
+	rq->command_version = version;
+	rq->total_len = insize;
+
+	/* Send the params, as many packets as it takes */
+	do {
+		rq->flags = 0;
+		rq->offset = sent;
+		rq->data_len = MIN(insize - sent, REQUEST_DATA_MAX);
+		rv = xfer_request(rq, (const uint8_t *)indata + sent, rs);
+		if (rv < 0)
+			return rv;
+		sent += rq->data_len;
+	} while (sent < insize);
+
+	if (rs->total_len > outsize) {
+		fprintf(stderr, "EC returned too much data\n");
+		return -EC_RES_INVALID_RESPONSE;
+	}
+
+	/* Get the response, fetching the rest if it didn't fit */
+	while (1) {
+		if (rs->offset != got || got + rs->data_len > rs->total_len) {
+			fprintf(stderr, "EC returned bad response offset\n");
+			return -EC_RES_INVALID_RESPONSE;
+		}
+		memcpy((uint8_t *)outdata + got, rs + 1, rs->data_len);
+		got += rs->data_len;
+		if (got >= rs->total_len || !rs->data_len)
+			break;
+
+		rq->flags = EC_HOST_REQUEST_FLAG_FETCH;
+		rq->offset = got;
+		rq->data_len = 0;
+		rv = xfer_request(rq, NULL, rs);
+		if (rv < 0)
+			return rv;
+	}
+
+	return got;
+}
@@ -0,0 +1,376 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Host command traces, common to all transports */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "comm-host.h"
+#include "comm-trace.h"
+
+/* Largest params or response in a sane record; protocol 3 allows 64KB */
+#define TRACE_DATA_MAX 0x10000
+
+/* Trace file being recorded to, or -1 if not recording */
+static int trace_fd = -1;
+
+/* Latency of one replayed command */
+struct replay_latency {
+	int command;
+	uint32_t us;
+};
+
+static uint64_t now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/* Append a record of one command to the trace file */
+static void trace_write(int flags, int command, int version,
+			const void *indata, int insize,
+			const void *outdata, int outsize, int result,
+			uint64_t start_us)
+{
+	struct trace_record r;
+	uint8_t *buf;
+	int size;
+
+	r.magic = TRACE_MAGIC;
+	r.version = TRACE_VERSION;
+	r.flags = flags;
+	r.command_version = version;
+	r.time_us = start_us;
+	r.duration_us = now_us() - start_us;
+	r.command = command;
+	r.reserved = 0;
+	r.result = result;
+	r.params_size = insize;
+	r.response_max = outsize;
+	r.response_size = result > 0 ? MIN(result, outsize) : 0;
+
+	size = sizeof(r) + r.params_size + r.response_size;
+	buf = malloc(size);
+	if (!buf)
+		return;
+	memcpy(buf, &r, sizeof(r));
+	if (r.params_size)
+		memcpy(buf + sizeof(r), indata, r.params_size);
+	if (r.response_size)
+		memcpy(buf + sizeof(r) + r.params_size, outdata,
+		       r.response_size);
+
+	/* One write per record, so records from other processes don't mix */
+	if (write(trace_fd, buf, size) != size) {
+		perror("Error writing trace");
+		close(trace_fd);
+		trace_fd = -1;
+	}
+	free(buf);
+}
+
+int ec_command(int command, int version, const void *indata, int insize,
+	       void *outdata, int outsize)
+{
+	uint64_t start;
+	int rv;
+
+	if (trace_fd < 0)
+		return ec_command_dev(command, version, indata, insize,
+				      outdata, outsize);
+
+	start = now_us();
+	rv = ec_command_dev(command, version, indata, insize,
+			    outdata, outsize);
+	trace_write(0, command, version, indata, insize, outdata, outsize,
+		    rv, start);
+	return rv;
+}
+
+int ec_command_v3(int command, int version, const void *indata, int insize,
+		  void *outdata, int outsize)
+{
+	uint64_t start;
+	int rv;
+
+	if (trace_fd < 0)
+		return ec_command_packet(command, version, indata, insize,
+					 outdata, outsize);
+
+	start = now_us();
+	rv = ec_command_packet(command, version, indata, insize,
+			       outdata, outsize);
+	trace_write(TRACE_FLAG_V3, command, version, indata, insize,
+		    outdata, outsize, rv, start);
+	return rv;
+}
+
+int trace_record_start(const char *path)
+{
+	trace_fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if (trace_fd < 0) {
+		perror("Error opening trace");
+		return -1;
+	}
+	return 0;
+}
+
+int trace_read(FILE *f, struct trace_entry *e)
+{
+	struct trace_record *r = &e->r;
+	int got = fread(r, 1, sizeof(*r), f);
+
+	e->params = e->response = NULL;
+	if (got == 0)
+		return 0;
+	if (got != sizeof(*r) || r->magic != TRACE_MAGIC ||
+	    r->version != TRACE_VERSION ||
+	    r->params_size > TRACE_DATA_MAX ||
+	    r->response_size > TRACE_DATA_MAX ||
+	    r->response_size > r->response_max) {
+		fprintf(stderr, "Bad trace record\n");
+		return -1;
+	}
+
+	/* Allocate at least a byte, so a pointer means the data is there */
+	e->params = malloc(r->params_size + 1);
+	e->response = malloc(r->response_size + 1);
+	if (!e->params || !e->response) {
+		trace_free_entry(e);
+		return -1;
+	}
+	if (fread(e->params, 1, r->params_size, f) != r->params_size ||
+	    fread(e->response, 1, r->response_size, f) != r->response_size) {
+		fprintf(stderr, "Trace record is truncated\n");
+		trace_free_entry(e);
+		return -1;
+	}
+	return 1;
+}
+
+void trace_free_entry(struct trace_entry *e)
+{
+	free(e->params);
+	free(e->response);
+	e->params = e->response = NULL;
+}
+
+/* Read a whole trace into memory.  Returns the number of entries, or -1 if
+ * error; the entries are put in *entries. */
+static int trace_load(const char *path, struct trace_entry **entries)
+{
+	struct trace_entry *e = NULL;
+	int count = 0, alloc = 0;
+	FILE *f;
+	int rv;
+
+	f = fopen(path, "rb");
+	if (!f) {
+		perror("Error opening trace");
+		return -1;
+	}
+
+	while (1) {
+		if (count == alloc) {
+			struct trace_entry *n;
+
+			alloc = alloc ? alloc * 2 : 64;
+			n = realloc(e, alloc * sizeof(*e));
+			if (!n) {
+				rv = -1;
+				break;
+			}
+			e = n;
+		}
+		rv = trace_read(f, e + count);
+		if (rv <= 0)
+			break;
+		count++;
+	}
+	fclose(f);
+
+	if (rv < 0) {
+		while (count--)
+			trace_free_entry(e + count);
+		free(e);
+		return -1;
+	}
+	*entries = e;
+	return count;
+}
+
+static int compare_latency(const void *a, const void *b)
+{
+	const struct replay_latency *la = a, *lb = b;
+
+	return la->us < lb->us ? -1 : la->us > lb->us;
+}
+
+static int compare_command_latency(const void *a, const void *b)
+{
+	const struct replay_latency *la = a, *lb = b;
+
+	if (la->command != lb->command)
+		return la->command - lb->command;
+	return compare_latency(a, b);
+}
+
+static int compare_time(const void *a, const void *b)
+{
+	const struct trace_entry *ea = a, *eb = b;
+
+	return ea->r.time_us < eb->r.time_us ? -1 :
+		ea->r.time_us > eb->r.time_us;
+}
+
+/* Return non-zero if the command changes flash or reboots the EC, so it is
+ * only replayed with TRACE_REPLAY_DESTRUCTIVE. */
+static int is_destructive(int command)
+{
+	switch (command) {
+	case EC_CMD_FLASH_WRITE:
+	case EC_CMD_FLASH_ERASE:
+	case EC_CMD_FLASH_PROTECT:
+	case EC_CMD_REBOOT:
+	case EC_CMD_REBOOT_EC:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/* Print latency percentiles for count commands, sorted by latency */
+static void print_percentiles(const char *name,
+			      const struct replay_latency *l, int count)
+{
+	printf("%-6s  %6d  %8u  %8u  %8u  %8u\n", name, count,
+	       l[(count - 1) * 50 / 100].us, l[(count - 1) * 90 / 100].us,
+	       l[(count - 1) * 99 / 100].us, l[count - 1].us);
+}
+
+int trace_replay(const char *path, int flags)
+{
+	struct trace_entry *entries;
+	struct replay_latency *lat;
+	uint8_t *out;
+	uint64_t start, bytes = 0;
+	int count, errors = 0, changed = 0, skipped = 0;
+	int out_max = 0, total_us;
+	int i, j, n = 0;
+
+	count = trace_load(path, &entries);
+	if (count < 0)
+		return -1;
+	if (!count) {
+		fprintf(stderr, "Trace is empty\n");
+		free(entries);
+		return -1;
+	}
+
+	/* Traces are appended to, so put the commands back in time order */
+	qsort(entries, count, sizeof(*entries), compare_time);
+
+	for (i = 0; i < count; i++)
+		out_max = MAX(out_max, entries[i].r.response_max);
+	lat = malloc(count * sizeof(*lat));
+	out = malloc(out_max + 1);
+	if (!lat || !out) {
+		free(lat);
+		free(out);
+		for (i = 0; i < count; i++)
+			trace_free_entry(entries + i);
+		free(entries);
+		return -1;
+	}
+
+	start = now_us();
+	for (i = 0; i < count; i++) {
+		const struct trace_record *r = &entries[i].r;
+		uint64_t t0;
+		int rv;
+
+		if (!(flags & TRACE_REPLAY_DESTRUCTIVE) &&
+		    is_destructive(r->command)) {
+			skipped++;
+			continue;
+		}
+
+		if (flags & TRACE_REPLAY_PACED) {
+			uint64_t due = start +
+				(r->time_us - entries[0].r.time_us);
+
+			t0 = now_us();
+			if (due > t0)
+				usleep(due - t0);
+		}
+
+		t0 = now_us();
+		if (r->flags & TRACE_FLAG_V3)
+			rv = ec_command_packet(r->command, r->command_version,
+					       entries[i].params,
+					       r->params_size,
+					       out, r->response_max);
+		else
+			rv = ec_command_dev(r->command, r->command_version,
+					    entries[i].params, r->params_size,
+					    out, r->response_max);
+		lat[n].command = r->command;
+		lat[n].us = now_us() - t0;
+		n++;
+
+		if (rv < 0)
+			errors++;
+		else
+			bytes += r->params_size + rv;
+		if (rv != r->result ||
+		    (rv > 0 && memcmp(out, entries[i].response,
+				      r->response_size)))
+			changed++;
+	}
+	total_us = now_us() - start;
+
+	printf("Replayed %d commands in %d ms", n, total_us / 1000);
+	if (total_us)
+		printf(": %d cmd/s, %d KB/s",
+		       (int)((uint64_t)n * 1000000 / total_us),
+		       (int)(bytes * 1000000 / 1024 / total_us));
+	printf("\n");
+	printf("Errors: %d, different from trace: %d\n", errors, changed);
+	if (skipped)
+		printf("Skipped %d flash changes and reboots\n", skipped);
+
+	if (n) {
+		printf("\nLatency (us)\n");
+		printf("Cmd      Count       p50       p90"
+		       "       p99       max\n");
+		qsort(lat, n, sizeof(*lat), compare_latency);
+		print_percentiles("all", lat, n);
+		qsort(lat, n, sizeof(*lat), compare_command_latency);
+	}
+	for (i = 0; i < n; i = j) {
+		char name[8];
+
+		for (j = i; j < n && lat[j].command == lat[i].command; j++)
+			;
+		snprintf(name, sizeof(name), "0x%02x", lat[i].command);
+		print_percentiles(name, lat + i, j - i);
+	}
+
+	free(lat);
+	free(out);
+	for (i = 0; i < count; i++)
+		trace_free_entry(entries + i);
+	free(entries);
+	return 0;
+}
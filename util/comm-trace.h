@@ -0,0 +1,78 @@
+/* Copyright (c) 2012 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Host command traces: recording commands sent to the EC, and replaying them */
+
+#ifndef COMM_TRACE_H
+#define COMM_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * A trace file is a sequence of records, each a struct trace_record followed
+ * by params_size bytes of params and response_size bytes of response.  Each
+ * record is appended with a single write, so several processes can record to
+ * the same file.
+ */
+#define TRACE_MAGIC   0x52544345  /* "ECTR" */
+#define TRACE_VERSION 1
+
+/* Sent with ec_command_v3() instead of ec_command() */
+#define TRACE_FLAG_V3 (1 << 0)
+
+struct trace_record {
+	uint32_t magic;           /* TRACE_MAGIC */
+	uint16_t version;         /* TRACE_VERSION */
+	uint8_t flags;            /* TRACE_FLAG_* */
+	uint8_t command_version;
+	uint64_t time_us;         /* Wall clock time the command was sent */
+	uint32_t duration_us;     /* Time until ec_command() returned */
+	uint16_t command;
+	uint16_t reserved;
+	int32_t result;           /* Return value of ec_command() */
+	uint32_t params_size;
+	uint32_t response_max;    /* Size of the response buffer */
+	uint32_t response_size;   /* Bytes of response in the record */
+};
+
+/* A record read back from a trace file */
+struct trace_entry {
+	struct trace_record r;
+	uint8_t *params;
+	uint8_t *response;
+};
+
+/*
+ * Read the next record from a trace file into e.  Returns 1 if a record was
+ * read, 0 at the end of the file, or a negative number if the file is bad.
+ * Free the record data with trace_free_entry().
+ */
+int trace_read(FILE *f, struct trace_entry *e);
+void trace_free_entry(struct trace_entry *e);
+
+/*
+ * Record every command sent with ec_command() and ec_command_v3() to the
+ * trace file at path, appending if it already exists.  Returns 0 if success,
+ * or a negative number if error.
+ */
+int trace_record_start(const char *path);
+
+/* Flags for trace_replay() */
+/* Send each command at its original time after the first, instead of as fast
+ * as possible */
+#define TRACE_REPLAY_PACED       (1 << 0)
+/* Also send the commands which write or erase flash, or reboot the EC */
+#define TRACE_REPLAY_DESTRUCTIVE (1 << 1)
+
+/*
+ * Send the commands in the trace file at path to the EC again, in time order,
+ * and print the throughput and latency percentiles, overall and for each
+ * command.  Flags are TRACE_REPLAY_*.  Returns 0 if success, or a negative
+ * number if error.
+ */
+int trace_replay(const char *path, int flags);
+
+#endif /* COMM_TRACE_H */
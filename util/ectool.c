@@ -4,15 +4,21 @@
  */
 
 #include <ctype.h>
+#include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/io.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
 #include <unistd.h>
 
 #include "battery.h"
 #include "comm-host.h"
+#include "comm-trace.h"
 #include "lightbar.h"
 #include "vboot.h"
 
@@ -29,14 +35,25 @@ const char help_str[] =
 	"      Turn on automatic fan speed control.\n"
 	"  backlight <enabled>\n"
 	"      Enable/disable LCD backlight\n"
+	"  batch <cmd>[.<ver>][:<params>][/<size>] ...\n"
+	"      Runs several commands in one transaction; params are hex bytes\n"
+	"  batchbench [count]\n"
+	"      Times single commands against batched commands\n"
 	"  battery\n"
 	"      Prints battery info\n"
+	"  boottime\n"
+	"      Prints EC boot time milestones\n"
 	"  chargeforceidle\n"
 	"      Force charge state machine to stop in idle mode\n"
 	"  chipinfo\n"
 	"      Prints chip info\n"
+	"  cmdlist\n"
+	"      Lists all commands supported by the EC, with their versions\n"
 	"  cmdversions <cmd>\n"
 	"      Prints supported version mask for a command number\n"
+	"  console [follow]\n"
+	"      Prints the EC console history; with follow, keeps printing\n"
+	"      new output\n"
 	"  echash [CMDS]\n"
 	"      Various EC hash commands\n"
 	"  eventclear <mask>\n"
@@ -75,12 +92,18 @@ const char help_str[] =
 	"      Get the value of GPIO signal\n"
 	"  gpioset <GPIO name>\n"
 	"      Set the value of GPIO signal\n"
-	"  hello\n"
-	"      Checks for basic communication with EC\n"
+	"  hcstats [clear]\n"
+	"      Prints or clears host command call counts and times\n"
+	"  hello [count]\n"
+	"      Checks for basic communication with EC; count times round trip\n"
+	"  hookstats\n"
+	"      Prints hook execution times\n"
 	"  kbpress\n"
 	"      Simulate key press\n"
 	"  i2cread\n"
 	"      Read I2C bus\n"
+	"  idlestats\n"
+	"      Prints idle task residency per low power state\n"
 	"  i2cwrite\n"
 	"      Write I2C bus\n"
 	"  lightbar [CMDS]\n"
@@ -103,10 +126,22 @@ const char help_str[] =
 	"      Reads a pattern from the EC via LPC\n"
 	"  reboot_ec <RO|A|disable-jump> [at-shutdown]\n"
 	"      Reboot EC to RO or RW\n"
+	"  replay <tracefile> [paced] [destructive]\n"
+	"      Sends the commands in a trace again and prints their latency.\n"
+	"      Flash changes and reboots are skipped unless destructive.\n"
+	"  session [<socket>]\n"
+	"      Runs commands, one per line, from stdin or from clients of a\n"
+	"      Unix socket, over one EC connection.  Each command's output\n"
+	"      ends with \"=> <result>\".  \"watch <ms> <command>\" repeats a\n"
+	"      command until the next line comes in.\n"
 	"  sertest\n"
 	"      Serial output test for COM2\n"
+	"  stackinfo\n"
+	"      Prints stack usage of the EC tasks\n"
 	"  switches\n"
 	"      Prints current EC switch positions\n"
+	"  telemetry\n"
+	"      Prints the telemetry history\n"
 	"  temps <sensorid>\n"
 	"      Print temperature.\n"
 	"  tempsinfo <sensorid>\n"
@@ -200,6 +235,17 @@ static char *read_file(const char *filename, int *size)
 }
 
 
+/* Return microseconds elapsed since start */
+static int elapsed_us(const struct timeval *start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) * 1000000 +
+		(now.tv_usec - start->tv_usec);
+}
+
+
 int is_string_printable(const char *buf)
 {
 	while (*buf) {
@@ -223,6 +269,8 @@ void print_help(const char *prog)
 {
 	printf("Usage: %s <command> [params]\n\n", prog);
 	puts(help_str);
+	printf("Set ECTOOL_TRACE=<tracefile> to record the commands sent to "
+	       "the EC.\n");
 }
 
 
@@ -230,24 +278,279 @@ int cmd_hello(int argc, char *argv[])
 {
 	struct ec_params_hello p;
 	struct ec_response_hello r;
-	int rv;
+	struct timeval start;
+	int count = 1;
+	int min_us = 0, max_us = 0, total_us = 0;
+	int rv, i, us;
+	char *e;
+
+	if (argc > 1) {
+		count = strtol(argv[1], &e, 0);
+		if ((e && *e) || count <= 0) {
+			fprintf(stderr, "Bad count.\n");
+			return -1;
+		}
+	}
 
-	p.in_data = 0xa0b0c0d0;
+	/* Loop to measure round trip latency */
+	for (i = 0; i < count; i++) {
+		p.in_data = 0xa0b0c0d0 + i;
+
+		gettimeofday(&start, NULL);
+		rv = ec_command(EC_CMD_HELLO, 0, &p, sizeof(p),
+				&r, sizeof(r));
+		us = elapsed_us(&start);
+		if (rv < 0)
+			return rv;
+
+		if (r.out_data != 0xa1b2c3d4 + i) {
+			fprintf(stderr,
+				"Expected response 0x%08x, got 0x%08x\n",
+				0xa1b2c3d4 + i, r.out_data);
+			return -1;
+		}
+
+		if (!i || us < min_us)
+			min_us = us;
+		if (us > max_us)
+			max_us = us;
+		total_us += us;
+	}
+
+	printf("EC says hello!\n");
+	if (count > 1)
+		printf("%d round trips: min %d us, avg %d us, max %d us\n",
+		       count, min_us, total_us / count, max_us);
+	return 0;
+}
+
+/* Default response size reserved for each command in a batch */
+#define BATCH_RESPONSE_MAX 32
+
+
+/*
+ * Parse a batch request "<cmd>[.<ver>][:<params>][/<size>]" into buf.
+ * Returns the size of the request record, or -1 if error.
+ */
+static int parse_batch_request(const char *s, uint8_t *buf, int max)
+{
+	struct ec_batch_request *req = (struct ec_batch_request *)buf;
+	uint8_t *params = (uint8_t *)(req + 1);
+	char *e;
+	long v;
+	int n = 0;
+
+	req->command = v = strtol(s, &e, 0);
+	if (e == s || v < 0 || v > 0xff)
+		return -1;
+	req->version = 0;
+	req->response_max = BATCH_RESPONSE_MAX;
+
+	if (*e == '.') {
+		req->version = v = strtol(e + 1, &e, 0);
+		if (v < 0 || v > 0xff)
+			return -1;
+	}
+	if (*e == ':') {
+		for (e++; isxdigit(e[0]) && isxdigit(e[1]); e += 2, n++) {
+			char hex[3] = {e[0], e[1], 0};
+
+			if (sizeof(*req) + n >= max)
+				return -1;
+			params[n] = strtol(hex, NULL, 16);
+		}
+	}
+	if (*e == '/') {
+		req->response_max = v = strtol(e + 1, &e, 0);
+		if (v < 0 || v > 0xff)
+			return -1;
+	}
+	if (*e || n > 0xff || EC_BATCH_RECORD_SIZE(n) > max)
+		return -1;
+
+	req->params_size = n;
+	memset(params + n, 0, EC_BATCH_RECORD_SIZE(n) - sizeof(*req) - n);
+	return EC_BATCH_RECORD_SIZE(n);
+}
 
-	rv = ec_command(EC_CMD_HELLO, 0, &p, sizeof(p), &r, sizeof(r));
+
+int cmd_batch(int argc, char *argv[])
+{
+	uint8_t pbuf[EC_HOST_PARAM_SIZE], rbuf[EC_HOST_PARAM_SIZE];
+	struct ec_params_batch *p = (struct ec_params_batch *)pbuf;
+	struct ec_response_batch *r = (struct ec_response_batch *)rbuf;
+	int in = sizeof(*p), out = sizeof(*r);
+	int rv, i, j, size;
+
+	if (argc < 2 || argc - 1 > 0xff) {
+		fprintf(stderr,
+			"Usage: %s <cmd>[.<ver>][:<params>][/<size>] ...\n",
+			argv[0]);
+		return -1;
+	}
+
+	memset(p, 0, sizeof(*p));
+	p->count = argc - 1;
+	for (i = 1; i < argc; i++) {
+		size = parse_batch_request(argv[i], pbuf + in,
+					   sizeof(pbuf) - in);
+		if (size < 0) {
+			fprintf(stderr, "Bad request: %s\n", argv[i]);
+			return -1;
+		}
+		in += size;
+	}
+
+	rv = ec_command(EC_CMD_BATCH, 0, pbuf, in, rbuf, sizeof(rbuf));
 	if (rv < 0)
 		return rv;
 
-	if (r.out_data != 0xa1b2c3d4) {
-		fprintf(stderr, "Expected response 0x%08x, got 0x%08x\n",
-			0xa1b2c3d4, r.out_data);
-		return -1;
+	for (i = 0; i < r->count; i++) {
+		struct ec_batch_response *resp =
+			(struct ec_batch_response *)(rbuf + out);
+
+		if (out + sizeof(*resp) > rv ||
+		    out + EC_BATCH_RECORD_SIZE(resp->response_size) > rv) {
+			fprintf(stderr, "Bad batch response.\n");
+			return -1;
+		}
+
+		printf("Command 0x%02x result %d", resp->command, resp->result);
+		for (j = 0; j < resp->response_size; j++)
+			printf("%s%02x", j ? " " : ": ",
+			       ((uint8_t *)(resp + 1))[j]);
+		printf("\n");
+
+		out += EC_BATCH_RECORD_SIZE(resp->response_size);
 	}
+	if (r->count < argc - 1)
+		printf("%d commands not run.\n", argc - 1 - r->count);
+
+	return 0;
+}
+
+
+int cmd_batch_bench(int argc, char *argv[])
+{
+	/* As many hello commands as fit in one batch */
+	const int per_batch = (EC_HOST_PARAM_SIZE - sizeof(
+		struct ec_params_batch)) / EC_BATCH_RECORD_SIZE(
+		sizeof(struct ec_params_hello));
+	uint8_t pbuf[EC_HOST_PARAM_SIZE], rbuf[EC_HOST_PARAM_SIZE];
+	struct ec_params_batch *p = (struct ec_params_batch *)pbuf;
+	struct ec_response_batch *r = (struct ec_response_batch *)rbuf;
+	struct ec_params_hello hp;
+	struct ec_response_hello hr;
+	struct timeval start;
+	int count = 100;
+	int us_single, us_batch;
+	int rv, i, j, n;
+	char *e;
+
+	if (argc > 1) {
+		count = strtol(argv[1], &e, 0);
+		if ((e && *e) || count <= 0) {
+			fprintf(stderr, "Bad count.\n");
+			return -1;
+		}
+	}
+
+	/* One at a time */
+	gettimeofday(&start, NULL);
+	for (i = 0; i < count; i++) {
+		hp.in_data = i;
+		rv = ec_command(EC_CMD_HELLO, 0, &hp, sizeof(hp),
+				&hr, sizeof(hr));
+		if (rv < 0)
+			return rv;
+		if (hr.out_data != i + 0x01020304) {
+			fprintf(stderr, "Bad hello response.\n");
+			return -1;
+		}
+	}
+	us_single = elapsed_us(&start);
+
+	/* Same commands, batched */
+	gettimeofday(&start, NULL);
+	for (i = 0; i < count; i += n) {
+		uint8_t *rec = pbuf + sizeof(*p);
+
+		n = MIN(count - i, per_batch);
+		memset(p, 0, sizeof(*p));
+		p->count = n;
+		for (j = 0; j < n; j++) {
+			struct ec_batch_request *req =
+				(struct ec_batch_request *)rec;
+
+			req->command = EC_CMD_HELLO;
+			req->version = 0;
+			req->params_size = sizeof(hp);
+			req->response_max = sizeof(hr);
+			hp.in_data = i + j;
+			memcpy(req + 1, &hp, sizeof(hp));
+			rec += EC_BATCH_RECORD_SIZE(sizeof(hp));
+		}
+
+		rv = ec_command(EC_CMD_BATCH, 0, pbuf, rec - pbuf,
+				rbuf, sizeof(rbuf));
+		if (rv < 0)
+			return rv;
+
+		rec = rbuf + sizeof(*r);
+		for (j = 0; j < n; j++) {
+			struct ec_batch_response *resp =
+				(struct ec_batch_response *)rec;
+
+			memcpy(&hr, resp + 1, sizeof(hr));
+			if (j >= r->count || resp->result ||
+			    resp->response_size != sizeof(hr) ||
+			    hr.out_data != i + j + 0x01020304) {
+				fprintf(stderr, "Bad batch response.\n");
+				return -1;
+			}
+			rec += EC_BATCH_RECORD_SIZE(sizeof(hr));
+		}
+	}
+	us_batch = elapsed_us(&start);
+
+	printf("%d single commands:  %d us (%d us each)\n",
+	       count, us_single, us_single / count);
+	printf("%d batched commands: %d us (%d us each, %d per batch)\n",
+	       count, us_batch, us_batch / count, per_batch);
+	return 0;
+}
+
+
+int cmd_cmdlist(int argc, char *argv[])
+{
+	struct ec_params_get_cmd_list p;
+	struct ec_response_get_cmd_list r;
+	int rv, i;
+
+	p.start_cmd = 0;
+	do {
+		rv = ec_command(EC_CMD_GET_CMD_LIST, 0, &p, sizeof(p),
+				&r, sizeof(r));
+		if (rv < 0)
+			return rv;
+		if (r.count > EC_CMD_LIST_MAX_ENTRIES) {
+			fprintf(stderr, "Bad command count.\n");
+			return -1;
+		}
+
+		for (i = 0; i < r.count; i++)
+			printf("Command 0x%02x supports version mask 0x%08x\n",
+			       r.entry[i].cmd, r.entry[i].version_mask);
+
+		if (!r.count)
+			break;
+		p.start_cmd = r.entry[r.count - 1].cmd + 1;
+	} while (r.more && p.start_cmd);
 
-	printf("EC says hello!\n");
 	return 0;
 }
 
+
 int cmd_cmdversions(int argc, char *argv[])
 {
 	struct ec_params_get_cmd_versions p;
@@ -378,6 +681,31 @@ int cmd_read_test(int argc, char *argv[])
 }
 
 
+int cmd_replay(int argc, char *argv[])
+{
+	int flags = 0;
+	int i;
+
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <tracefile> [paced] [destructive]\n",
+			argv[0]);
+		return -1;
+	}
+	for (i = 2; i < argc; i++) {
+		if (!strcasecmp(argv[i], "paced"))
+			flags |= TRACE_REPLAY_PACED;
+		else if (!strcasecmp(argv[i], "destructive"))
+			flags |= TRACE_REPLAY_DESTRUCTIVE;
+		else {
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			return -1;
+		}
+	}
+
+	return trace_replay(argv[1], flags);
+}
+
+
 int cmd_reboot_ec(int argc, char *argv[])
 {
 	struct ec_params_reboot_ec p;
@@ -443,11 +771,17 @@ int cmd_flash_info(int argc, char *argv[])
 }
 
 
+/* Chunk sizes for flash reads / writes with protocol version 3 */
+#define FLASH_READ_V3_CHUNK 0x4000
+#define FLASH_WRITE_V3_CHUNK 0x400
+
+
 int cmd_flash_read(int argc, char *argv[])
 {
 	struct ec_params_flash_read p;
-	uint8_t rdata[EC_OLD_PARAM_SIZE];
-	int offset, size;
+	struct timeval start;
+	int use_v3 = 1;
+	int offset, size, chunk;
 	int rv;
 	int i;
 	char *e;
@@ -476,26 +810,43 @@ int cmd_flash_read(int argc, char *argv[])
 		return -1;
 	}
 
-	/* Read data in chunks */
-	for (i = 0; i < size; i += sizeof(rdata)) {
+	/*
+	 * Read data in chunks, as big as possible.  Protocol version 3 allows
+	 * much larger responses; fall back to the old size if the EC doesn't
+	 * support it.
+	 */
+	gettimeofday(&start, NULL);
+	for (i = 0; i < size; i += chunk) {
+		chunk = use_v3 ? FLASH_READ_V3_CHUNK : EC_OLD_PARAM_SIZE;
 		p.offset = offset + i;
-		p.size = MIN(size - i, sizeof(rdata));
-		rv = ec_command(EC_CMD_FLASH_READ, 0,
-				&p, sizeof(p), rdata, sizeof(rdata));
+		p.size = MIN(size - i, chunk);
+		if (use_v3) {
+			rv = ec_command_v3(EC_CMD_FLASH_READ, 0, &p, sizeof(p),
+					   buf + i, p.size);
+			if (rv == -EC_RES_INVALID_VERSION) {
+				use_v3 = 0;
+				chunk = 0;
+				continue;
+			}
+		} else {
+			rv = ec_command(EC_CMD_FLASH_READ, 0, &p, sizeof(p),
+					buf + i, p.size);
+		}
 		if (rv < 0) {
 			fprintf(stderr, "Read error at offset %d\n", i);
 			free(buf);
 			return rv;
 		}
-		memcpy(buf + i, rdata, p.size);
 	}
+	i = elapsed_us(&start);
 
 	rv = write_file(argv[3], buf, size);
 	free(buf);
 	if (rv)
 		return rv;
 
-	printf("done.\n");
+	printf("done in %d ms (%d KB/s, protocol v%d).\n", i / 1000,
+	       i ? (int)(size * 1000000LL / 1024 / i) : 0, use_v3 ? 3 : 2);
 	return 0;
 }
 
@@ -503,7 +854,8 @@ int cmd_flash_read(int argc, char *argv[])
 int cmd_flash_write(int argc, char *argv[])
 {
 	struct ec_params_flash_write p;
-	int offset, size;
+	struct ec_params_flash_write *pv3;
+	int offset, size, chunk;
 	int rv;
 	int i;
 	char *e;
@@ -526,6 +878,37 @@ int cmd_flash_write(int argc, char *argv[])
 
 	printf("Writing to offset %d...\n", offset);
 
+	/*
+	 * With protocol version 3, write bigger chunks using version 1 of the
+	 * command.  Fall back to the old way if the EC doesn't support it.
+	 */
+	pv3 = (struct ec_params_flash_write *)malloc(
+		sizeof(*pv3) - sizeof(pv3->data) + FLASH_WRITE_V3_CHUNK);
+	for (i = 0; pv3 && i < size; i += chunk) {
+		chunk = MIN(size - i, FLASH_WRITE_V3_CHUNK);
+		pv3->offset = offset + i;
+		pv3->size = chunk;
+		memcpy(pv3->data, buf + i, chunk);
+		rv = ec_command_v3(EC_CMD_FLASH_WRITE, 1, pv3,
+				   sizeof(*pv3) - sizeof(pv3->data) + chunk,
+				   NULL, 0);
+		if (rv == -EC_RES_INVALID_VERSION && i == 0)
+			break;
+		if (rv < 0) {
+			fprintf(stderr, "Write error at offset %d\n", i);
+			free(pv3);
+			free(buf);
+			return rv;
+		}
+	}
+	if (pv3 && i >= size) {
+		free(pv3);
+		free(buf);
+		printf("done.\n");
+		return 0;
+	}
+	free(pv3);
+
 	/* Write data in chunks */
 	for (i = 0; i < size; i += sizeof(p.data)) {
 		p.offset = offset + i;
@@ -545,6 +928,32 @@ int cmd_flash_write(int argc, char *argv[])
 }
 
 
+/*
+ * Wait for a command which returned EC_RES_IN_PROGRESS to finish in the
+ * background, then fetch its response.  Returns the same as ec_command().
+ */
+static int ec_wait_for_result(void *outdata, int outsize)
+{
+	struct ec_response_get_comms_status r;
+	int rv, i;
+
+	/* Poll for up to 10 seconds */
+	for (i = 0; i < 1000; i++) {
+		rv = ec_command(EC_CMD_GET_COMMS_STATUS, 0, NULL, 0,
+				&r, sizeof(r));
+		if (rv < 0)
+			return rv;
+		if (!(r.flags & EC_COMMS_STATUS_PROCESSING))
+			return ec_command(EC_CMD_RESEND_RESPONSE, 0, NULL, 0,
+					  outdata, outsize);
+		usleep(10000);
+	}
+
+	fprintf(stderr, "Timeout waiting for EC command to finish\n");
+	return -EC_RES_ERROR;
+}
+
+
 int cmd_flash_erase(int argc, char *argv[])
 {
 	struct ec_params_flash_erase p;
@@ -568,6 +977,8 @@ int cmd_flash_erase(int argc, char *argv[])
 
 	printf("Erasing %d bytes at offset %d...\n", p.size, p.offset);
 	rv = ec_command(EC_CMD_FLASH_ERASE, 0, &p, sizeof(p), NULL, 0);
+	if (rv == -EC_RES_IN_PROGRESS)
+		rv = ec_wait_for_result(NULL, 0);
 	if (rv < 0)
 		return rv;
 
@@ -1965,6 +2376,288 @@ int cmd_chipinfo(int argc, char *argv[])
 }
 
 
+int cmd_stack_info(int argc, char *argv[])
+{
+	struct ec_params_task_stack_info p;
+	struct ec_response_task_stack_info r;
+	int rv;
+
+	printf("Task Name                 Stack used\n");
+
+	p.task_id = 0;
+	do {
+		rv = ec_command(EC_CMD_TASK_STACK_INFO, 0, &p, sizeof(p),
+				&r, sizeof(r));
+		if (rv < 0)
+			return rv;
+
+		printf("%4d %-20s %4d / %4d\n", p.task_id, r.name,
+		       r.stack_used, r.stack_size);
+		p.task_id++;
+	} while (p.task_id < r.task_count);
+
+	return 0;
+}
+
+
+int cmd_idle_stats(int argc, char *argv[])
+{
+	static const char * const names[EC_IDLE_STATE_COUNT] = {
+		"wfi", "deep", "hibernate"
+	};
+	struct ec_response_idle_stats r;
+	int rv, i;
+
+	rv = ec_command(EC_CMD_IDLE_STATS, 0, NULL, 0, &r, sizeof(r));
+	if (rv < 0)
+		return rv;
+
+	printf("Time: %d ms\n", r.time_ms);
+	printf("State      Entries  Residency (ms)  Max exit (us)\n");
+	for (i = 0; i < EC_IDLE_STATE_COUNT; i++)
+		printf("%-9s %8d  %14d  %13d\n", names[i],
+		       r.state[i].entries, r.state[i].residency_ms,
+		       r.state[i].max_exit_us);
+
+	return 0;
+}
+
+
+int cmd_boot_time(int argc, char *argv[])
+{
+	static const char * const names[EC_BOOT_TIME_MILESTONE_COUNT] = {
+		"pre_init", "clock_init", "timer_init", "uart_init",
+		"keyscan_init", "vboot", "hook_init", "task_start",
+		"host_cmd_ready", "sysjump",
+	};
+	static const char * const image_names[] = {"?", "RO", "RW"};
+	struct ec_response_boot_time r;
+	uint32_t prev = 0;
+	int rv, i;
+
+	rv = ec_command(EC_CMD_BOOT_TIME, 0, NULL, 0, &r, sizeof(r));
+	if (rv < 0)
+		return rv;
+
+	printf("Image  Milestone         Time (us)  Delta (us)\n");
+	for (i = 0; i < r.count && i < EC_BOOT_TIME_MAX_ENTRIES; i++) {
+		printf("%-5s  %-16s  ",
+		       r.entry[i].image < ARRAY_SIZE(image_names) ?
+		       image_names[r.entry[i].image] : "?",
+		       r.entry[i].milestone < EC_BOOT_TIME_MILESTONE_COUNT ?
+		       names[r.entry[i].milestone] : "unknown");
+		if (r.entry[i].flags & EC_BOOT_TIME_FLAG_NO_TIME) {
+			printf("        -           -\n");
+			continue;
+		}
+		printf("%9u  %10u\n", r.entry[i].time_us,
+		       r.entry[i].time_us - prev);
+		prev = r.entry[i].time_us;
+	}
+	if (r.dropped)
+		printf("Dropped: %d\n", r.dropped);
+
+	return 0;
+}
+
+
+int cmd_console(int argc, char *argv[])
+{
+	struct ec_params_console_read p;
+	uint8_t buf[EC_HOST_PARAM_SIZE];
+	const struct ec_response_console_read *r =
+		(const struct ec_response_console_read *)buf;
+	int follow = 0, first = 1;
+	int rv, len;
+
+	if (argc == 2 && !strcasecmp(argv[1], "follow")) {
+		follow = 1;
+	} else if (argc != 1) {
+		fprintf(stderr, "Usage: %s [follow]\n", argv[0]);
+		return -1;
+	}
+
+	p.cursor = 0;
+	while (1) {
+		rv = ec_command(EC_CMD_CONSOLE_READ, 0, &p, sizeof(p),
+				buf, sizeof(buf));
+		if (rv < 0)
+			return rv;
+		if (rv < sizeof(*r)) {
+			fprintf(stderr, "Response too short\n");
+			return -1;
+		}
+		len = rv - sizeof(*r);
+
+		/* Keep the notes in place among the output */
+		fflush(stdout);
+		if (!first && r->start > p.cursor)
+			fprintf(stderr, "\n[%u bytes lost]\n",
+				r->start - p.cursor);
+		else if (r->start < p.cursor)
+			fprintf(stderr, "\n[EC reset]\n");
+		fwrite(buf + sizeof(*r), 1, len, stdout);
+		p.cursor = r->start + len;
+		first = 0;
+
+		/* Caught up with the EC */
+		if (p.cursor == r->head) {
+			if (!follow)
+				break;
+			fflush(stdout);
+			usleep(100000);
+		}
+	}
+
+	return 0;
+}
+
+
+int cmd_telemetry(int argc, char *argv[])
+{
+	struct ec_telemetry t;
+	uint32_t n, first;
+	int rv;
+
+	rv = read_telemetry(&t);
+	if (rv < 0)
+		return rv;
+
+	if (t.version != EC_TELEMETRY_VERSION ||
+	    t.sample_size != sizeof(t.sample[0]) ||
+	    t.sample_count == 0 || t.sample_count > EC_TELEMETRY_SAMPLES) {
+		fprintf(stderr, "Unsupported telemetry version %d\n",
+			t.version);
+		return -1;
+	}
+
+	/* The slot for the next sample may be part way written */
+	first = t.seq >= t.sample_count ? t.seq - t.sample_count + 1 : 0;
+
+	printf("Samples: %u\n", t.seq);
+	printf("   Seq    Time (ms)  Temps (K)        Fans (rpm)   "
+	       "mV     mA     mAh    Flags\n");
+	for (n = first; n < t.seq; n++) {
+		const struct ec_telemetry_sample *s =
+			t.sample + n % t.sample_count;
+		int i;
+
+		printf("%6u  %11u ", n, s->time_ms);
+		for (i = 0; i < EC_TELEMETRY_TEMPS; i++) {
+			if (s->temp[i] >= EC_TEMP_SENSOR_NOT_POWERED)
+				printf("   -");
+			else
+				printf(" %3d",
+				       s->temp[i] + EC_TEMP_SENSOR_OFFSET);
+		}
+		printf(" ");
+		for (i = 0; i < EC_TELEMETRY_FANS; i++) {
+			if (s->fan_rpm[i] == EC_FAN_SPEED_NOT_PRESENT)
+				printf("     -");
+			else
+				printf(" %5d", s->fan_rpm[i]);
+		}
+		printf("  %5d  %5d  %5d  0x%02x\n", s->batt_volt,
+		       s->batt_rate, s->batt_cap, s->batt_flag);
+	}
+
+	return 0;
+}
+
+
+int cmd_hook_stats(int argc, char *argv[])
+{
+	static const char * const type_names[] = {
+		"init", "freq_change", "sysjump", "chipset_startup",
+		"chipset_resume", "chipset_suspend", "chipset_shutdown",
+		"ac_change", "lid_change",
+	};
+	struct ec_params_hook_stats p;
+	struct ec_response_hook_stats r;
+	int rv;
+
+	p.type = 0;
+	do {
+		p.index = 0;
+		do {
+			rv = ec_command(EC_CMD_HOOK_STATS, 0, &p, sizeof(p),
+					&r, sizeof(r));
+			if (rv < 0)
+				return rv;
+
+			if (p.index == 0) {
+				if (p.type < ARRAY_SIZE(type_names))
+					printf("%s", type_names[p.type]);
+				else
+					printf("type %d", p.type);
+				printf(": last %d us\n", r.type_last_us);
+			}
+			if (p.index < r.hook_count)
+				printf("  0x%08x  prio %4d  last %8d us  "
+				       "max %8d us\n", r.routine, r.priority,
+				       r.last_us, r.max_us);
+			p.index++;
+		} while (p.index < r.hook_count);
+		p.type++;
+	} while (p.type < r.type_count);
+
+	return 0;
+}
+
+
+int cmd_host_cmd_stats(int argc, char *argv[])
+{
+	struct ec_params_host_cmd_stats p;
+	struct ec_response_host_cmd_stats r;
+	int rv, i;
+
+	p.start_cmd = 0;
+	p.flags = 0;
+	if (argc > 1) {
+		if (strcasecmp(argv[1], "clear")) {
+			fprintf(stderr, "Usage: %s [clear]\n", argv[0]);
+			return -1;
+		}
+		p.flags = EC_HOST_CMD_STATS_FLAG_CLEAR;
+		rv = ec_command(EC_CMD_HOST_CMD_STATS, 0, &p, sizeof(p),
+				&r, sizeof(r));
+		return rv < 0 ? rv : 0;
+	}
+
+	printf("Cmd    Calls Errors  Min us  Avg us  Max us  "
+	       "Avg queue  Max queue\n");
+	do {
+		rv = ec_command(EC_CMD_HOST_CMD_STATS, 0, &p, sizeof(p),
+				&r, sizeof(r));
+		if (rv < 0)
+			return rv;
+		if (r.count > EC_HOST_CMD_STATS_MAX_ENTRIES) {
+			fprintf(stderr, "Bad entry count.\n");
+			return -1;
+		}
+
+		for (i = 0; i < r.count; i++) {
+			int calls = r.entry[i].calls ? r.entry[i].calls : 1;
+
+			printf("0x%02x %7d %6d %7d %7d %7d %10d %10d\n",
+			       r.entry[i].cmd, r.entry[i].calls,
+			       r.entry[i].errors, r.entry[i].min_us,
+			       r.entry[i].total_us / calls,
+			       r.entry[i].max_us,
+			       r.entry[i].total_queue_us / calls,
+			       r.entry[i].max_queue_us);
+		}
+
+		if (!r.count)
+			break;
+		p.start_cmd = r.entry[r.count - 1].cmd + 1;
+	} while (r.more && p.start_cmd);
+
+	printf("Unknown commands: %d\n", r.unknown_calls);
+	return 0;
+}
+
+
 static int ec_hash_help(const char *cmd)
 {
 	printf("Usage:\n");
@@ -2093,14 +2786,22 @@ struct command {
 	int (*handler)(int argc, char *argv[]);
 };
 
+/* Defined after the command table, since it runs commands from it */
+int cmd_session(int argc, char *argv[]);
+
 /* NULL-terminated list of commands */
 const struct command commands[] = {
 	{"autofanctrl", cmd_thermal_auto_fan_ctrl},
 	{"backlight", cmd_lcd_backlight},
+	{"batch", cmd_batch},
+	{"batchbench", cmd_batch_bench},
 	{"battery", cmd_battery},
+	{"boottime", cmd_boot_time},
 	{"chargeforceidle", cmd_charge_force_idle},
 	{"chipinfo", cmd_chipinfo},
+	{"cmdlist", cmd_cmdlist},
 	{"cmdversions", cmd_cmdversions},
+	{"console", cmd_console},
 	{"echash", cmd_ec_hash},
 	{"eventclear", cmd_host_event_clear},
 	{"eventclearb", cmd_host_event_clear_b},
@@ -2120,10 +2821,13 @@ const struct command commands[] = {
 	{"flashinfo", cmd_flash_info},
 	{"gpioget", cmd_gpio_get},
 	{"gpioset", cmd_gpio_set},
+	{"hcstats", cmd_host_cmd_stats},
 	{"hello", cmd_hello},
+	{"hookstats", cmd_hook_stats},
 	{"kbpress", cmd_kbpress},
 	{"i2cread", cmd_i2c_read},
 	{"i2cwrite", cmd_i2c_write},
+	{"idlestats", cmd_idle_stats},
 	{"lightbar", cmd_lightbar},
 	{"vboot", cmd_vboot},
 	{"pstoreinfo", cmd_pstore_info},
@@ -2135,8 +2839,12 @@ const struct command commands[] = {
 	{"pwmsetkblight", cmd_pwm_set_keyboard_backlight},
 	{"readtest", cmd_read_test},
 	{"reboot_ec", cmd_reboot_ec},
+	{"replay", cmd_replay},
+	{"session", cmd_session},
 	{"sertest", cmd_serial_test},
+	{"stackinfo", cmd_stack_info},
 	{"switches", cmd_switches},
+	{"telemetry", cmd_telemetry},
 	{"temps", cmd_temperature},
 	{"tempsinfo", cmd_temp_sensor_info},
 	{"thermalget", cmd_thermal_get_threshold},
@@ -2148,6 +2856,204 @@ const struct command commands[] = {
 };
 
 
+#define SESSION_LINE_MAX 1024
+#define SESSION_ARGS_MAX 64
+
+/* Reads lines from a file descriptor, so we can tell whether another line
+ * is waiting without blocking. */
+struct line_reader {
+	int fd;
+	int len;
+	char buf[SESSION_LINE_MAX + 1];
+};
+
+/* Return non-zero if a whole line is buffered */
+static int line_ready(const struct line_reader *lr)
+{
+	return memchr(lr->buf, '\n', lr->len) != NULL;
+}
+
+/* Read the next line, without its newline.  Returns 0 if success, or -1 at
+ * the end of the input. */
+static int read_line(struct line_reader *lr, char *line)
+{
+	char *nl;
+	int size, n;
+
+	while (!(nl = memchr(lr->buf, '\n', lr->len))) {
+		if (lr->len == SESSION_LINE_MAX) {
+			fprintf(stderr, "Line too long\n");
+			lr->len = 0;
+		}
+		n = read(lr->fd, lr->buf + lr->len,
+			 SESSION_LINE_MAX - lr->len);
+		if (n <= 0) {
+			/* Last line may be missing its newline */
+			if (!lr->len)
+				return -1;
+			nl = lr->buf + lr->len;
+			*nl = '\n';
+			lr->len++;
+			break;
+		}
+		lr->len += n;
+	}
+
+	size = nl - lr->buf;
+	memcpy(line, lr->buf, size);
+	line[size] = '\0';
+	lr->len -= size + 1;
+	memmove(lr->buf, nl + 1, lr->len);
+	return 0;
+}
+
+/* Run one command from a session.  Returns the command's result. */
+static int session_command(int argc, char *argv[])
+{
+	const struct command *cmd;
+	int rv = -2;
+
+	if (!strcasecmp(argv[0], "session")) {
+		fprintf(stderr, "Already in a session\n");
+		return -1;
+	}
+
+	for (cmd = commands; cmd->name; cmd++) {
+		if (!strcasecmp(argv[0], cmd->name))
+			break;
+	}
+	if (cmd->name)
+		rv = cmd->handler(argc, argv);
+	else
+		fprintf(stderr, "Unknown command '%s'\n", argv[0]);
+
+	printf("=> %d\n", rv);
+	fflush(stdout);
+	return rv;
+}
+
+/* Repeat a command every interval until another line comes in */
+static int session_watch(struct line_reader *in, int argc, char *argv[])
+{
+	int interval_ms;
+	char *e;
+
+	if (argc < 3) {
+		fprintf(stderr, "Usage: watch <ms> <command> [params]\n");
+		return -1;
+	}
+	interval_ms = strtol(argv[1], &e, 0);
+	if ((e && *e) || interval_ms <= 0) {
+		fprintf(stderr, "Bad interval\n");
+		return -1;
+	}
+
+	while (!line_ready(in)) {
+		struct timeval tv;
+		fd_set fds;
+
+		session_command(argc - 2, argv + 2);
+
+		FD_ZERO(&fds);
+		FD_SET(in->fd, &fds);
+		tv.tv_sec = interval_ms / 1000;
+		tv.tv_usec = (interval_ms % 1000) * 1000;
+		if (select(in->fd + 1, &fds, NULL, NULL, &tv) != 0)
+			break;
+	}
+	return 0;
+}
+
+/* Run commands from in until it ends or asks to quit */
+static void session_run(struct line_reader *in)
+{
+	char line[SESSION_LINE_MAX + 1];
+	char *argv[SESSION_ARGS_MAX];
+	int argc;
+
+	while (read_line(in, line) == 0) {
+		char *word = strtok(line, " \t\r");
+
+		for (argc = 0; word && argc < SESSION_ARGS_MAX; argc++) {
+			argv[argc] = word;
+			word = strtok(NULL, " \t\r");
+		}
+		if (!argc)
+			continue;
+
+		if (!strcasecmp(argv[0], "quit"))
+			return;
+		if (!strcasecmp(argv[0], "watch")) {
+			printf("=> %d\n", session_watch(in, argc, argv));
+			fflush(stdout);
+		} else {
+			session_command(argc, argv);
+		}
+	}
+}
+
+int cmd_session(int argc, char *argv[])
+{
+	struct line_reader in;
+	struct sockaddr_un addr;
+	int sock, saved_out, saved_err;
+
+	in.len = 0;
+	if (argc < 2) {
+		in.fd = 0;
+		session_run(&in);
+		return 0;
+	}
+
+	if (strlen(argv[1]) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path too long\n");
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, argv[1]);
+
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0) {
+		perror("Error creating socket");
+		return -1;
+	}
+	unlink(argv[1]);
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    listen(sock, 4) < 0) {
+		perror("Error listening on socket");
+		close(sock);
+		return -1;
+	}
+
+	/* A client going away must not kill the session */
+	signal(SIGPIPE, SIG_IGN);
+
+	/* Serve one client at a time, sending it the output of its commands */
+	saved_out = dup(1);
+	saved_err = dup(2);
+	while (1) {
+		int client = accept(sock, NULL, NULL);
+
+		if (client < 0) {
+			perror("Error accepting client");
+			continue;
+		}
+		dup2(client, 1);
+		dup2(client, 2);
+		in.fd = client;
+		in.len = 0;
+		session_run(&in);
+
+		fflush(stdout);
+		dup2(saved_out, 1);
+		dup2(saved_err, 2);
+		close(client);
+	}
+	return 0;
+}
+
+
 int main(int argc, char *argv[])
 {
 	const struct command *cmd;
@@ -2164,6 +3070,10 @@ int main(int argc, char *argv[])
 	if (comm_init() < 0)
 		return -3;
 
+	if (getenv("ECTOOL_TRACE") &&
+	    trace_record_start(getenv("ECTOOL_TRACE")) < 0)
+		return -3;
+
 	/* Handle commands */
 	for (cmd = commands; cmd->name; cmd++) {
 		if (!strcasecmp(argv[1], cmd->name))